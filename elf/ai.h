@@ -79,6 +79,23 @@ public:
         return true;
     }
 
+    // Act split in two, so that one thread can keep several AIs waiting on the same batch.
+    // Every successful SendAct has to be followed by WaitAct with the same state.
+    bool SendAct(const S &s, const std::atomic_bool *done) {
+        assert(_ai_comm);
+        before_act(s, done);
+        _ai_comm->Prepare();
+        extract(s, &_ai_comm->info().data);
+        return _ai_comm->SendData();
+    }
+
+    bool WaitAct(const S &s, A *a) {
+        assert(_ai_comm);
+        _ai_comm->WaitReply();
+        if (a != nullptr) handle_response(s, _ai_comm->info().data, a);
+        return true;
+    }
+
     const Data& data() const {
         assert(_ai_comm);
         return _ai_comm->info().data;
@@ -50,6 +50,9 @@ private:
 
     std::mt19937 _g;
 
+    // Groups of the request sent by SendData, waited on by WaitReply.
+    std::vector<int> _pending_groups;
+
 public:
     AICommT(int id, Comm *comm) : _comm(comm), _info(id), _g(_info.meta.query_id) {
     }
@@ -88,6 +91,17 @@ public:
         // std::cout << "[" << _meta.id << "] Done with SendDataWaitReply, continue" << std::endl;
     }
 
+    // SendDataWaitReply in two halves. Between them the caller may send requests from other AIComms,
+    // so that they all end up in the same batch.
+    bool SendData() {
+        return _comm->SendData(_info.meta.query_id, _info, &_pending_groups);
+    }
+
+    void WaitReply() {
+        _comm->WaitReply(_info.meta.query_id, _pending_groups);
+        _pending_groups.clear();
+    }
+
     void Restart() {
         // std::cout << "[" << _info.meta.id << "] Restarting" << std::endl;
         _info.data.Restart();
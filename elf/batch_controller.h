@@ -0,0 +1,169 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "pybind_helper.h"
+
+namespace elf {
+
+struct BatchControllerStats {
+    // Current decisions.
+    int batchsize = 0;
+    int timeout_usec = 0;
+    bool adaptive = false;
+
+    // Measurements over the last few batches.
+    float arrival_per_sec = 0.0;
+    float model_usec_p50 = 0.0;
+    float latency_usec_p99 = 0.0;
+
+    int64_t num_batches = 0;
+    // Batches which were sent before they were full.
+    int64_t num_partial = 0;
+
+    REGISTER_PYBIND_FIELDS(batchsize, timeout_usec, adaptive, arrival_per_sec, model_usec_p50, latency_usec_p99, num_batches, num_partial);
+};
+
+// Picks the batch size and the per-item timeout of a collector group.
+// Each batch is timed from the arrival of its first item until its reply is ready, so the time the
+// group sits idle waiting for requests counts neither in the latency nor in the arrival rate.
+// If the p99 of that latency goes over the target, the batch size is cut by 20%. If full
+// batches come back well within the target, the batch size grows by one, up to max_batchsize.
+// The timeout is the time left in the budget after the model, spread over the batch. It is also capped
+// to a few times the gap between items, measured from the first to the last item of each batch: once no
+// item has come in that long, the group sends what it has instead of waiting out the budget.
+// With target_p99_usec <= 0, the batch size and timeout are fixed and only stats are kept.
+class BatchController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BatchController(int max_batchsize, int timeout_usec, int target_p99_usec)
+        : _max_batchsize(max_batchsize), _target_usec(target_p99_usec), _adaptive(target_p99_usec > 0),
+          _batchsize(max_batchsize), _timeout_usec(timeout_usec) {
+    }
+
+    int batchsize() const { return _batchsize; }
+    int timeout_usec() const { return _timeout_usec; }
+
+    // Fix the batch size from outside (e.g., when stopping). This turns the controller off.
+    void Fix(int batchsize) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _adaptive = false;
+        _batchsize = batchsize;
+    }
+
+    // The following are called from the collector thread.
+    void BatchStart(Clock::time_point t_first_item, Clock::time_point t_last_item) {
+        _t_start = t_first_item;
+        _t_last_item = t_last_item;
+    }
+    void BatchFormed() { BatchFormed(Clock::now()); }
+    void BatchFormed(Clock::time_point t) { _t_formed = t; }
+    void BatchDone(int n) { BatchDone(n, Clock::now()); }
+
+    void BatchDone(int n, Clock::time_point t_done) {
+        float form_usec = std::chrono::duration<float, std::micro>(_t_formed - _t_start).count();
+        float model_usec = std::chrono::duration<float, std::micro>(t_done - _t_formed).count();
+        float arrival_usec = std::chrono::duration<float, std::micro>(_t_last_item - _t_start).count();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.num_batches ++;
+        if (n < _batchsize) _stats.num_partial ++;
+
+        push(form_usec + model_usec, model_usec);
+        // The items after the first one came in between the first and the last one. The wait after the
+        // last one is left out, or a group with few requests would look even slower than it is.
+        if (n > 1) {
+            float rate = (n - 1) * 1e6 / std::max(arrival_usec, 1.0f);
+            _arrival_per_sec = (_arrival_per_sec == 0.0 ? rate : 0.9 * _arrival_per_sec + 0.1 * rate);
+        }
+
+        if (! _adaptive || (int)_latency.size() < kMinSamples) return;
+        if (_cooldown > 0) {
+            _cooldown --;
+            return;
+        }
+
+        float latency_p99 = percentile(_latency, 0.99);
+        if (latency_p99 > _target_usec) {
+            _batchsize = std::max(1, _batchsize * 4 / 5);
+            // Let the old samples age out before cutting again.
+            _cooldown = kMinSamples;
+        } else if (n >= _batchsize && latency_p99 < 0.8 * _target_usec) {
+            _batchsize = std::min(_max_batchsize, _batchsize + 1);
+        }
+
+        float budget = _target_usec - percentile(_model, 0.99);
+        float timeout = budget / _batchsize;
+        if (_arrival_per_sec > 0) timeout = std::min(timeout, kMaxGaps * 1e6f / _arrival_per_sec);
+        _timeout_usec = (int)timeout;
+        if (_timeout_usec < kMinTimeoutUSec) _timeout_usec = kMinTimeoutUSec;
+    }
+
+    BatchControllerStats GetStats() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        BatchControllerStats stats = _stats;
+        stats.batchsize = _batchsize;
+        stats.timeout_usec = _timeout_usec;
+        stats.adaptive = _adaptive;
+        stats.arrival_per_sec = _arrival_per_sec;
+        stats.model_usec_p50 = percentile(_model, 0.5);
+        stats.latency_usec_p99 = percentile(_latency, 0.99);
+        return stats;
+    }
+
+private:
+    static constexpr int kWindow = 256;
+    static constexpr int kMinSamples = 16;
+    static constexpr int kMinTimeoutUSec = 20;
+    // How many average gaps between items to wait for the next one.
+    static constexpr float kMaxGaps = 3.0;
+
+    const int _max_batchsize;
+    const int _target_usec;
+
+    mutable std::mutex _mutex;
+    bool _adaptive;
+    int _batchsize;
+    int _timeout_usec;
+    int _cooldown = 0;
+
+    Clock::time_point _t_start, _t_last_item, _t_formed;
+    std::vector<float> _latency, _model;
+    size_t _next = 0;
+    float _arrival_per_sec = 0.0;
+    BatchControllerStats _stats;
+
+    void push(float latency, float model) {
+        if ((int)_latency.size() < kWindow) {
+            _latency.push_back(latency);
+            _model.push_back(model);
+        } else {
+            _latency[_next] = latency;
+            _model[_next] = model;
+        }
+        _next = (_next + 1) % kWindow;
+    }
+
+    static float percentile(const std::vector<float> &window, float q) {
+        if (window.empty()) return 0.0;
+        std::vector<float> tmp(window);
+        size_t k = std::min(tmp.size() - 1, (size_t)(q * tmp.size()));
+        std::nth_element(tmp.begin(), tmp.begin() + k, tmp.end());
+        return tmp[k];
+    }
+};
+
+}  // namespace elf
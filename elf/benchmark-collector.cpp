@@ -0,0 +1,114 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//g++ -O3 -std=c++11 -DUSE_TBB benchmark-collector.cpp lib/debugutils.cc lib/strutils.cc -I. -I../vendor -ltbb -lpthread -o benchmark-collector
+// Usage: ./benchmark-collector [num_threads] [batchsize] [seconds]
+//
+// Games send a request to the collector and wait for the reply (SendData + WaitReply).
+// A single consumer thread gathers batches and replies to all of them right away, so the
+// numbers only reflect the cost of the handoff itself.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "collector.hh"
+
+using namespace std;
+using namespace std::chrono;
+
+struct Request {
+    int key;
+};
+
+struct Result {
+    double steps_per_sec;
+    double p50_usec;
+    double p99_usec;
+};
+
+Result run(bool lockfree, int num_threads, int batchsize, double seconds) {
+    vector<int> keys;
+    // One more key to stop the consumer, which blocks on the first item of a batch.
+    for (int i = 0; i <= num_threads; ++i) keys.push_back(i);
+
+    unique_ptr<elf::BatchCollectorBaseT<int, Request>> collector(
+        elf::CreateBatchCollector<int, Request>(keys, lockfree));
+
+    atomic_bool done(false);
+    vector<vector<float>> latencies(num_threads);
+
+    thread consumer([&]() {
+        bool stop = false;
+        while (! stop) {
+            // Same timeouts as CollectorGroupT::MainLoop (kTimeOutuSecNoBatch for the first item).
+            auto batch = collector->waitBatch(batchsize, 100, 0);
+            for (Request *r : batch) {
+                if (r == nullptr) continue;
+                if (r->key == num_threads) stop = true;
+                collector->signalReply(r->key);
+            }
+        }
+    });
+
+    vector<thread> games;
+    for (int i = 0; i < num_threads; ++i) {
+        games.emplace_back([&, i]() {
+            Request req{i};
+            auto &lat = latencies[i];
+            lat.reserve(1 << 20);
+            while (! done.load()) {
+                auto t0 = steady_clock::now();
+                collector->sendData(i, &req);
+                collector->waitReply(i);
+                lat.push_back(duration_cast<duration<float, micro>>(steady_clock::now() - t0).count());
+            }
+        });
+    }
+
+    auto start = steady_clock::now();
+    this_thread::sleep_for(duration<double>(seconds));
+    done = true;
+    double elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    for (auto &t : games) t.join();
+    Request stop{num_threads};
+    collector->sendData(num_threads, &stop);
+    collector->waitReply(num_threads);
+    consumer.join();
+
+    vector<float> all;
+    for (const auto &lat : latencies) all.insert(all.end(), lat.begin(), lat.end());
+    if (all.empty()) return Result{0, 0, 0};
+    sort(all.begin(), all.end());
+
+    Result res;
+    res.steps_per_sec = all.size() / elapsed;
+    res.p50_usec = all[all.size() / 2];
+    res.p99_usec = all[min(all.size() - 1, all.size() * 99 / 100)];
+    return res;
+}
+
+int main(int argc, char *argv[]) {
+    int num_threads = argc > 1 ? atoi(argv[1]) : 16;
+    int batchsize = argc > 2 ? atoi(argv[2]) : 8;
+    double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+
+    cout << "#threads: " << num_threads << ", batchsize: " << batchsize << ", seconds: " << seconds << endl;
+    for (bool lockfree : { false, true }) {
+        Result res = run(lockfree, num_threads, batchsize, seconds);
+        cout << (lockfree ? "CollectorWithSlots   " : "CollectorWithCCQueue ")
+             << "steps/sec: " << res.steps_per_sec
+             << ", p50: " << res.p50_usec << "us"
+             << ", p99: " << res.p99_usec << "us" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//g++ -O3 -std=c++11 -DUSE_TBB benchmark-copier.cpp lib/debugutils.cc lib/strutils.cc -I. -I.. -I../vendor -ltbb -lpthread -o benchmark-copier
+// Usage: ./benchmark-copier [batchsize] [iterations]
+//
+// Compares the per-item copier (two virtual calls per state and key) with the batched
+// gather (one virtual call per key and batch) on the Go and Atari GameState layouts.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "go/go_game_specific.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Same layout as atari/atari_game_specific.h, which needs ALE to be included.
+struct AtariGameState {
+    using State = AtariGameState;
+    int32_t id = -1;
+    int32_t seq = 0;
+    int32_t game_counter = 0;
+    char last_terminal = 0;
+
+    std::vector<float> s;
+    int32_t tick = 0;
+    int32_t lives = 0;
+    float last_r = 0.0;
+
+    int64_t a;
+    float V;
+    std::vector<float> pi;
+    int32_t rv;
+
+    std::string player_name;
+
+    DECLARE_FIELD(AtariGameState, id, seq, game_counter, last_terminal, s, tick, lives, last_r, a, V, pi, rv);
+};
+
+template <typename State>
+class Bench {
+public:
+    Bench(int batchsize, const std::vector<std::string> &keys) : _states(batchsize) {
+        for (int i = 0; i < batchsize; ++i) _batch.push_back(&_states[i]);
+        _keys = keys;
+    }
+
+    std::vector<State> &states() { return _states; }
+
+    void Run(int iterations) {
+        for (const auto &key : _keys) {
+            auto *mm = State::get_mm(key);
+            size_t bytes = mm->size(_states[0]) * _batch.size();
+            _buffers.emplace_back(bytes);
+            _copier.emplace_back(key, elf::SharedBuffer(_buffers.back().data(), bytes), mm);
+            _bytes_per_batch += bytes;
+        }
+
+        double per_item = measure(iterations, [&]() {
+            for (const auto& item: _copier) {
+                char *p = item.ptr();
+                for (auto* s: _batch) p = item.CopyToMem(*s, p);
+            }
+        });
+        double batched = measure(iterations, [&]() { elf::CopyToMem(_copier, _batch); });
+
+        cout << "  per-item: " << per_item / 1e9 << " GB/s" << endl;
+        cout << "  batched:  " << batched / 1e9 << " GB/s" << endl;
+    }
+
+private:
+    std::vector<State> _states;
+    std::vector<State *> _batch;
+    std::vector<std::string> _keys;
+    std::vector<std::vector<char>> _buffers;
+    std::vector<elf::CopyItemT<State>> _copier;
+    size_t _bytes_per_batch = 0;
+
+    template <typename Func>
+    double measure(int iterations, Func f) {
+        f();
+        auto start = steady_clock::now();
+        for (int i = 0; i < iterations; ++i) f();
+        double elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        return _bytes_per_batch * (double)iterations / elapsed;
+    }
+};
+
+template <typename State, typename Init>
+void run_layout(const std::string &name, int batchsize, int iterations, const std::vector<std::string> &keys, Init init) {
+    cout << name << ", batchsize " << batchsize << ", keys:";
+    for (const auto &key : keys) cout << " " << key;
+    cout << endl;
+
+    Bench<State> bench(batchsize, keys);
+    for (auto &s : bench.states()) init(s);
+    bench.Run(iterations);
+}
+
+int main(int argc, char *argv[]) {
+    int batchsize = argc > 1 ? atoi(argv[1]) : 128;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+
+    // 25 planes of 19x19 in, policy/value out.
+    auto init_go = [](GameState &s) {
+        s.s.resize(25 * 19 * 19, 1.0);
+        s.pi.resize(19 * 19, 0.0);
+    };
+    // 4 stacked 105x80 RGB frames in, 18 actions out.
+    auto init_atari = [](AtariGameState &s) {
+        s.s.resize(4 * 3 * 105 * 80, 1.0);
+        s.pi.resize(18, 0.0);
+    };
+
+    // Full input/reply sets are bound by memory bandwidth, the scalar-only sets by dispatch.
+    run_layout<GameState>("Go GameState", batchsize, iterations,
+        { "s", "id", "seq", "game_counter", "last_terminal", "move_idx", "pi", "a", "V" }, init_go);
+    run_layout<GameState>("Go GameState", batchsize, iterations * 100,
+        { "id", "seq", "game_counter", "last_terminal", "move_idx", "a", "V" }, init_go);
+    run_layout<AtariGameState>("Atari GameState", batchsize, iterations / 4,
+        { "s", "id", "seq", "game_counter", "last_terminal", "last_r", "pi", "a", "V" }, init_atari);
+    run_layout<AtariGameState>("Atari GameState", batchsize, iterations * 100,
+        { "id", "seq", "game_counter", "last_terminal", "last_r", "a", "V" }, init_atari);
+    return 0;
+}
@@ -0,0 +1,139 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//g++ -O3 -march=native -std=c++11 benchmark-uct.cpp -I. -I../vendor -lpthread -o benchmark-uct
+// Usage: ./benchmark-uct [#edges] [iterations] [#threads]
+//
+// Child selection and backprop on one node, with the edge arrays of NodeT versus the
+// unordered_map<A, EdgeInfo> + mutex layout it replaced. Build without -march=native for the scalar loop.
+// Backprop is timed from one thread, then from #threads threads that all update the same node, as the
+// search threads do near the root.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "tree_search_alg.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// The old layout.
+struct MapNode {
+    unordered_map<int, mcts::EdgeInfo> sa;
+    mutex lock;
+
+    int select(float count) const {
+        int best_a = -1;
+        float max_score = std::numeric_limits<float>::lowest();
+        const float sqrt_count1 = sqrt(count + 1);
+        for (const auto &p : sa) {
+            const mcts::EdgeInfo &info = p.second;
+            float score = (info.acc_reward + 0.5) / (info.n + 1) + 0.5 * info.prior / (1 + info.n) * sqrt_count1;
+            if (score > max_score) {
+                max_score = score;
+                best_a = p.first;
+            }
+        }
+        return best_a;
+    }
+
+    void accumulate(int a, float reward) {
+        auto it = sa.find(a);
+        lock_guard<mutex> guard(lock);
+        it->second.acc_reward += reward;
+        it->second.n ++;
+    }
+};
+
+template <typename Func>
+double ns_per_call(int iterations, Func f) {
+    auto start = steady_clock::now();
+    for (int i = 0; i < iterations; ++i) f(i);
+    return duration_cast<duration<double, std::nano>>(steady_clock::now() - start).count() / iterations;
+}
+
+// Wall time per call, with num_threads threads making iterations calls each.
+template <typename Func>
+double ns_per_call_threads(int num_threads, int iterations, Func f) {
+    vector<thread> threads;
+    auto start = steady_clock::now();
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < iterations; ++i) f(t * 7919 + i);
+        });
+    }
+    for (auto &th : threads) th.join();
+    return duration_cast<duration<double, std::nano>>(steady_clock::now() - start).count() / ((double)num_threads * iterations);
+}
+
+int main(int argc, char *argv[]) {
+    int num_edges = argc > 1 ? atoi(argv[1]) : 362;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200000;
+    int num_threads = argc > 3 ? atoi(argv[3]) : 8;
+
+#ifdef __AVX2__
+    cout << "AVX2 selection, " << num_edges << " edges" << endl;
+#else
+    cout << "Scalar selection, " << num_edges << " edges" << endl;
+#endif
+
+    std::mt19937 rng(0);
+    vector<int> actions;
+    vector<mcts::EdgeInfo> infos;
+    MapNode map_node;
+    float count = 0;
+    for (int i = 0; i < num_edges; ++i) {
+        mcts::EdgeInfo info(rng() % 1000 / 1000.0);
+        info.n = rng() % 50;
+        info.acc_reward = info.n * (rng() % 1000 / 1000.0);
+        count += info.n;
+        actions.push_back(i);
+        infos.push_back(info);
+        map_node.sa[i] = info;
+    }
+    mcts::EdgeArrayT<int> edges;
+    edges.Init(actions, infos);
+
+    // Both layouts have to agree on the pick.
+    int picked = mcts::UCT(edges, count).first;
+    if (picked != map_node.select(count)) {
+        cout << "Mismatch: edge arrays picked " << picked << ", map picked " << map_node.select(count) << endl;
+        return 1;
+    }
+
+    volatile int sink = 0;
+    double select_arrays = ns_per_call(iterations, [&](int) { sink = mcts::UCT(edges, count).first; });
+    double select_map = ns_per_call(iterations, [&](int) { sink = map_node.select(count); });
+    double backprop_arrays = ns_per_call(iterations, [&](int i) { edges.Accumulate(i % num_edges, 0.5, 0.0); });
+    double backprop_map = ns_per_call(iterations, [&](int i) { map_node.accumulate(i % num_edges, 0.5); });
+    // Virtual loss is added on the way down and taken back in backprop, as in the search.
+    double backprop_arrays_mt = ns_per_call_threads(num_threads, iterations, [&](int i) {
+        edges.AddVirtualLoss(i % num_edges, 1.0);
+        edges.Accumulate(i % num_edges, 0.5, 1.0);
+    });
+    double backprop_map_mt = ns_per_call_threads(num_threads, iterations, [&](int i) {
+        {
+            lock_guard<mutex> guard(map_node.lock);
+            map_node.sa[i % num_edges].virtual_loss += 1.0;
+        }
+        map_node.accumulate(i % num_edges, 0.5);
+    });
+    (void)sink;
+
+    cout << "  select:   arrays " << select_arrays << " ns, map " << select_map << " ns" << endl;
+    cout << "  backprop: arrays " << backprop_arrays << " ns, map " << backprop_map << " ns" << endl;
+    cout << "  backprop, " << num_threads << " threads: arrays " << backprop_arrays_mt << " ns, map "
+         << backprop_map_mt << " ns (wall time per call)" << endl;
+    return 0;
+}
@@ -16,6 +16,8 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
+#include <memory>
 
 #include "lib/debugutils.hh"
 #ifdef USE_TBB
@@ -122,7 +124,7 @@ class CollectorWithCCQueue {
   }
 
   inline Value* waitOne() {
-    int idx;
+    int idx = -1;
 #ifdef USE_TBB
     while (true)
       if (Q.try_pop(idx))
@@ -135,7 +137,7 @@ class CollectorWithCCQueue {
 
   inline std::pair<Value*, bool> waitOneUntil(int timeout_usec) {
 #ifdef USE_TBB
-    int k;
+    int k = -1;
     if (!Q.try_pop(k)) {
       // Sleep would not efficiently return the element.
       std::this_thread::sleep_for(std::chrono::microseconds(timeout_usec));
@@ -144,7 +146,7 @@ class CollectorWithCCQueue {
     }
     return std::make_pair(_data[k]->val, true);
 #else
-    int k;
+    int k = -1;
     if (Q.wait_dequeue_timed(k, timeout_usec))
       return std::make_pair(_data[k]->val, true);
     else
@@ -181,25 +183,279 @@ class CollectorWithCCQueue {
 
 };
 
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// Collector without per-key mutex handoff.
+// Each key owns a slot with two sequence numbers (#sent and #replied). A waiting game thread
+// spins on its own slot for a while and only parks on the slot's condvar if the reply is late.
+// Pending requests go through a bounded ring whose cells carry their own sequence number
+// (multi-producer, single consumer), so the collector thread never takes a lock unless it runs
+// out of work and parks.
+template <typename Key, typename Value>
+class CollectorWithSlots {
+  // Spinning only pays off if the other side can run at the same time.
+  static int spin_count() {
+    static const int n = std::thread::hardware_concurrency() > 1 ? 4000 : 0;
+    return n;
+  }
+
+  std::unordered_map<Key, int> _index_map;
+
+  struct Slot {
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> replied{0};
+
+    std::atomic_bool parked{false};
+    std::condition_variable cond;
+    std::mutex mutex;
+  };
+  std::vector<std::unique_ptr<Slot>> _slots;
+
+  struct Cell {
+    std::atomic<size_t> seq;
+    Value* val;
+  };
+  std::unique_ptr<Cell[]> _ring;
+  size_t _mask;
+  std::atomic<size_t> _tail{0};
+  // Only touched by the consumer (collector) thread.
+  size_t _head = 0;
+
+  std::atomic_bool _consumer_parked{false};
+  std::condition_variable _consumer_cond;
+  std::mutex _consumer_mutex;
+
+  int get_index(const Key &key) const {
+    auto it = _index_map.find(key);
+    if (it == _index_map.end()) {
+        std::cout << "key [" << key << "] not found! this should never happen! " << std::endl;
+        return -1;
+    }
+    return it->second;
+  }
+
+  bool try_push(Value* value) {
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    while (true) {
+      Cell &cell = _ring[pos & _mask];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.val = value;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        // Ring is full.
+        return false;
+      } else {
+        pos = _tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(Value** value) {
+    Cell &cell = _ring[_head & _mask];
+    size_t seq = cell.seq.load(std::memory_order_acquire);
+    if ((intptr_t)seq - (intptr_t)(_head + 1) < 0) return false;
+    *value = cell.val;
+    cell.seq.store(_head + _mask + 1, std::memory_order_release);
+    _head ++;
+    return true;
+  }
+
+  bool spin_pop(Value** value) {
+    for (int i = 0; i < spin_count(); ++i) {
+      if (try_pop(value)) return true;
+      cpu_relax();
+    }
+    return false;
+  }
+
+  void enqueue(Value* value) {
+    while (! try_push(value)) cpu_relax();
+    // Make the push visible before checking whether the consumer sleeps.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_consumer_parked.load()) {
+      std::lock_guard<std::mutex> lg(_consumer_mutex);
+      _consumer_cond.notify_one();
+    }
+  }
+
+  inline void notify(Slot &slot) {
+    slot.replied.fetch_add(1);
+    if (slot.parked.load()) {
+      std::lock_guard<std::mutex> lg(slot.mutex);
+      slot.cond.notify_one();
+    }
+  }
+
+  void wait_slot(Slot &slot, uint64_t target) {
+    for (int i = 0; i < spin_count(); ++i) {
+      if (slot.replied.load(std::memory_order_acquire) >= target) return;
+      cpu_relax();
+    }
+    std::unique_lock<std::mutex> lk(slot.mutex);
+    slot.parked.store(true);
+    while (slot.replied.load() < target)
+      slot.cond.wait(lk);
+    slot.parked.store(false);
+  }
+
+  public:
+  explicit CollectorWithSlots(const std::vector<Key> &keys) {
+      for (size_t i = 0; i < keys.size(); ++i) {
+          _slots.emplace_back(new Slot{});
+          _index_map.emplace(keys[i], i);
+      }
+      // Every key has at most one request in flight. Leave some room for wakeup messages.
+      size_t capacity = 2;
+      while (capacity < keys.size() + 16) capacity <<= 1;
+      _ring.reset(new Cell[capacity]);
+      for (size_t i = 0; i < capacity; ++i) {
+          _ring[i].seq.store(i, std::memory_order_relaxed);
+          _ring[i].val = nullptr;
+      }
+      _mask = capacity - 1;
+  }
+
+  CollectorWithSlots(const CollectorWithSlots&) = delete;
+
+  void sendData(const Key& key, Value* value) {
+    // A nullptr value is a wakeup message, it does not own a slot.
+    if (value != nullptr) {
+      int index = get_index(key);
+      if (index < 0) throw std::range_error("[sendData] key " + std::to_string(key) + " not found!");
+      _slots[index]->sent.fetch_add(1);
+    }
+    enqueue(value);
+  }
+
+  void signalReply(const Key& key) {
+    int index = get_index(key);
+    if (index < 0) throw std::range_error("[signalReply] key " + std::to_string(key) + " not found!");
+    notify(*_slots[index]);
+  }
+
+  void waitReply(const Key& key) {
+    int index = get_index(key);
+    if (index < 0) throw std::range_error("[waitReply] key " + std::to_string(key) + " not found!");
+
+    Slot &slot = *_slots[index];
+    wait_slot(slot, slot.sent.load());
+  }
+
+  void sendDataWaitReply(const Key& key, Value* value) {
+    sendData(key, value);
+    waitReply(key);
+  }
+
+  // The following functions can only be called from the consumer thread.
+  inline Value* waitOne() {
+    Value* v;
+    while (true) {
+      if (spin_pop(&v)) return v;
+
+      std::unique_lock<std::mutex> lk(_consumer_mutex);
+      _consumer_parked.store(true);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (try_pop(&v)) {
+        _consumer_parked.store(false);
+        return v;
+      }
+      _consumer_cond.wait(lk);
+      _consumer_parked.store(false);
+    }
+  }
+
+  inline std::pair<Value*, bool> waitOneUntil(int timeout_usec) {
+    Value* v;
+    if (spin_pop(&v)) return std::make_pair(v, true);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_usec);
+    std::unique_lock<std::mutex> lk(_consumer_mutex);
+    _consumer_parked.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool got = try_pop(&v);
+    while (! got) {
+      if (_consumer_cond.wait_until(lk, deadline) == std::cv_status::timeout) {
+        got = try_pop(&v);
+        break;
+      }
+      got = try_pop(&v);
+    }
+    _consumer_parked.store(false);
+    if (got) return std::make_pair(v, true);
+    else return std::make_pair(nullptr, false);
+  }
+
+  // signal reply to all data currently waiting
+  void signalReplyAll() {
+    Value* v;
+    while (try_pop(&v)) { }
+
+    for (auto& slot: _slots) {
+      uint64_t sent = slot->sent.load();
+      uint64_t replied = slot->replied.load();
+      while (replied < sent && ! slot->replied.compare_exchange_weak(replied, sent)) { }
+      std::lock_guard<std::mutex> lg(slot->mutex);
+      slot->cond.notify_one();
+    }
+  }
+};
+
 template <typename A, typename B>
 using CollectorT = CollectorWithCCQueue<A, B>;
 
-
+// Interface used by CollectorGroupT, so that the collector backend can be picked at runtime.
 template <typename Key, typename Value>
-class BatchCollectorT: public CollectorT<Key, Value> {
+class BatchCollectorBaseT {
   public:
     using BatchValue = std::vector<Value*>;
 
+    virtual void sendData(const Key& key, Value* value) = 0;
+    virtual void signalReply(const Key& key) = 0;
+    virtual void waitReply(const Key& key) = 0;
+
+    // non reentrable
+    virtual BatchValue waitBatch(int batch_size, int timeout_usec = 0, int timeout_usec_first_item = 0) = 0;
+    // When the first item of the last batch returned by waitBatch was taken.
+    virtual std::chrono::steady_clock::time_point firstItemTime() const = 0;
+    // When its last item was taken.
+    virtual std::chrono::steady_clock::time_point lastItemTime() const = 0;
+
+    virtual ~BatchCollectorBaseT() { }
+};
+
+template <typename Key, typename Value, template <typename, typename> class Collector = CollectorT>
+class BatchCollectorT: public BatchCollectorBaseT<Key, Value>, public Collector<Key, Value> {
+  public:
+    using BatchValue = std::vector<Value*>;
+    using CollectorImpl = Collector<Key, Value>;
+
     explicit BatchCollectorT(const std::vector<Key> &keys):
-      CollectorT<Key, Value>{keys} {}
+      CollectorImpl{keys} {}
+
+    void sendData(const Key& key, Value* value) override { CollectorImpl::sendData(key, value); }
+    void signalReply(const Key& key) override { CollectorImpl::signalReply(key); }
+    void waitReply(const Key& key) override { CollectorImpl::waitReply(key); }
 
     // non reentrable
-    BatchValue waitBatch(int batch_size, int timeout_usec = 0, int timeout_usec_first_item = 0) {
+    BatchValue waitBatch(int batch_size, int timeout_usec = 0, int timeout_usec_first_item = 0) override {
         while ((int)_batch.size() < batch_size) {
             Value *v = nullptr;
             auto res = (_batch.empty() ? _wait(timeout_usec_first_item) : _wait(timeout_usec));
             if (! res.second) break;
             v = res.first;
+            _last_item_time = std::chrono::steady_clock::now();
+            if (_batch.empty()) _first_item_time = _last_item_time;
             _batch.emplace_back(v);
         }
         BatchValue ret;
@@ -207,12 +463,22 @@ class BatchCollectorT: public CollectorT<Key, Value> {
         return ret;
     }
 
+    std::chrono::steady_clock::time_point firstItemTime() const override { return _first_item_time; }
+    std::chrono::steady_clock::time_point lastItemTime() const override { return _last_item_time; }
+
   private:
     std::vector<Value*> _batch;
+    std::chrono::steady_clock::time_point _first_item_time, _last_item_time;
 
     std::pair<Value *, bool> _wait(int timeout_usec) {
         return (timeout_usec == 0 ? std::make_pair(this->waitOne(), true) : this->waitOneUntil(timeout_usec));
     }
 };
 
+template <typename Key, typename Value>
+BatchCollectorBaseT<Key, Value> *CreateBatchCollector(const std::vector<Key> &keys, bool lockfree) {
+    if (lockfree) return new BatchCollectorT<Key, Value, CollectorWithSlots>(keys);
+    else return new BatchCollectorT<Key, Value, CollectorWithCCQueue>(keys);
+}
+
 }  // namespace elf
@@ -33,14 +33,19 @@ struct GroupStat {
     int gid;
     int hist_len;
     std::string name;
+    // Number of batches in flight. Each one gets its own gid (consecutive, starting from gid) and tensors.
+    int num_inflight;
+    // If > 0, the batch size (up to the one given to AddCollectors) and the timeout are tuned
+    // so that the p99 latency of a batch stays below this.
+    int target_p99_usec;
 
-    GroupStat() : gid(-1), hist_len(1) { }
+    GroupStat() : gid(-1), hist_len(1), num_inflight(1), target_p99_usec(0) { }
     std::string info() const {
-        return "[gid=" + std::to_string(gid) + "][T=" + std::to_string(hist_len) + "][name=\"" + name + "\"]";
+        return "[gid=" + std::to_string(gid) + "][T=" + std::to_string(hist_len) + "][name=\"" + name + "\"][inflight=" + std::to_string(num_inflight) + "][target_p99_usec=" + std::to_string(target_p99_usec) + "]";
     }
 
     // Note that gid will be set by C++ side.
-    REGISTER_PYBIND_FIELDS(hist_len, name);
+    REGISTER_PYBIND_FIELDS(hist_len, name, num_inflight, target_p99_usec);
 };
 
 #define ADD_COND_CHECK(field_name) \
@@ -167,11 +172,25 @@ public:
         init_stats();
     }
 
+    // Return the gid of the first in-flight batch, the others follow it.
     int AddCollectors(int batchsize, int exclusive_id, int timeout_usec, const GroupStat &gstat) {
+        // A game writes its rows at the stride of the full batch, while CopyToMem packs a partial batch.
+        // The two layouts are only the same with a single step of history.
+        bool zero_copy = _context_options.zero_copy_batch;
+        if (zero_copy && gstat.hist_len != 1) {
+            std::cout << "Zero-copy batch needs T == 1, copying the batch for group " << gstat.info() << std::endl;
+            zero_copy = false;
+        }
         _groups.emplace_back(new CollectorGroup(_groups.size(), _keys, batchsize, _signal.get(),
-                    _context_options.verbose_collector, timeout_usec));
+                    _context_options.verbose_collector, timeout_usec,
+                    _context_options.lockfree_collector, zero_copy, gstat.target_p99_usec));
         int gid = _groups.size() - 1;
 
+        // The extra in-flight batches only get requests through the first one.
+        for (int i = 1; i < gstat.num_inflight; ++i) {
+            _groups.emplace_back(new CollectorGroup(_groups.size(), *_groups[gid], gstat.target_p99_usec));
+        }
+
         if ((int)_exclusive_groups.size() <= exclusive_id) {
             _exclusive_groups.emplace_back();
         }
@@ -213,6 +232,15 @@ public:
 
     // Agent side.
     bool SendDataWaitReply(const Key& key, In& info) {
+        std::vector<int> selected_groups;
+        if (! SendData(key, info, &selected_groups)) return false;
+        WaitReply(key, selected_groups);
+        return true;
+    }
+
+    // Send without waiting, so that one thread can have requests of several keys in the same batch.
+    // The groups the data went to are returned in selected_groups and have to be passed to WaitReply.
+    bool SendData(const Key& key, In& info, std::vector<int> *selected_groups) {
         auto it = _map.find(key);
         if (it == _map.end()) {
             V_PRINT(_verbose, "[k=" << key << "] seq = " << info.data.newest().seq << " hist_len = " << info.data.size() << ", key[" << key << "] invalid! ");
@@ -223,7 +251,7 @@ public:
 
         V_PRINT(_verbose, "[k=" << key << "] Start sending data, seq = " << info.data.newest().seq << " hist_len = " << info.data.size());
         // Send the key to all collectors in the container, if the key satisfy the gating function.
-        std::vector<int> selected_groups;
+        selected_groups->clear();
         std::string str_selected_groups;
 
         // For each exclusive group, randomly select one.
@@ -237,16 +265,25 @@ public:
 
                 _groups[gstat.gid]->SendData(key, &info);
                 str_selected_groups += std::to_string(gstat.gid) + ",";
-                selected_groups.push_back(gstat.gid);
+                selected_groups->push_back(gstat.gid);
             }
         }
 
+        V_PRINT(_verbose, "[k=" << key << "] Sent to " << selected_groups->size() << " groups " << str_selected_groups);
+        return true;
+    }
+
+    void WaitReply(const Key& key, const std::vector<int> &selected_groups) {
         if (! selected_groups.empty()) {
-            V_PRINT(_verbose, "[k=" << key << "] Sent to " << selected_groups.size() << " groups " << str_selected_groups << " waiting for the data to be processed");
+            V_PRINT(_verbose, "[k=" << key << "] Waiting for the data to be processed by " << selected_groups.size() << " groups");
+            Stat &stats = _map.find(key)->second;
 
             // Wait until all collectors have done their jobs.
-            stats.counter->wait(selected_groups.size());
-            stats.counter->reset();
+            // The lock-free collector only releases a game after its batch is used, so WaitReply is enough.
+            if (! _context_options.lockfree_collector) {
+                stats.counter->wait(selected_groups.size());
+                stats.counter->reset();
+            }
 
             V_PRINT(_verbose, "[k=" << key << "] All " << selected_groups.size() << " has done their jobs, Wait until the game is released");
 
@@ -257,7 +294,6 @@ public:
         }
 
         V_PRINT(_verbose, "[k=" << key << "] Done with SendDataWaitReply");
-        return true;
     }
 
     // Daemon side.
@@ -269,11 +305,13 @@ public:
         // For invalid infos, return.
         if (infos.gid < 0) return false;
 
-        std::vector<Key> keys = _groups[infos.gid]->GetBatchKeys();
-        for (const Key &key : keys) {
-            auto it = _map.find(key);
-            if (it != _map.end()) {
-                it->second.counter->notify();
+        if (! _context_options.lockfree_collector) {
+            std::vector<Key> keys = _groups[infos.gid]->GetBatchKeys();
+            for (const Key &key : keys) {
+                auto it = _map.find(key);
+                if (it != _map.end()) {
+                    it->second.counter->notify();
+                }
             }
         }
         _groups[infos.gid]->SignalBatchUsed(future_time_usec);
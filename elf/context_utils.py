@@ -21,6 +21,8 @@ class ContextArgs:
                 ("eval", dict(action="store_true")),
                 ("wait_per_group", dict(action="store_true")),
                 ("num_collectors", 0),
+                ("lockfree_collector", dict(action="store_true")),
+                ("zero_copy_batch", dict(action="store_true")),
                 ("verbose_comm", dict(action="store_true")),
                 ("verbose_collector", dict(action="store_true")),
                 ("mcts_threads", 0),
@@ -32,6 +34,12 @@ class ContextArgs:
                 ("mcts_use_prior", dict(action="store_true")),
                 ("mcts_pseudo_games", 0),
                 ("mcts_pick_method", "most_visited"),
+                ("mcts_virtual_loss", 0.0),
+                ("mcts_leaves_per_thread", 1),
+                ("mcts_tt_size", 0),
+                ("mcts_time_ms", 0),
+                ("mcts_persistent_tree", dict(action="store_true")),
+                ("mcts_ponder", dict(action="store_true")),
             ],
             on_get_args = self._on_get_args
         )
@@ -54,8 +62,11 @@ class ContextArgs:
         co.verbose_comm = args.verbose_comm
         co.verbose_collector = args.verbose_collector
 
-        co.max_num_threads = args.mcts_threads
+        # Each MCTS thread may use one AIComm per leaf.
+        co.max_num_threads = args.mcts_threads * args.mcts_leaves_per_thread
         co.num_collectors = args.num_collectors
+        co.lockfree_collector = args.lockfree_collector
+        co.zero_copy_batch = args.zero_copy_batch
 
         mcts = co.mcts_options
 
@@ -67,5 +78,11 @@ class ContextArgs:
         mcts.use_prior = args.mcts_use_prior
         mcts.pseudo_games = args.mcts_pseudo_games
         mcts.pick_method = args.mcts_pick_method
+        mcts.virtual_loss = args.mcts_virtual_loss
+        mcts.num_leaves_per_thread = args.mcts_leaves_per_thread
+        mcts.tt_size = args.mcts_tt_size
+        mcts.time_ms_per_move = args.mcts_time_ms
+        mcts.persistent_tree = args.mcts_persistent_tree
+        mcts.ponder = args.mcts_ponder
 
 
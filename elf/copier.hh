@@ -26,6 +26,11 @@ class FieldMemoryManager {
     virtual void copy_to_mem(const Struct& s, void* dst) = 0;
     virtual void copy_from_mem(const void *src, Struct& s) = 0;
 
+    // Gather this field of n states into consecutive rows starting at dst, return the end of the last row.
+    // One call per (key, batch), so the per-item loop is type-specialized and free of virtual calls.
+    virtual char* copy_batch_to_mem(const Struct* const* states, size_t n, char* dst) = 0;
+    virtual const char* copy_batch_from_mem(const char* src, Struct* const* states, size_t n) = 0;
+
     // return size of buffer required to store this field, in bytes
     virtual size_t size(const Struct& s) const = 0;
 
@@ -76,6 +81,23 @@ class FieldMemoryManagerT<Struct, FieldT,
       memcpy(dstptr, src, sizeof(FieldT));  // should work for basic type, arrays, structs
     }
 
+    char* copy_batch_to_mem(const Struct* const* states, size_t n, char* dst) override {
+      // sizeof(FieldT) is known here, so each memcpy becomes a couple of moves.
+      for (size_t i = 0; i < n; ++i) {
+        memcpy(dst, reinterpret_cast<const char*>(states[i]) + this->_offset, sizeof(FieldT));
+        dst += sizeof(FieldT);
+      }
+      return dst;
+    }
+
+    const char* copy_batch_from_mem(const char* src, Struct* const* states, size_t n) override {
+      for (size_t i = 0; i < n; ++i) {
+        memcpy(reinterpret_cast<char*>(states[i]) + this->_offset, src, sizeof(FieldT));
+        src += sizeof(FieldT);
+      }
+      return src;
+    }
+
     size_t size(const Struct&) const override { return sizeof(FieldT); }
 
     std::string type() const override { return std::string(TypeStr<FieldT>::str); }
@@ -107,6 +129,27 @@ class FieldMemoryManagerT<Struct, VecT,
       memcpy(dstptr->data(), src, dstptr->size() * sizeof(typename VecT::value_type));
     }
 
+    char* copy_batch_to_mem(const Struct* const* states, size_t n, char* dst) override {
+      // The vector payloads are contiguous, so this is one wide memcpy per row.
+      for (size_t i = 0; i < n; ++i) {
+        const VecT* srcptr = reinterpret_cast<const VecT*>(reinterpret_cast<const char*>(states[i]) + this->_offset);
+        size_t bytes = srcptr->size() * sizeof(typename VecT::value_type);
+        memcpy(dst, srcptr->data(), bytes);
+        dst += bytes;
+      }
+      return dst;
+    }
+
+    const char* copy_batch_from_mem(const char* src, Struct* const* states, size_t n) override {
+      for (size_t i = 0; i < n; ++i) {
+        VecT* dstptr = reinterpret_cast<VecT*>(reinterpret_cast<char*>(states[i]) + this->_offset);
+        size_t bytes = dstptr->size() * sizeof(typename VecT::value_type);
+        memcpy(dstptr->data(), src, bytes);
+        src += bytes;
+      }
+      return src;
+    }
+
     size_t size(const Struct& s) const override {
       const VecT* srcptr = reinterpret_cast<const VecT*>(reinterpret_cast<const char*>(&s) + this->_offset);
       return srcptr->size() * sizeof(typename VecT::value_type);
@@ -190,18 +233,23 @@ struct CopyItemT {
       p += mm->size(s);
       return p;
     }
+
+    char *CopyBatchToMem(const std::vector<const State *> &batch, char *p) const {
+      return mm->copy_batch_to_mem(batch.data(), batch.size(), p);
+    }
+
+    const char *CopyBatchFromMem(const std::vector<State *> &batch, const char *p) const {
+      return mm->copy_batch_from_mem(p, batch.data(), batch.size());
+    }
 };
 
 template <typename State>
 void CopyToMem(const std::vector<CopyItemT<State>> &copier, const std::vector<State *> &batch) {
   if (batch.empty()) return;
+  std::vector<const State *> rows(batch.begin(), batch.end());
   for (const auto& item: copier) {
     m_assert(item.Check(*batch[0], batch.size()));
-
-    char *p = item.ptr();
-    for (auto* s: batch) {
-       p = item.CopyToMem(*s, p);
-    }
+    item.CopyBatchToMem(rows, item.ptr());
   }
 }
 
@@ -210,11 +258,7 @@ void CopyFromMem(const std::vector<CopyItemT<State>> &copier, std::vector<State
   if (batch.empty()) return;
   for (const auto& item: copier) {
     m_assert(item.Check(*batch[0], batch.size()));
-
-    const char *p = item.ptr();
-    for (auto* s: batch) {
-       p = item.CopyFromMem(*s, p);
-    }
+    item.CopyBatchFromMem(batch, item.ptr());
   }
 }
 
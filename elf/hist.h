@@ -72,6 +72,7 @@ void CopyToMem(const std::vector<CopyItemT<State>> &copier, const std::vector<Hi
   if (batch.empty()) return;
   size_t batchsize = batch.size();
   size_t overall_hist_len = batch[0]->size();
+  std::vector<const State *> rows(batchsize);
 
   for (const auto& item: copier) {
     size_t capacity = item.Capacity(batch[0]->newest());
@@ -82,28 +83,46 @@ void CopyToMem(const std::vector<CopyItemT<State>> &copier, const std::vector<Hi
     // std::cout << "key = " << item.key << ". p = " << std::hex << (void *)p << std::dec << " min_hist_len = " << min_hist_len << std::endl;
     //
     for (size_t t = 0; t < min_hist_len; ++t) {
-      for (auto* s: batch) {
-        const State &state = s->newest(min_hist_len - t - 1);
-        p = item.CopyToMem(state, p);
-      }
+      for (size_t j = 0; j < batchsize; ++j) rows[j] = &batch[j]->newest(min_hist_len - t - 1);
+      p = item.CopyBatchToMem(rows, p);
     }
     if (hist_len > overall_hist_len) {
       // Fill them with the oldest hist.
+      for (size_t j = 0; j < batchsize; ++j) rows[j] = &batch[j]->newest(min_hist_len - 1);
       for (size_t i = overall_hist_len; i < hist_len; ++i) {
-        for (auto *s: batch) {
-          const State &state = s->newest(min_hist_len - 1);
-          p = item.CopyToMem(state, p);
-        }
+        p = item.CopyBatchToMem(rows, p);
       }
     }
   }
 }
 
+// Write the history of a single game into its own row of each entry.
+// Entries are laid out as [hist_len][batchsize], which is how the python side slices them. This is the
+// layout of CopyToMem only when hist_len == 1, so zero-copy batches are limited to T == 1.
+template <typename State>
+void CopyToMemRow(const std::vector<CopyItemT<State>> &copier, const HistT<State> &h, int slot, int batchsize) {
+  size_t overall_hist_len = h.size();
+
+  for (const auto& item: copier) {
+    size_t sz = item.mm->size(h.newest());
+    size_t hist_len = item.buf.size() / (sz * batchsize);
+    size_t min_hist_len = std::min(hist_len, overall_hist_len);
+
+    for (size_t t = 0; t < hist_len; ++t) {
+      // Same order as CopyToMem: oldest first, then pad with the oldest hist.
+      size_t i = (t < min_hist_len ? min_hist_len - t - 1 : min_hist_len - 1);
+      char *p = item.ptr() + (t * batchsize + slot) * sz;
+      item.CopyToMem(h.newest(i), p);
+    }
+  }
+}
+
 template <typename State>
 void CopyFromMem(const std::vector<CopyItemT<State>> &copier, std::vector<HistT<State> *> &batch) {
   if (batch.empty()) return;
   size_t batchsize = batch.size();
   size_t overall_hist_len = batch[0]->size();
+  std::vector<State *> rows(batchsize);
 
   for (const auto& item: copier) {
     size_t capacity = item.Capacity(batch[0]->newest());
@@ -112,10 +131,8 @@ void CopyFromMem(const std::vector<CopyItemT<State>> &copier, std::vector<HistT<
 
     const char *p = item.ptr();
     for (size_t t = 0; t < min_hist_len; ++t) {
-      for (auto* s: batch) {
-         State &state = s->newest(min_hist_len - t - 1);
-         p = item.CopyFromMem(state, p);
-       }
+      for (size_t j = 0; j < batchsize; ++j) rows[j] = &batch[j]->newest(min_hist_len - t - 1);
+      p = item.CopyBatchFromMem(rows, p);
     }
   }
 }
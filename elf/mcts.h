@@ -30,13 +30,23 @@ public:
     using MCTSAI = MCTSAI_T<Actor>;
     using TreeSearch = mcts::TreeSearchT<State, Action, Actor>;
 
+    MEMBER_FUNC_CHECK(moves_since)
+
     MCTSAI_T(const mcts::TSOptions &options, std::function<Actor *(int)> gen)
         : options_(options) {
         ts_.reset(new TreeSearch(options_, gen));
+        if (options_.ponder && (! options_.persistent_tree || ! has_func_moves_since<State>::value)) {
+            cout << "MCTSAI: pondering needs persistent_tree and State::moves_since, it is off" << endl;
+            options_.ponder = false;
+        }
     }
 
     const mcts::TSOptions &options() const { return options_; }
     TreeSearch *GetEngine() { return ts_.get(); }
+    // Result of the last Act, with the visit distribution at the root (e.g., for self-play records).
+    const mcts::MCTSResultT<Action> &last_result() const { return last_result_; }
+    // Hit rate and size of the transposition table (empty without one), e.g., to size tt_size.
+    mcts::TTStats GetTTStats() const { return ts_->GetTTStats(); }
 
     bool Act(const State &s, Action *a, const std::atomic_bool *) override {
         if (! options_.persistent_tree) {
@@ -49,19 +59,27 @@ public:
             elf_utils::MyClock clock;
             clock.Restart();
 
-            auto res = ts_->Run(s);
-            *a = res.best_a;
+            last_result_ = ts_->Run(s);
+            *a = last_result_.best_a;
 
             clock.Record("MCTS");
-            cout << "[" << this->id() << "] MCTSAI Result: " << res.info() << " Action:" << res.best_a << endl;
+            cout << "[" << this->id() << "] MCTSAI Result: " << last_result_.info() << " Action:" << last_result_.best_a << endl;
             cout << clock.Summary() << endl;
+            if (options_.tt_size > 0) cout << "[" << this->id() << "] " << GetTTStats().info() << endl;
         } else {
-            auto res = ts_->Run(s);
-            *a = res.best_a;
+            last_result_ = ts_->Run(s);
+            *a = last_result_.best_a;
         }
+
+        if (options_.ponder) start_ponder(*a);
         return true;
     }
 
+    // Stop the background search, e.g. before the AIComms of the actors are restarted.
+    void StopPonder() {
+        ts_->StopPonder();
+    }
+
     bool GameEnd() override {
         reset_tree();
         return true;
@@ -88,11 +106,24 @@ protected:
 private:
     mcts::TSOptions options_;
     unique_ptr<TreeSearch> ts_;
-    int move_number_;
+    mcts::MCTSResultT<Action> last_result_;
+    int move_number_ = -1;
+
+    // Our last move, which the tree has already advanced by while pondering.
+    bool own_move_advanced_ = false;
+    Action own_move_;
 
     void reset_tree() {
         ts_->Clear();
         move_number_ = -1;
+        own_move_advanced_ = false;
+    }
+
+    void start_ponder(const Action &a) {
+        ts_->TreeAdvance(a);
+        own_move_advanced_ = true;
+        own_move_ = a;
+        ts_->StartPonder();
     }
 
     // Note that moves_since should have the following signature.
@@ -100,12 +131,22 @@ private:
     // It will compare the current move_number to the move number in the state, and return moves since the last move number.
     // If the input move_number is negative, then it will return all moves since the game started.
     // Once it is done, the move_number will be advanced to the most recent move number.
-    MEMBER_FUNC_CHECK(moves_since)
+    // If we pondered, the first of these moves is our own move, which is already done.
     template <typename S_ = State, typename std::enable_if<has_func_moves_since<S_>::value>::type *U = nullptr>
     void advance_moves(const S_ &s) {
         auto recent_moves = s.moves_since(&move_number_);
-        for (const Action &prev_move : recent_moves) {
-            ts_->TreeAdvance(prev_move);
+        auto it = recent_moves.begin();
+        if (own_move_advanced_) {
+            own_move_advanced_ = false;
+            if (it == recent_moves.end() || ! (*it == own_move_)) {
+                // Our move was not played, the tree is for another position.
+                ts_->Clear();
+                return;
+            }
+            ++ it;
+        }
+        for (; it != recent_moves.end(); ++it) {
+            ts_->TreeAdvance(*it);
         }
     }
     template <typename S_ = State, typename std::enable_if<!has_func_moves_since<S_>::value>::type *U = nullptr>
@@ -124,10 +165,10 @@ public:
         : ai_comm_(ai_comm) {
         static_assert(std::is_same<ActorParam, void>::value, "The constructor requires ActorParam to be void (or omitted)");
         // Construct a few DirectPredictAIs.
-        spawn_aicomms(options.num_threads);
+        spawn_aicomms(options, std::is_constructible<Actor, const vector<AIComm *> &>::value);
 
         // cout << "#ai = " << ai_dup.size() << endl;
-        auto actor_gen = [&](int i) { return new Actor(ai_comms_[i].get()); };
+        auto actor_gen = [&](int i) { return new_actor<Actor>(i); };
         // cout << "Done with MCTSAI_T::InitAIComm" << endl;
         mcts_ai_.reset(new MCTSAI(options, actor_gen));
     }
@@ -136,10 +177,10 @@ public:
         : ai_comm_(ai_comm) {
         static_assert(! std::is_same<ActorParam, void>::value, "The constructor requires ActorParam to be set (not void)");
         // Construct a few DirectPredictAIs.
-        spawn_aicomms(options.num_threads);
+        spawn_aicomms(options, std::is_constructible<Actor, const vector<AIComm *> &, const ActorParam &>::value);
 
         // cout << "#ai = " << ai_dup.size() << endl;
-        auto actor_gen = [&](int i) { return new Actor(ai_comms_[i].get(), *params); };
+        auto actor_gen = [&](int i) { return new_actor<Actor>(i, *params); };
         // cout << "Done with MCTSAI_T::InitAIComm" << endl;
         mcts_ai_.reset(new MCTSAI(options, actor_gen));
     }
@@ -151,6 +192,8 @@ public:
     MCTSAI *get() { return mcts_ai_.get(); }
 
     bool GameEnd() override {
+        // The background search must not use the AIComms while they restart.
+        mcts_ai_->StopPonder();
         // Restart _ai_comm.
         ai_comm_->Restart();
         for (auto &ai_comm : ai_comms_) {
@@ -168,15 +211,41 @@ private:
     AIComm *ai_comm_;
     vector<unique_ptr<AIComm>> ai_comms_;
     unique_ptr<MCTSAI> mcts_ai_;
+    int comms_per_thread_ = 1;
+
+    void spawn_aicomms(const mcts::TSOptions &options, bool comm_per_leaf) {
+        // Actors that can take a list of AIComms get one per leaf, so that all leaves of a thread
+        // can wait for the same batch. Thread i owns AIComms [i * comms_per_thread_, (i + 1) * comms_per_thread_).
+        // Note that the context then needs max_num_threads >= num_threads * num_leaves_per_thread.
+        comms_per_thread_ = comm_per_leaf ? std::max(options.num_leaves_per_thread, 1) : 1;
 
-    void spawn_aicomms(int num_threads) {
         // Construct a few DirectPredictAIs.
         ai_comms_.clear();
-        for (int i = 0; i < num_threads; ++i) {
+        for (int i = 0; i < options.num_threads * comms_per_thread_; ++i) {
             ai_comms_.emplace_back(ai_comm_->Spawn(i));
         }
     }
 
+    vector<AIComm *> thread_aicomms(int i) const {
+        vector<AIComm *> comms;
+        for (int j = 0; j < comms_per_thread_; ++j) {
+            comms.push_back(ai_comms_[i * comms_per_thread_ + j].get());
+        }
+        return comms;
+    }
+
+    template <typename Actor_, typename... Params>
+    typename std::enable_if<std::is_constructible<Actor_, const vector<AIComm *> &, const Params &...>::value, Actor_ *>::type
+    new_actor(int i, const Params &... params) {
+        return new Actor_(thread_aicomms(i), params...);
+    }
+
+    template <typename Actor_, typename... Params>
+    typename std::enable_if<! std::is_constructible<Actor_, const vector<AIComm *> &, const Params &...>::value, Actor_ *>::type
+    new_actor(int i, const Params &... params) {
+        return new Actor_(ai_comms_[i * comms_per_thread_].get(), params...);
+    }
+
     // cout << "#ai = " << ai_dup.size() << endl;
     std::function<Actor *(int)> actor_gen() {
         return [&](int i) { return new Actor(ai_comms_[i].get()); };
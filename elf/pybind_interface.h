@@ -35,6 +35,9 @@ void register_common_func(py::module &m) {
     .def(py::init<>())
     .def("info", &GroupStat::info);
 
+  PYCLASS_WITH_FIELDS(m, elf::BatchControllerStats)
+    .def(py::init<>());
+
   PYCLASS_WITH_FIELDS(m, Infos)
     .def(py::init<>())
     .def("batchsize", &Infos::batchsize);
@@ -67,6 +70,9 @@ void register_common_func(py::module &m) {
   std::string GetCollectorInfos() const { \
     return context->comm().GetCollectorInfos(); \
   } \
+  elf::BatchControllerStats GetCollectorStats(int gid) const { \
+    return context->comm().GetCollectorGroup(gid).GetStats(); \
+  } \
   int size() const { return context->size(); } \
   EntryInfo GetTensorSpec(int gid, const std::string &key, int T) { \
       return context->comm().GetCollectorGroup(gid).GetEntry(key, T, [&](const std::string &key) { return EntryFunc(key); }); \
@@ -76,9 +82,12 @@ void register_common_func(py::module &m) {
   } \
 
 
-#define CONTEXT_REGISTER(GameContext) \
+#define CONTEXT_REGISTER(GameContext) CONTEXT_REGISTER_AS(GameContext, #GameContext)
+
+// Register GameContext under another python name (e.g., one per board size).
+#define CONTEXT_REGISTER_AS(GameContext, name) \
   using GC = typename GameContext::GC; \
-  py::class_<GameContext>(m, #GameContext) \
+  py::class_<GameContext>(m, name) \
     .def(py::init<const ContextOptions&, const GC::Options&>()) \
     .def("Wait", &GameContext::Wait, py::call_guard<py::gil_scoped_release>()) \
     .def("WaitGroup", &GameContext::WaitGroup, py::call_guard<py::gil_scoped_release>()) \
@@ -93,5 +102,6 @@ void register_common_func(py::module &m) {
     .def("AddTensor", &GameContext::AddTensor) \
     .def("GetTensorSpec", &GameContext::GetTensorSpec, py::return_value_policy::copy) \
     .def("GetCollectorInfos", &GameContext::GetCollectorInfos) \
+    .def("GetCollectorStats", &GameContext::GetCollectorStats, py::return_value_policy::copy) \
 
 
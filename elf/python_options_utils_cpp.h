@@ -36,6 +36,14 @@ struct ContextOptions {
 
     int num_collectors = 1;
 
+    // Use the lock-free collector (per-key sequence numbers, spin-then-park) instead of
+    // the mutex/condvar handoff of CollectorWithCCQueue.
+    bool lockfree_collector = false;
+
+    // Each game reserves a row of the batch tensors and writes its input there directly,
+    // instead of the collector copying the whole batch once it is formed.
+    bool zero_copy_batch = false;
+
     mcts::TSOptions mcts_options;
 
     ContextOptions() {}
@@ -48,10 +56,12 @@ struct ContextOptions {
       if (verbose_comm) std::cout << "Comm Verbose On" << std::endl;
       if (verbose_collector) std::cout << "Comm Collector On" << std::endl;
       std::cout << "Wait per group: " << (wait_per_group ? "True" : "False") << std::endl;
+      std::cout << "Lock-free collector: " << (lockfree_collector ? "True" : "False") << std::endl;
+      std::cout << "Zero-copy batch: " << (zero_copy_batch ? "True" : "False") << std::endl;
       std::cout << mcts_options.info() << std::endl;
     }
 
-    REGISTER_PYBIND_FIELDS(num_games, max_num_threads, T, verbose_comm, verbose_collector, wait_per_group, mcts_options, num_collectors);
+    REGISTER_PYBIND_FIELDS(num_games, max_num_threads, T, verbose_comm, verbose_collector, wait_per_group, mcts_options, num_collectors, lockfree_collector, zero_copy_batch);
 };
 
 inline constexpr int get_query_id(int game_id, int thread_id) {
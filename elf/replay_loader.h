@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <deque>
+
 #include "shared_replay_buffer.h"
 
 namespace elf {
@@ -20,16 +22,21 @@ public:
     using RIterator = typename Record::iterator;
     using RBuffer = SharedReplayBuffer<K, Record>;
     using GenFunc = typename RBuffer::GenFunc;
+    using SizeFunc = typename RBuffer::SizeFunc;
 
-    static void Init(GenFunc func) {
-        _rbuffer.reset(new RBuffer(func));
+    static void Init(GenFunc func, const SharedReplayBufferOptions &options = SharedReplayBufferOptions(), SizeFunc size = nullptr) {
+        _rbuffer.reset(new RBuffer(func, options, size));
     }
 
+    static SharedReplayBufferStats GetBufferStats() { return _rbuffer->GetStats(); }
+
     void Reload() {
         while (true) {
-            K k = get_key();
-            const auto &record = _rbuffer->Get(k);
-            _it = record.begin();
+            K k = next_key();
+            // Keep the record alive while _it walks through it, even if the buffer evicts it.
+            _record = _rbuffer->Get(k);
+            if (_record == nullptr) continue;
+            _it = _record->begin();
             if (after_reload(k, _it)) return;
         }
     }
@@ -41,11 +48,26 @@ private:
     // Shared buffer for OfflineLoader.
     static std::unique_ptr<RBuffer> _rbuffer;
 
+    typename RBuffer::RecordPtr _record;
     RIterator _it;
+    // Keys drawn ahead of time, whose records are being prefetched.
+    std::deque<K> _next_keys;
+
+    K next_key() {
+        int ahead = (_rbuffer->options().num_prefetch_threads > 0 ? _rbuffer->options().prefetch_ahead : 0);
+        while ((int)_next_keys.size() < ahead + 1) {
+            _next_keys.push_back(get_key());
+            if ((int)_next_keys.size() > 1) _rbuffer->Prefetch(_next_keys.back());
+        }
+        K k = _next_keys.front();
+        _next_keys.pop_front();
+        return k;
+    }
 
 protected:
     // The function return true if the load is valid, otherwise return false.
     virtual bool after_reload(const K& k, RIterator &it) = 0;
+    // Keys may be drawn ahead of time (with prefetch), so this should not change the loader state.
     virtual K get_key() = 0;
 };
 
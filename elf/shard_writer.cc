@@ -0,0 +1,152 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include "shard_writer.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+#include <stdexcept>
+
+namespace elf {
+
+ShardWriter::ShardWriter(const ShardWriterOptions &options)
+    : _options(options), _records(0), _pending(0), _dropped(0), _shards(0), _bytes(0), _errors(0) {
+    if (_options.prefix.empty()) {
+        std::cout << "ShardWriter: prefix is empty" << std::endl;
+        throw std::range_error("ShardWriter: prefix is empty");
+    }
+    // Several processes may write to the same place.
+    _name_prefix = _options.prefix + "-" + std::to_string(time(NULL)) + "-" + std::to_string(getpid()) + "-";
+    _thread = std::thread([this]() { writer_loop(); });
+}
+
+ShardWriter::~ShardWriter() {
+    Close();
+}
+
+void ShardWriter::Close() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done = true;
+    }
+    _cv.notify_all();
+    if (_thread.joinable()) _thread.join();
+}
+
+bool ShardWriter::Push(std::string &&record) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_done) {
+            _dropped ++;
+            return false;
+        }
+        if (_queued_bytes + record.size() > _options.max_queued_bytes && ! _queue.empty()) {
+            _dropped ++;
+            return false;
+        }
+        _queued_bytes += record.size();
+        _queue.push_back(std::move(record));
+    }
+    _cv.notify_one();
+    return true;
+}
+
+ShardWriterStats ShardWriter::GetStats() const {
+    ShardWriterStats stats;
+    stats.records = _records.load();
+    stats.pending = _pending.load();
+    stats.dropped = _dropped.load();
+    stats.shards = _shards.load();
+    stats.bytes = _bytes.load();
+    stats.errors = _errors.load();
+    return stats;
+}
+
+void ShardWriter::writer_loop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _cv.wait(lock, [this]() { return _done || ! _queue.empty(); });
+        if (_queue.empty()) break;
+
+        // Take everything that is queued, and write it without the lock.
+        std::deque<std::string> records;
+        records.swap(_queue);
+        _queued_bytes = 0;
+        lock.unlock();
+        for (const std::string &record : records) write_record(record);
+        lock.lock();
+    }
+    close_shard();
+}
+
+void ShardWriter::write_record(const std::string &record) {
+    if (_file == nullptr && ! open_shard()) {
+        _dropped ++;
+        return;
+    }
+    if (gzwrite(_file, record.data(), record.size()) != (int)record.size()) {
+        int err;
+        std::cout << "ShardWriter: cannot write " << _filename << ": " << gzerror(_file, &err) << std::endl;
+        _errors ++;
+        _dropped ++;
+        // zlib errors stick to the file, so the next record goes to a new shard.
+        close_shard(false);
+        return;
+    }
+    _pending ++;
+    _shard_bytes += record.size();
+    if ((size_t)gzoffset(_file) >= _options.shard_bytes) close_shard();
+}
+
+bool ShardWriter::open_shard() {
+    _filename = _name_prefix + std::to_string(_shard_idx) + ".gz";
+    std::string mode = "wb" + std::to_string(_options.compression_level);
+    _file = gzopen((_filename + ".tmp").c_str(), mode.c_str());
+    if (_file == nullptr) {
+        std::cout << "ShardWriter: cannot open " << _filename << ".tmp: " << strerror(errno) << std::endl;
+        _errors ++;
+        return false;
+    }
+    _shard_idx ++;
+    const std::string &header = _options.shard_header;
+    if (! header.empty() && gzwrite(_file, header.data(), header.size()) != (int)header.size()) {
+        std::cout << "ShardWriter: cannot write " << _filename << std::endl;
+        _errors ++;
+        close_shard(false);
+        return false;
+    }
+    return true;
+}
+
+void ShardWriter::close_shard(bool keep) {
+    if (_file == nullptr) return;
+    int ret = gzclose(_file);
+    _file = nullptr;
+    const std::string tmp_filename = _filename + ".tmp";
+    if (keep && (ret != Z_OK || ::rename(tmp_filename.c_str(), _filename.c_str()) != 0)) {
+        std::cout << "ShardWriter: cannot close " << _filename << std::endl;
+        _errors ++;
+        keep = false;
+    }
+    const int64_t records = _pending.exchange(0);
+    if (keep) {
+        _records += records;
+        _bytes += _shard_bytes;
+        _shards ++;
+    } else {
+        // The records of a failed shard are lost, so do not leave a part of them behind.
+        ::unlink(tmp_filename.c_str());
+        _dropped += records;
+    }
+    _shard_bytes = 0;
+}
+
+}  // namespace elf
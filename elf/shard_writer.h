@@ -0,0 +1,103 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <zlib.h>
+
+namespace elf {
+
+struct ShardWriterOptions {
+    // Shards are <prefix>-<start time>-<pid>-<index>.gz.
+    std::string prefix;
+    // Start a new shard once this many compressed bytes are written.
+    size_t shard_bytes = 64 << 20;
+    // Records waiting for the writer thread. Beyond that, new records are dropped (and counted)
+    // instead of making the caller wait for the disk.
+    size_t max_queued_bytes = 256 << 20;
+    // zlib level, 1 (fast) to 9 (small).
+    int compression_level = 6;
+    // Written at the start of every shard, so that each shard can be read alone.
+    std::string shard_header;
+};
+
+struct ShardWriterStats {
+    // Records and bytes in complete shards. A record is only counted once its shard is renamed, and is
+    // counted as dropped if the shard fails.
+    int64_t records = 0;
+    // Records written to the shard that is still open.
+    int64_t pending = 0;
+    int64_t dropped = 0;
+    int64_t shards = 0;
+    int64_t bytes = 0;
+    int64_t errors = 0;
+
+    std::string info() const {
+        std::stringstream ss;
+        ss << "ShardWriter: " << records << " records, " << bytes / 1024 << " KB in " << shards << " shards, pending: "
+           << pending << ", dropped: " << dropped << ", errors: " << errors;
+        return ss.str();
+    }
+};
+
+// Writes records to gzip-compressed shards from a background thread. Push() only appends to a queue,
+// so the threads that produce records never wait for I/O. A shard is written as <name>.tmp and
+// renamed once it is complete, so readers only see complete shards. After a write error, the shard
+// is removed and the next record starts a new one.
+class ShardWriter {
+public:
+    ShardWriter(const ShardWriterOptions &options);
+    ShardWriter(const ShardWriter &) = delete;
+    ShardWriter &operator=(const ShardWriter &) = delete;
+    ~ShardWriter();
+
+    // Returns false if the record is dropped because the queue is full, or the writer is closed.
+    bool Push(std::string &&record);
+
+    // Writes what is left in the queue and closes the current shard. Later records are dropped.
+    void Close();
+
+    ShardWriterStats GetStats() const;
+
+private:
+    ShardWriterOptions _options;
+    std::string _name_prefix;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::string> _queue;
+    size_t _queued_bytes = 0;
+    bool _done = false;
+
+    std::atomic<int64_t> _records, _pending, _dropped, _shards, _bytes, _errors;
+
+    // Only used by the writer thread.
+    gzFile _file = nullptr;
+    std::string _filename;
+    int _shard_idx = 0;
+    // Bytes of the records in the current shard (their number is _pending).
+    int64_t _shard_bytes = 0;
+
+    std::thread _thread;
+
+    void writer_loop();
+    void write_record(const std::string &record);
+    bool open_shard();
+    // Renames a complete shard, or removes it (keep == false, or if closing fails) and drops its records.
+    void close_shard(bool keep = true);
+};
+
+}  // namespace elf
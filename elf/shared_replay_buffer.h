@@ -6,46 +6,225 @@
 * LICENSE file in the root directory of this source tree.
 */
 
-#include <vector>
-#include <map>
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
 #include <memory>
 #include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <cassert>
 
+#include "ctpl_stl.h"
+
+struct SharedReplayBufferOptions {
+    // Bounds of the cache, 0 means no bound. They are split evenly over the shards.
+    size_t max_entries = 0;
+    size_t max_bytes = 0;
+    int num_shards = 16;
+
+    // Threads that load records ahead of time (see Prefetch). 0 means no prefetch.
+    int num_prefetch_threads = 0;
+    // How many keys a ReplayLoaderT draws ahead and prefetches.
+    int prefetch_ahead = 1;
+};
+
+struct SharedReplayBufferStats {
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t evictions = 0;
+    int64_t prefetches = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+
+    std::string info() const {
+        std::stringstream ss;
+        int64_t lookups = hits + misses;
+        ss << "ReplayBuffer: " << entries << " records, " << bytes / 1024 << " KB, hit rate: "
+           << (lookups > 0 ? (float)hits / lookups : 0.0) << " (" << hits << "/" << lookups << "), evictions: "
+           << evictions << ", prefetches: " << prefetches;
+        return ss.str();
+    }
+};
+
+// Cache of records (e.g., parsed game records), loaded by GenFunc on first use and shared by all threads.
+// The keys are split into shards with one lock each. Each shard keeps its records in LRU order and
+// evicts the oldest ones past its share of max_entries / max_bytes. Records are handed out as
+// shared_ptr, so an evicted record stays valid for whoever still holds it.
+// A record is loaded without holding the shard lock; other threads asking for the same key wait for it.
+// If GenFunc throws or returns nullptr, nothing is cached and the waiting threads try to load the key
+// themselves. Get rethrows the exception, or returns nullptr.
 template <typename Key, typename Record>
 class SharedReplayBuffer {
 public:
     using GenFunc = std::function<std::unique_ptr<Record> (const Key &)>;
+    // Memory taken by a record, for max_bytes. By default sizeof(Record).
+    using SizeFunc = std::function<size_t (const Record &)>;
+    using RecordPtr = std::shared_ptr<const Record>;
+
+    SharedReplayBuffer(GenFunc gen, const SharedReplayBufferOptions &options = SharedReplayBufferOptions(), SizeFunc size = nullptr)
+        : _gen(gen), _size(size), _options(options), _hits(0), _misses(0), _evictions(0), _prefetches(0), _pending(0) {
+        if (_options.num_shards < 1) _options.num_shards = 1;
+        for (int i = 0; i < _options.num_shards; ++i) _shards.emplace_back(new Shard);
+        if (_options.num_prefetch_threads > 0) _pool.reset(new ctpl::thread_pool(_options.num_prefetch_threads));
+    }
+
+    ~SharedReplayBuffer() {
+        // Drop the queued prefetches, and wait for the running ones.
+        if (_pool != nullptr) _pool->stop(false);
+    }
+
+    const SharedReplayBufferOptions &options() const { return _options; }
 
-    SharedReplayBuffer(GenFunc gen) : _gen(gen) { }
     void InitRecords(const std::vector<Key> &keys) {
-        std::lock_guard<std::mutex> lock(_mutex);
-        for (const auto &key : keys) add_record_no_lock(key);
+        for (const auto &key : keys) Get(key);
+    }
+
+    bool HasKey(const Key &key) const {
+        Shard &shard = shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        return it != shard.entries.end() && it->second.record != nullptr;
     }
 
-    bool HasKey(const Key &key) const { return _buffer.find(key) != _buffer.end(); }
+    RecordPtr Get(const Key &key) {
+        Shard &shard = shard_of(key);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        while (true) {
+            auto it = shard.entries.find(key);
+            if (it == shard.entries.end()) break;
+            if (it->second.record == nullptr) {
+                // Someone else is loading it.
+                shard.loaded.wait(lock);
+                continue;
+            }
+            _hits ++;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second.pos);
+            return it->second.record;
+        }
+
+        _misses ++;
+        // Mark as loading, so that no one else loads it at the same time.
+        shard.entries.emplace(key, Entry());
+        lock.unlock();
+        RecordPtr record;
+        size_t bytes = 0;
+        try {
+            record = _gen(key);
+            if (record != nullptr) bytes = (_size != nullptr ? _size(*record) : sizeof(Record));
+        } catch (...) {
+            lock.lock();
+            abandon_no_lock(&shard, key);
+            throw;
+        }
+        lock.lock();
+        if (record == nullptr) {
+            abandon_no_lock(&shard, key);
+            return nullptr;
+        }
+
+        Entry &e = shard.entries[key];
+        e.record = record;
+        e.bytes = bytes;
+        shard.lru.push_front(key);
+        e.pos = shard.lru.begin();
+        shard.bytes += bytes;
+        evict_no_lock(&shard);
+        shard.loaded.notify_all();
+        return record;
+    }
+
+    // Start loading key in the background, if there are prefetch threads and it is not cached yet.
+    void Prefetch(const Key &key) {
+        if (_pool == nullptr) return;
+        // Do not queue up more than the threads can get through soon.
+        if (_pending.load() >= 4 * _options.num_prefetch_threads) return;
+        {
+            Shard &shard = shard_of(key);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (shard.entries.find(key) != shard.entries.end()) return;
+        }
+        _pending ++;
+        _prefetches ++;
+        _pool->push([this, key](int) {
+            // A failed load is left to the next Get of the key.
+            try {
+                Get(key);
+            } catch (...) {
+            }
+            _pending --;
+        });
+    }
 
-    const Record &Get(const Key& key) {
-        typename BufferType::const_iterator it = _buffer.find(key);
-        if (it == _buffer.end()) {
-            std::lock_guard<std::mutex> lock(_mutex);
-            // Check again.
-            it = _buffer.find(key);
-            if (it == _buffer.end()) it = add_record_no_lock(key);
+    SharedReplayBufferStats GetStats() const {
+        SharedReplayBufferStats stats;
+        stats.hits = _hits.load();
+        stats.misses = _misses.load();
+        stats.evictions = _evictions.load();
+        stats.prefetches = _prefetches.load();
+        for (const auto &shard : _shards) {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            stats.entries += shard->lru.size();
+            stats.bytes += shard->bytes;
         }
-        return *it->second;
+        return stats;
     }
 
 private:
-    using BufferType = std::map<Key, std::unique_ptr<Record>>;
+    struct Entry {
+        // nullptr while it is being loaded.
+        RecordPtr record;
+        size_t bytes = 0;
+        typename std::list<Key>::iterator pos;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::condition_variable loaded;
+        std::unordered_map<Key, Entry> entries;
+        // Loaded keys, most recently used first.
+        std::list<Key> lru;
+        size_t bytes = 0;
+    };
 
-    BufferType _buffer;
-    std::mutex _mutex;
     GenFunc _gen;
+    SizeFunc _size;
+    SharedReplayBufferOptions _options;
+    std::vector<std::unique_ptr<Shard>> _shards;
+
+    std::atomic<int64_t> _hits, _misses, _evictions, _prefetches;
+    std::atomic<int> _pending;
+
+    // Declared last, so that its threads are gone before the shards.
+    std::unique_ptr<ctpl::thread_pool> _pool;
 
-    typename BufferType::const_iterator add_record_no_lock(const Key &key) {
-        assert(_gen != nullptr);
-        return _buffer.emplace(make_pair(key, _gen(key))).first;
+    Shard &shard_of(const Key &key) const { return *_shards[std::hash<Key>()(key) % _shards.size()]; }
+
+    // Drop the placeholder of a load that failed, and wake up the threads waiting for it.
+    void abandon_no_lock(Shard *shard, const Key &key) {
+        shard->entries.erase(key);
+        shard->loaded.notify_all();
     }
-};
 
+    void evict_no_lock(Shard *shard) {
+        const size_t n = _shards.size();
+        const size_t max_entries = (_options.max_entries > 0 ? (_options.max_entries + n - 1) / n : 0);
+        const size_t max_bytes = (_options.max_bytes > 0 ? (_options.max_bytes + n - 1) / n : 0);
+
+        // Always keep the newest record.
+        while (shard->lru.size() > 1 && ((max_entries > 0 && shard->lru.size() > max_entries) || (max_bytes > 0 && shard->bytes > max_bytes))) {
+            auto it = shard->entries.find(shard->lru.back());
+            assert(it != shard->entries.end());
+            shard->bytes -= it->second.bytes;
+            shard->entries.erase(it);
+            shard->lru.pop_back();
+            _evictions ++;
+        }
+    }
+};
@@ -17,6 +17,8 @@
 #include <atomic>
 #include <thread>
 #include <sstream>
+#include <mutex>
+#include <condition_variable>
 
 #include "pybind_helper.h"
 #include "python_options_utils_cpp.h"
@@ -26,6 +28,7 @@
 #include "primitive.h"
 #include "collector.hh"
 #include "hist.h"
+#include "batch_controller.h"
 
 template <typename Data>
 struct InfosT {
@@ -163,7 +166,6 @@ private:
     // Current batch.
     std::vector<In *> _batch;
     std::vector<Data *> _batch_data;
-    elf::BatchCollectorT<Key, In> _batch_collector;
 
     std::vector<CopyItem> _copier_input;
     std::vector<CopyItem> _copier_reply;
@@ -176,9 +178,42 @@ private:
     // Statistics
     int _num_enqueue;
 
+    // Picks _batchsize and _timeout_usec for each batch.
+    elf::BatchController _controller;
+
     // Wakeup signal.
     Semaphore<int> _wakeup;
 
+    // Zero-copy mode: each game reserves a row of the batch and writes its input there
+    // itself, so the collector thread only has to publish the batch.
+    bool _zero_copy;
+    // Row stride of the registered tensors.
+    const int _max_batchsize;
+
+    // Requests come through a feed, which can be shared by several groups (one per in-flight
+    // batch, each with its own tensors). The groups take turns to form a batch, so games
+    // fill batch k+1 while batch k is still being processed.
+    struct Feed {
+        std::unique_ptr<elf::BatchCollectorBaseT<Key, In>> collector;
+        std::vector<CollectorGroupT<In> *> groups;
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        // Index of the group that forms the next batch.
+        int turn = 0;
+
+        // Zero-copy mode: the row reserved by each key, and the group whose tensors are filled.
+        std::unordered_map<Key, int> key_index;
+        std::vector<int> slot_of_key;
+        int filling = 0;
+        int slot_capacity = 0;
+        int next_slot = 0;
+        bool slot_open = false;
+    };
+    std::shared_ptr<Feed> _feed;
+    // Position of this group in the feed.
+    const int _feed_idx;
+
     static constexpr int kTimeOutuSecNoBatch = 0;
 
     void send_batch() {
@@ -192,9 +227,85 @@ private:
         return future_timeout;
     }
 
+    void wait_turn() {
+        std::unique_lock<std::mutex> lk(_feed->mutex);
+        _feed->cond.wait(lk, [this]() { return _feed->turn == _feed_idx; });
+    }
+
+    void pass_turn() {
+        {
+            std::lock_guard<std::mutex> lk(_feed->mutex);
+            _feed->turn = (_feed_idx + 1) % _feed->groups.size();
+        }
+        _feed->cond.notify_all();
+    }
+
+    // Reserve a row in the batch being formed and write the input there.
+    void send_to_slot(const Key &key, In *data) {
+        Feed &f = *_feed;
+        CollectorGroupT<In> *g;
+        int slot;
+        {
+            std::unique_lock<std::mutex> lk(f.mutex);
+            f.cond.wait(lk, [&f]() { return f.slot_open && f.next_slot < f.slot_capacity; });
+            slot = f.next_slot ++;
+            g = f.groups[f.filling];
+        }
+        f.slot_of_key[f.key_index.at(key)] = slot;
+        elf::CopyToMemRow(g->_copier_input, data->data, slot, _max_batchsize);
+    }
+
+    // Start handing out rows of our tensors. Called when it is our turn.
+    void open_slots() {
+        {
+            std::lock_guard<std::mutex> lk(_feed->mutex);
+            if (_feed->slot_open) return;
+            _feed->filling = _feed_idx;
+            _feed->slot_capacity = _batchsize;
+            _feed->next_slot = 0;
+            _feed->slot_open = true;
+        }
+        _feed->cond.notify_all();
+    }
+
+    // Stop handing out rows, wait for the games that already got one, and put the batch in row order.
+    void close_slots() {
+        int reserved;
+        {
+            std::lock_guard<std::mutex> lk(_feed->mutex);
+            _feed->slot_open = false;
+            reserved = _feed->next_slot;
+        }
+        while ((int)_batch.size() < reserved) {
+            auto rest = _feed->collector->waitBatch(reserved - _batch.size());
+            _batch.insert(_batch.end(), rest.begin(), rest.end());
+        }
+        std::vector<In *> ordered(_batch.size(), nullptr);
+        for (In *in : _batch) {
+            ordered[_feed->slot_of_key[_feed->key_index.at(in->meta.query_id)]] = in;
+        }
+        _batch.swap(ordered);
+    }
+
 public:
-    CollectorGroupT(int gid, const std::vector<Key> &keys, int batchsize, SyncSignal *signal, bool verbose, int timeout_usec)
-        : _gid(gid), _batchsize(batchsize), _batch_collector(keys), _signal(signal), _verbose(verbose), _timeout_usec(timeout_usec) {
+    CollectorGroupT(int gid, const std::vector<Key> &keys, int batchsize, SyncSignal *signal, bool verbose, int timeout_usec,
+            bool lockfree = false, bool zero_copy = false, int target_p99_usec = 0)
+        : _gid(gid), _batchsize(batchsize), _signal(signal), _verbose(verbose), _timeout_usec(timeout_usec),
+          _controller(batchsize, timeout_usec, target_p99_usec),
+          _zero_copy(zero_copy), _max_batchsize(batchsize), _feed(new Feed), _feed_idx(0) {
+        _feed->collector.reset(elf::CreateBatchCollector<Key, In>(keys, lockfree));
+        _feed->groups.push_back(this);
+        for (size_t i = 0; i < keys.size(); ++i) _feed->key_index[keys[i]] = i;
+        _feed->slot_of_key.resize(keys.size(), -1);
+    }
+
+    // Another in-flight batch for the requests of group first, with its own tensors.
+    CollectorGroupT(int gid, CollectorGroupT<In> &first, int target_p99_usec = 0)
+        : _gid(gid), _batchsize(first._batchsize), _signal(first._signal), _verbose(first._verbose),
+          _timeout_usec(first._timeout_usec), _controller(first._max_batchsize, first._timeout_usec, target_p99_usec),
+          _zero_copy(first._zero_copy), _max_batchsize(first._max_batchsize),
+          _feed(first._feed), _feed_idx(first._feed->groups.size()) {
+        _feed->groups.push_back(this);
     }
 
     EntryInfo GetEntry(const std::string &key, int hist_len, EntryFunc entry_func) const {
@@ -219,9 +330,12 @@ public:
 
     int gid() const { return _gid; }
 
+    elf::BatchControllerStats GetStats() const { return _controller.GetStats(); }
+
     std::string info() const {
         std::stringstream ss;
         ss << "Collector[" << _gid << "] Batchsize: " << _batchsize;
+        if (_feed->groups.size() > 1) ss << " In-flight: " << _feed_idx + 1 << "/" << _feed->groups.size();
         return ss.str();
     }
 
@@ -237,14 +351,15 @@ public:
     // Game side.
     void SendData(const Key &key, In *data) {
         if (_verbose) std::cout << "[" << key << "][" << _gid << "] c.SendData ... " << std::endl;
+        if (_zero_copy) send_to_slot(key, data);
         // Collect data for this condition.
-        _batch_collector.sendData(key, data);
+        _feed->collector->sendData(key, data);
         _num_enqueue ++;
     }
 
     void WaitReply(const Key &key) {
         V_PRINT(_verbose, "CollectorGroup: [" << _gid << "] WaitReply for k = " << key);
-        _batch_collector.waitReply(key);
+        _feed->collector->waitReply(key);
     }
 
     // Main Loop
@@ -255,23 +370,40 @@ public:
             int new_batchsize;
             if (_batchsize_q.wait_dequeue_timed(new_batchsize, 0)) {
                 _batchsize = new_batchsize;
+                _controller.Fix(new_batchsize);
                 // std::cout << "CollectorGroup: get new batchsize. batchsize = " << _batchsize << std::endl;
                 _batchsize_back.notify(0);
                 // std::cout << "CollectorGroup: After notification. batchsize = " << _batchsize << std::endl;
             }
-            _batch = _batch_collector.waitBatch(_batchsize, _timeout_usec, kTimeOutuSecNoBatch);
+            // Wait for our turn, then until we have a complete batch.
+            wait_turn();
+            _batchsize = _controller.batchsize();
+            _timeout_usec = _controller.timeout_usec();
+            if (_zero_copy) open_slots();
+            _batch = _feed->collector->waitBatch(_batchsize, _timeout_usec, kTimeOutuSecNoBatch);
+            _controller.BatchStart(_feed->collector->firstItemTime(), _feed->collector->lastItemTime());
+
+            // Time to leave the loop.
+            if (_batch.size() == 1 && _batch[0] == nullptr) {
+                pass_turn();
+                break;
+            }
+            // Keep the turn (and the rows) if nothing came in.
+            if (_batch.empty()) continue;
+
+            if (_zero_copy) close_slots();
+            pass_turn();
+            _controller.BatchFormed();
+
             _batch_data.clear();
             for (In *b : _batch) {
                 _batch_data.push_back(&b->data);
             }
 
-            // Time to leave the loop.
-            if (_batch.size() == 1 && _batch[0] == nullptr) break;
-            if (_batch.empty()) continue;
-
             V_PRINT(_verbose, "CollectorGroup: [" << _gid << "] Compute input. batchsize = " << _batch.size());
 
-            elf::CopyToMem(_copier_input, _batch_data);
+            // In zero-copy mode the games have already written their rows.
+            if (! _zero_copy) elf::CopyToMem(_copier_input, _batch_data);
 
             // Signal.
             V_PRINT(_verbose, "CollectorGroup: [" << _gid << "] Send_batch. batchsize = " << _batch.size());
@@ -280,6 +412,7 @@ public:
             V_PRINT(_verbose, "CollectorGroup: [" << _gid << "] Wait until the batch is processed");
             // Wait until it is processed.
             wait_batch_used();
+            _controller.BatchDone(_batch.size());
 
             V_PRINT(_verbose, "CollectorGroup: [" << _gid << "] PutReplies()");
 
@@ -290,7 +423,7 @@ public:
             for (In *in : _batch) {
                 const Key& key = in->meta.query_id;
                 V_PRINT(_verbose, "CollectorGroup: [" << _gid << "] Resume signal sent to k = " << key);
-                _batch_collector.signalReply(key);
+                _feed->collector->signalReply(key);
             }
 
             V_PRINT(_verbose, "CollectorGroup: [" << _gid << "] All resume signal sent, batchsize = " << _batch.size());
@@ -325,6 +458,6 @@ public:
     // For other thread.
     void NotifyAwake() {
         // Kick the collector out of the waiting state by sending fake samples.
-        _batch_collector.sendData(0, nullptr);
+        _feed->collector->sendData(0, nullptr);
     }
 };
@@ -8,6 +8,14 @@
 
 #include "tar_loader.h"
 #include <memory.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <stdexcept>
 
 namespace elf {
 
@@ -18,32 +26,111 @@ bool file_is_tar(const std::string& filename) {
 }
 
 TarLoader::TarLoader(const std::string &tar_filename) {
-  mtar_open(&tar, tar_filename.c_str(), "r");
+  _fd = ::open(tar_filename.c_str(), O_RDONLY);
+  struct stat st;
+  if (_fd < 0 || ::fstat(_fd, &st) != 0) {
+    std::cout << "TarLoader: cannot open " << tar_filename << ": " << strerror(errno) << std::endl;
+    if (_fd >= 0) ::close(_fd);
+    throw std::range_error("TarLoader: cannot open " + tar_filename);
+  }
+  _size = st.st_size;
+  if (_size > 0) {
+    void *p = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+    if (p == MAP_FAILED) {
+      std::cout << "TarLoader: cannot mmap " << tar_filename << ": " << strerror(errno) << std::endl;
+      ::close(_fd);
+      throw std::range_error("TarLoader: cannot mmap " + tar_filename);
+    }
+    _data = static_cast<const char *>(p);
+  }
+  try {
+    build_index(tar_filename);
+  } catch (...) {
+    close_archive();
+    throw;
+  }
+  // Games are sampled at random, so readahead past one entry is mostly wasted.
+  if (_data != nullptr) ::madvise(const_cast<char *>(_data), _size, MADV_RANDOM);
+}
+
+// Header fields are NUL-padded, and may use all of their bytes.
+static std::string header_str(const char *s, size_t n) {
+  return std::string(s, strnlen(s, n));
 }
 
-std::vector<std::string> TarLoader::List() {
-  std::vector<std::string> v;
-  mtar_header_t h;
-  while ((mtar_read_header(&tar, &h)) != MTAR_ENULLRECORD) {
-    v.push_back(std::string(h.name));
-    mtar_next(&tar);
+static size_t header_octal(const char *s, size_t n) {
+  size_t v = 0;
+  for (size_t i = 0; i < n && s[i] != 0; ++i) {
+    if (s[i] >= '0' && s[i] <= '7') v = v * 8 + (s[i] - '0');
   }
   return v;
 }
 
-std::string TarLoader::Load(const std::string &filename) {
-  mtar_header_t h;
-  mtar_find(&tar, filename.c_str(), &h);
-  char *s = new char[h.size + 1];
-  ::memset(s, 0, h.size + 1);
-  mtar_read_data(&tar, s, h.size);
-  std::string res(s);
-  delete [] s;
-  return res;
+static bool header_checksum_ok(const char *h) {
+  // Sum of the 512 header bytes, with the checksum field itself counted as spaces.
+  unsigned sum = 0;
+  for (int i = 0; i < 512; ++i) {
+    sum += (i >= 148 && i < 156) ? ' ' : (unsigned char)h[i];
+  }
+  return sum == header_octal(h + 148, 8);
+}
+
+void TarLoader::build_index(const std::string &tar_filename) {
+  const size_t kBlock = 512;
+  // GNU tar puts names longer than 100 chars in a preceding 'L' entry.
+  std::string long_name;
+
+  size_t pos = 0;
+  while (pos + kBlock <= _size) {
+    const char *h = _data + pos;
+    if (h[0] == 0) break;
+    if (! header_checksum_ok(h)) {
+      std::cout << "TarLoader: bad header checksum at offset " << pos << " in " << tar_filename << std::endl;
+      throw std::range_error("TarLoader: bad header in " + tar_filename);
+    }
+
+    size_t size = header_octal(h + 124, 12);
+    char type = h[156];
+    size_t data_pos = pos + kBlock;
+    if (data_pos + size > _size) {
+      std::cout << "TarLoader: truncated entry at offset " << pos << " in " << tar_filename << std::endl;
+      throw std::range_error("TarLoader: truncated " + tar_filename);
+    }
+
+    if (type == 'L') {
+      long_name = header_str(_data + data_pos, size);
+    } else {
+      std::string name;
+      if (! long_name.empty()) {
+        name.swap(long_name);
+      } else {
+        name = header_str(h, 100);
+        // ustar keeps the leading directories of long names in the prefix field.
+        if (memcmp(h + 257, "ustar", 5) == 0 && h[345] != 0) name = header_str(h + 345, 155) + "/" + name;
+      }
+      if (type == '0' || type == 0) {
+        if (_index.emplace(name, Slice(_data + data_pos, size)).second) _names.push_back(name);
+        else _index[name] = Slice(_data + data_pos, size);
+      }
+    }
+    pos = data_pos + (size + kBlock - 1) / kBlock * kBlock;
+  }
+}
+
+Slice TarLoader::Get(const std::string &filename) const {
+  auto it = _index.find(filename);
+  return it == _index.end() ? Slice() : it->second;
+}
+
+void TarLoader::close_archive() {
+  if (_data != nullptr) ::munmap(const_cast<char *>(_data), _size);
+  if (_fd >= 0) ::close(_fd);
+  _data = nullptr;
+  _fd = -1;
 }
 
 TarLoader::~TarLoader() {
-    mtar_close(&tar);
+  close_archive();
 }
 
 TarWriter::TarWriter(const std::string &tar_filename) {
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "microtar.h"
 
@@ -18,13 +19,48 @@ namespace tar {
 
 extern bool file_is_tar(const std::string& filename);
 
+// Bytes owned by someone else (e.g., a TarLoader), valid as long as the owner is.
+struct Slice {
+  const char *data = nullptr;
+  size_t size = 0;
+
+  Slice() { }
+  Slice(const char *d, size_t n) : data(d), size(n) { }
+
+  bool empty() const { return size == 0; }
+  std::string str() const { return std::string(data, size); }
+};
+
+// Read-only view of a tar archive. The archive is mmapped and its headers are read once in the
+// constructor, so a lookup is one hash probe and Get() never copies. Nothing changes after
+// construction, so one TarLoader can be shared by any number of threads.
 class TarLoader {
 private:
-  mtar_t tar;
+  int _fd = -1;
+  const char *_data = nullptr;
+  size_t _size = 0;
+
+  // Regular files in archive order, and name -> contents.
+  std::vector<std::string> _names;
+  std::unordered_map<std::string, Slice> _index;
+
+  void build_index(const std::string &tar_filename);
+  // Unmap the archive and close it. The constructor calls it too before it throws.
+  void close_archive();
+
 public:
   TarLoader(const std::string &tar_filename);
-  std::vector<std::string> List();
-  std::string Load(const std::string &filename);
+  TarLoader(const TarLoader &) = delete;
+  TarLoader &operator=(const TarLoader &) = delete;
+
+  const std::vector<std::string> &List() const { return _names; }
+  bool Has(const std::string &filename) const { return _index.count(filename) > 0; }
+
+  // Contents of filename inside the mapped archive (empty if there is no such file).
+  Slice Get(const std::string &filename) const;
+  // Same as Get, as a copy.
+  std::string Load(const std::string &filename) const { return Get(filename).str(); }
+
   ~TarLoader();
 };
 
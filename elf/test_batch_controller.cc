@@ -0,0 +1,160 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//g++ -std=c++11 -I../vendor/pybind11/include `python3-config --includes` test_batch_controller.cc -o test_batch_controller
+//
+// Drives a BatchController with a simulated collector: a number of games, each of which sends a request
+// a fixed gap after its previous reply, and a model which takes a fixed time. Checks that a group with
+// fewer games than the batch size stops waiting for a full batch once the requests stop coming, and
+// that the timeout still follows the latency budget when requests are far apart.
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "batch_controller.h"
+
+using namespace std;
+using Clock = elf::BatchController::Clock;
+
+static Clock::duration usec(float t) { return chrono::duration_cast<Clock::duration>(chrono::duration<float, micro>(t)); }
+static float to_usec(Clock::duration d) { return chrono::duration<float, micro>(d).count(); }
+
+class Simulation {
+public:
+    Simulation(int num_games, float gap_usec, float model_usec, int max_batchsize, int timeout_usec, int target_p99_usec)
+        : _gap(gap_usec), _model(model_usec), _controller(max_batchsize, timeout_usec, target_p99_usec),
+          _send(num_games) {
+        for (int i = 0; i < num_games; ++i) _send[i] = _now + usec(i * _gap);
+    }
+
+    // Runs a batch as BatchCollectorT::waitBatch and CollectorGroupT::MainLoop do, and returns its latency.
+    float Batch() {
+        const int batchsize = _controller.batchsize();
+        const auto timeout = usec(_controller.timeout_usec());
+
+        // Requests which are already queued come out in order, without waiting.
+        vector<int> order(_send.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        sort(order.begin(), order.end(), [this](int a, int b) { return _send[a] < _send[b]; });
+
+        vector<int> batch;
+        Clock::time_point t_first, t;
+        for (int i : order) {
+            if ((int)batch.size() == batchsize) break;
+            // The first item is waited for without a timeout.
+            if (batch.empty()) t = max(_now, _send[i]);
+            else if (_send[i] > t + timeout) break;
+            else t = max(t, _send[i]);
+            if (batch.empty()) t_first = t;
+            batch.push_back(i);
+        }
+        _controller.BatchStart(t_first, t);
+        const auto t_formed = (int)batch.size() < batchsize ? t + timeout : t;
+        _controller.BatchFormed(t_formed);
+        _now = t_formed + usec(_model);
+        _controller.BatchDone(batch.size(), _now);
+
+        for (size_t k = 0; k < batch.size(); ++k) _send[batch[k]] = _now + usec(k * _gap);
+        return to_usec(_now - t_first);
+    }
+
+    // Average latency over the next num_batches batches.
+    float Run(int num_batches) {
+        float sum = 0.0;
+        for (int i = 0; i < num_batches; ++i) sum += Batch();
+        return sum / num_batches;
+    }
+
+    elf::BatchControllerStats GetStats() const { return _controller.GetStats(); }
+
+private:
+    const float _gap, _model;
+    elf::BatchController _controller;
+    Clock::time_point _now;
+    vector<Clock::time_point> _send;
+};
+
+static void print(const char *name, const elf::BatchControllerStats &stats, float latency) {
+    cout << name << ": batchsize " << stats.batchsize << ", timeout " << stats.timeout_usec << " usec, arrival "
+         << stats.arrival_per_sec << "/sec, latency " << latency << " usec, " << stats.num_partial << "/"
+         << stats.num_batches << " partial" << endl;
+}
+
+int main() {
+    const int max_batchsize = 32;
+    const float model_usec = 1000;
+    const int target_usec = 20000;
+    // What the timeout is without the arrival rate.
+    const int budget_timeout = (int)((target_usec - model_usec) / max_batchsize);
+
+    // 8 games for a batch of 32: every batch ends with a wait for requests which do not come.
+    {
+        const float gap = 10;
+        Simulation sim(8, gap, model_usec, max_batchsize, 500, target_usec);
+        float latency = sim.Run(200);
+        latency = sim.Run(200);
+        auto stats = sim.GetStats();
+        print("Few games", stats, latency);
+        if (stats.arrival_per_sec < 0.9e6 / gap || stats.arrival_per_sec > 1.1e6 / gap) {
+            cout << "FAILED: arrival rate " << stats.arrival_per_sec << "/sec, expected " << 1e6 / gap << endl;
+            return 1;
+        }
+        if (stats.timeout_usec > 3 * gap || latency > model_usec + 7 * gap + 3 * gap) {
+            cout << "FAILED: still waiting for a full batch, timeout " << stats.timeout_usec << " usec" << endl;
+            return 1;
+        }
+    }
+
+    // Enough games to fill the batches: they stay full with the shorter timeout.
+    {
+        const float gap = 10;
+        Simulation sim(64, gap, model_usec, max_batchsize, 500, target_usec);
+        sim.Run(200);
+        const int64_t partial = sim.GetStats().num_partial;
+        float latency = sim.Run(200);
+        auto stats = sim.GetStats();
+        print("Many games", stats, latency);
+        if (stats.batchsize != max_batchsize || stats.num_partial != partial) {
+            cout << "FAILED: batches should be full" << endl;
+            return 1;
+        }
+    }
+
+    // Requests far apart: the timeout is set by the budget.
+    {
+        const float gap = 300;
+        Simulation sim(max_batchsize, gap, model_usec, max_batchsize, 500, target_usec);
+        float latency = sim.Run(400);
+        auto stats = sim.GetStats();
+        print("Slow games", stats, latency);
+        if (stats.timeout_usec != budget_timeout) {
+            cout << "FAILED: timeout " << stats.timeout_usec << " usec, expected " << budget_timeout << endl;
+            return 1;
+        }
+        if (stats.latency_usec_p99 > target_usec) {
+            cout << "FAILED: p99 latency " << stats.latency_usec_p99 << " usec over the target" << endl;
+            return 1;
+        }
+    }
+
+    // Without a target, the timeout is left alone.
+    {
+        Simulation sim(8, 10, model_usec, max_batchsize, 500, 0);
+        float latency = sim.Run(200);
+        auto stats = sim.GetStats();
+        print("Fixed", stats, latency);
+        if (stats.timeout_usec != 500 || stats.batchsize != max_batchsize) {
+            cout << "FAILED: the controller is off, but the timeout is " << stats.timeout_usec << " usec" << endl;
+            return 1;
+        }
+    }
+
+    cout << "Passed" << endl;
+    return 0;
+}
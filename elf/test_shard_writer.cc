@@ -0,0 +1,132 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//g++ -std=c++11 test_shard_writer.cc shard_writer.cc -lz -lpthread -o test_shard_writer
+//
+// Makes the writes of the first shards fail (with a small RLIMIT_FSIZE), then checks that the records
+// pushed after the failure still end up in a complete shard, that the failed shards are removed, and
+// that the records counted as written are those that can be read back.
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <zlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "shard_writer.h"
+
+using namespace std;
+
+static bool ends_with(const string &name, const string &suffix) {
+    return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Decompressed content of the complete shards in dir, and the number of other files.
+static string read_shards(const string &dir, int *num_others) {
+    string content;
+    *num_others = 0;
+    DIR *d = opendir(dir.c_str());
+    if (d == nullptr) return content;
+    while (struct dirent *e = readdir(d)) {
+        string name = e->d_name;
+        if (name == "." || name == "..") continue;
+        if (! ends_with(name, ".gz")) {
+            (*num_others) ++;
+            continue;
+        }
+        gzFile f = gzopen((dir + "/" + name).c_str(), "rb");
+        if (f == nullptr) continue;
+        char buf[4096];
+        int n;
+        while ((n = gzread(f, buf, sizeof(buf))) > 0) content.append(buf, n);
+        gzclose(f);
+    }
+    closedir(d);
+    return content;
+}
+
+int main() {
+    char dir_template[] = "/tmp/test_shard_writer.XXXXXX";
+    if (mkdtemp(dir_template) == nullptr) {
+        cout << "Cannot create a temporary directory" << endl;
+        return 1;
+    }
+    const string dir = dir_template;
+
+    // Writes past the limit fail with EFBIG instead of killing the process.
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit limit;
+    getrlimit(RLIMIT_FSIZE, &limit);
+    const rlim_t old_limit = limit.rlim_cur;
+
+    const int num_records = 64;
+    const int num_late_records = 10;
+    elf::ShardWriterStats stats;
+    {
+        elf::ShardWriterOptions options;
+        options.prefix = dir + "/shard";
+        options.shard_bytes = 1 << 30;
+        options.compression_level = 1;
+        elf::ShardWriter writer(options);
+
+        limit.rlim_cur = 64 << 10;
+        setrlimit(RLIMIT_FSIZE, &limit);
+
+        // Random letters hardly compress, so the shards go over the limit. Each record ends with the
+        // only newline in it.
+        mt19937 rng(0);
+        for (int i = 0; i < num_records; ++i) {
+            string record(4096, '\n');
+            for (size_t j = 0; j + 1 < record.size(); ++j) record[j] = 'a' + rng() % 26;
+            writer.Push(move(record));
+        }
+        for (int wait = 0; wait < 1000; ++wait) {
+            stats = writer.GetStats();
+            if (stats.records + stats.pending + stats.dropped >= num_records) break;
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+
+        limit.rlim_cur = old_limit;
+        setrlimit(RLIMIT_FSIZE, &limit);
+
+        for (int i = 0; i < num_late_records; ++i) writer.Push("late record " + to_string(i) + "\n");
+        writer.Close();
+        stats = writer.GetStats();
+    }
+
+    if (stats.errors == 0) {
+        cout << "FAILED: no write error was forced" << endl;
+        return 1;
+    }
+    int num_others = 0;
+    const string content = read_shards(dir, &num_others);
+    if (system(("rm -rf " + dir).c_str()) != 0) cout << "Cannot remove " << dir << endl;
+    if (num_others > 0) {
+        cout << "FAILED: " << num_others << " files besides the complete shards are left" << endl;
+        return 1;
+    }
+    const int64_t num_read = count(content.begin(), content.end(), '\n');
+    if (stats.records != num_read || stats.pending != 0 || stats.records + stats.dropped != num_records + num_late_records) {
+        cout << "FAILED: " << num_read << " records in the shards, " << stats.info() << endl;
+        return 1;
+    }
+    for (int i = 0; i < num_late_records; ++i) {
+        if (content.find("late record " + to_string(i) + "\n") == string::npos) {
+            cout << "FAILED: late record " << i << " is missing after " << stats.errors << " errors" << endl;
+            return 1;
+        }
+    }
+    cout << "Passed: " << stats.info() << endl;
+    return 0;
+}
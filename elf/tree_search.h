@@ -13,6 +13,10 @@
 #include <mutex>
 #include <string>
 #include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
 #include <unordered_map>
 
 #include "member_check.h"
@@ -20,6 +24,7 @@
 #include "primitive.h"
 #include "tree_search_node.h"
 #include "tree_search_alg.h"
+#include "tree_search_tt.h"
 #include "ctpl_stl.h"
 
 #include "tree_search_options.h"
@@ -31,6 +36,8 @@
  * bool s.forward(const A& a). Forward function that changes the current state to the next state. Return false if the current state is terminal.
  * float s.reward(). Get a reward given the current state.
  * s.evaluate(). Evaluate the current state to get pi/V.
+ * s.evaluate_batch(const vector<const S *> &, vector<NodeResponseT<A>> *, vector<bool> *evaluated). Optional, evaluate several leaves at once.
+ * s.state_hash(const S &) (or S::state_hash()). Optional, 64-bit hash of a state for the transposition table.
  * s.pi(): return vector<pair<A, float>> for the candidate actions and its prob.
  * s.value(): return a float for the value of current state.
  *
@@ -41,7 +48,19 @@ namespace mcts {
 using namespace std;
 
 struct RunInfo {
+    using Clock = chrono::steady_clock;
+
     int num_rollout;
+
+    // The search also stops once stop is set, or at the deadline if there is one.
+    const atomic_bool *stop = nullptr;
+    bool has_deadline = false;
+    Clock::time_point deadline;
+
+    bool Expired() const {
+        if (stop != nullptr && stop->load()) return true;
+        return has_deadline && Clock::now() >= deadline;
+    }
 };
 
 template <typename S, typename A>
@@ -49,9 +68,10 @@ class TSOneThreadT {
 public:
     using Node = NodeT<S, A>;
     using NodeAlloc = NodeAllocT<S, A>;
+    using TranspositionTable = TranspositionTableT<A>;
 
-    TSOneThreadT(int thread_id, const TSOptions& options)
-      : thread_id_(thread_id), options_(options), rng_(thread_id) {
+    TSOneThreadT(int thread_id, const TSOptions& options, TranspositionTable *tt = nullptr)
+      : thread_id_(thread_id), options_(options), tt_(tt), rng_(thread_id) {
         if (options_.verbose) {
             string log_file = "tree_search_" + std::to_string(thread_id) + ".txt";
             // cout << "Logging " << log_file << endl;
@@ -83,48 +103,71 @@ public:
 
         PRINT_MAIN("Start. actor thread_id: " << actor.info());
 
-        for (int iter = 0; iter < info.num_rollout && (done == nullptr || ! done->load()); ++iter) {
-            // Start from the root and run one path
-            vector<pair<Node *, A>> traj;
-            Node *node = root;
-
-            int depth = 0;
-
-            while (_visit(actor, node, alloc) == Node::NODE_ALREADY_VISITED) {
-                A a = UCT(node->sa(), node->count(), options_.use_prior, output_.get()).first;
-                PRINT_TS("[depth=" << depth << "] Action: " << a);
-
-                // Save trajectory.
-                traj.push_back(make_pair(node, a));
-                NodeId next = node->Descent(a);
-                PRINT_TS("[depth=" << depth << "] Descent node id: " << next);
+        // With several leaves per thread, the leaves are expanded together after one batched evaluation.
+        const int num_leaves = max(options_.num_leaves_per_thread, 1);
+        const bool batched = num_leaves > 1;
+
+        for (int iter = 0; iter < info.num_rollout && (done == nullptr || ! done->load()) && ! info.Expired(); iter += num_leaves) {
+            vector<Leaf> leaves(min(num_leaves, info.num_rollout - iter));
+
+            for (Leaf &leaf : leaves) {
+                // Start from the root and run one path
+                vector<pair<Node *, int>> &traj = leaf.traj;
+                Node *node = root;
+
+                int depth = 0;
+
+                while (batched ? node->visited() : _visit(actor, node, alloc) == Node::NODE_ALREADY_VISITED) {
+                    int edge = UCT(node->sa(), node->count(), options_.use_prior, output_.get()).first;
+                    // No valid move.
+                    if (edge < 0) break;
+                    const A &a = node->sa().action(edge);
+                    PRINT_TS("[depth=" << depth << "] Action: " << a);
+
+                    // Save trajectory.
+                    traj.push_back(make_pair(node, edge));
+                    node->AddVirtualLoss(edge, options_.virtual_loss);
+                    NodeId next = node->Child(edge, alloc);
+                    PRINT_TS("[depth=" << depth << "] Descent node id: " << next);
+
+                    assert(node->s_ptr());
+
+                    // Note that next might be invalid, if there is not valid move or no node left.
+                    Node *next_node = alloc[next];
+                    if (next_node == nullptr) break;
+
+                    PRINT_TS("[depth=" << depth << "] Before forward. ");
+                    if (! _forward(node, a, actor, next_node)) break;
+                    PRINT_TS("[depth=" << depth << "] After forward. ");
+                    node = next_node;
+                    PRINT_TS("[depth=" << depth << "] Next node address: " << hex << node << dec);
+                    depth ++;
+                }
+                leaf.node = node;
+            }
 
-                assert(node->s_ptr());
+            if (batched) _expand_leaves(actor, leaves, alloc);
 
-                // Note that next might be invalid, if there is not valid move.
-                Node *next_node = alloc[next];
-                if (next_node == nullptr) break;
+            for (const Leaf &leaf : leaves) {
+                // The evaluation failed, so the rollout only takes its virtual loss back.
+                if (! leaf.evaluated) {
+                    for (const auto &p : leaf.traj) p.first->RemoveVirtualLoss(p.second, options_.virtual_loss);
+                    continue;
+                }
 
-                PRINT_TS("[depth=" << depth << "] Before forward. ");
-                if (! _forward(node, a, actor, next_node)) break;
-                PRINT_TS("[depth=" << depth << "] After forward. ");
-                node = next_node;
-                PRINT_TS("[depth=" << depth << "] Next node address: " << hex << node << dec);
-                depth ++;
-            }
+                // Now the node points to a recently created node.
+                // Evaluate it and backpropagate.
+                float reward = get_reward(actor, leaf.node);
 
-            // Now the node points to a recently created node.
-            // Evaluate it and backpropagate.
-            float reward = get_reward(actor, node);
+                PRINT_TS("Reward: " << reward << " Start backprop");
 
-            PRINT_TS("Reward: " << reward << " Start backprop");
+                // Add reward back.
+                for (const auto &p : leaf.traj) {
+                    p.first->AccumulateStats(p.second, reward, options_.virtual_loss);
+                }
 
-            // Add reward back.
-            for (const auto &p : traj) {
-                p.first->AccumulateStats(p.second, reward);
+                PRINT_TS("Done backprop");
             }
-
-            PRINT_TS("Done backprop");
         }
 
         PRINT_MAIN("Done");
@@ -137,12 +180,23 @@ public:
 private:
     int thread_id_;
     const TSOptions &options_;
+    TranspositionTable *tt_;
+    NodeResponseT<A> tt_resp_;
 
     Semaphore<RunInfo> state_ready_;
     std::unique_ptr<ostream> output_;
 
     std::mt19937 rng_;
 
+    static constexpr int kMaxSeedVisits = 4;
+
+    // End of one rollout, and the edges (node, edge index) that led there.
+    struct Leaf {
+        Node *node = nullptr;
+        vector<pair<Node *, int>> traj;
+        bool evaluated = true;
+    };
+
     static float sigmoid(float x) {
         return 1.0 / (1 + exp(-x));
     }
@@ -183,17 +237,107 @@ private:
       return next_node->SetStateIfNull(func);
     }
 
+    // source is the node the transposition table had for the same position, if any.
+    void _init_edge(EdgeInfo &info, const Node *source, size_t edge) {
+        info.acc_reward = rng_() % (options_.pseudo_games + 1);
+        info.n = options_.pseudo_games;
+
+        // Start from the mean reward of the transposition, worth a few visits at most. These are
+        // seeds, not visits: they do not count in the visits of the node or in the visit distribution.
+        if (source != nullptr && source->visited() && edge < source->sa().size()) {
+            const EdgeInfo other = source->sa()[edge].second;
+            if (other.n > 0) {
+                info.seed_n = (other.n < kMaxSeedVisits ? other.n : kMaxSeedVisits);
+                info.seed_reward = other.acc_reward / other.n * info.seed_n;
+            }
+        }
+    }
+
+    bool _tt_find(uint64_t key, NodeAlloc &alloc, const Node **source) {
+        NodeId id;
+        if (! tt_->Find(key, &tt_resp_, &id)) return false;
+        *source = alloc[id];
+        return true;
+    }
+
     template <typename Actor>
     typename Node::VisitType _visit(Actor &actor, Node *node, NodeAlloc &alloc) {
+        const Node *source = nullptr;
         // Check
-        auto func = [&](const Node *n) -> NodeResponseT<A> & {
-            return actor.evaluate(*n->s_ptr());
+        auto func = [&](const Node *n) -> const NodeResponseT<A> & {
+            if (tt_ == nullptr) return actor.evaluate(*n->s_ptr());
+
+            uint64_t key = StateHash(actor, *n->s_ptr());
+            if (_tt_find(key, alloc, &source)) return tt_resp_;
+            const NodeResponseT<A> &resp = actor.evaluate(*n->s_ptr());
+            tt_->Insert(key, resp, n->id());
+            return resp;
         };
-        auto init = [&](EdgeInfo &info) {
-             info.acc_reward = rng_() % (options_.pseudo_games + 1);
-             info.n = options_.pseudo_games;
-        };
-        return node->ExpandIfNecessary(func, init, alloc);
+        size_t edge = 0;
+        auto init = [&](EdgeInfo &info) { _init_edge(info, source, edge ++); };
+        return node->ExpandIfNecessary(func, init);
+    }
+
+    void _expand(Node *node, const NodeResponseT<A> &resp, const Node *source) {
+        size_t edge = 0;
+        auto init = [&](EdgeInfo &info) { _init_edge(info, source, edge ++); };
+        // Another thread might have expanded the node in the meantime, then its result is kept.
+        node->ExpandIfNecessary([&](const Node *) -> const NodeResponseT<A> & { return resp; }, init);
+    }
+
+    // evaluated[i] is false if states[i] could not be evaluated, e.g., the game is stopping.
+    MEMBER_FUNC_CHECK(evaluate_batch)
+    template <typename Actor, typename std::enable_if<has_func_evaluate_batch<Actor>::value>::type *U = nullptr>
+    void _evaluate_batch(Actor &actor, const vector<const S *> &states, vector<NodeResponseT<A>> *resps, vector<bool> *evaluated) {
+        actor.evaluate_batch(states, resps, evaluated);
+    }
+
+    template <typename Actor, typename std::enable_if<! has_func_evaluate_batch<Actor>::value>::type *U = nullptr>
+    void _evaluate_batch(Actor &actor, const vector<const S *> &states, vector<NodeResponseT<A>> *resps, vector<bool> *evaluated) {
+        resps->clear();
+        for (const S *s : states) resps->push_back(actor.evaluate(*s));
+        evaluated->assign(states.size(), true);
+    }
+
+    // Evaluate the leaves that are not expanded yet in one go, and expand them.
+    // Leaves reached by several rollouts are only evaluated once, leaves found in the transposition table not at all.
+    // The leaves whose evaluation failed are left as they are and marked, so that they are not backpropagated.
+    template <typename Actor>
+    void _expand_leaves(Actor &actor, vector<Leaf> &leaves, NodeAlloc &alloc) {
+        vector<Node *> nodes;
+        vector<const S *> states;
+        vector<uint64_t> keys;
+        for (const Leaf &leaf : leaves) {
+            if (leaf.node->visited()) continue;
+            if (find(nodes.begin(), nodes.end(), leaf.node) != nodes.end()) continue;
+            if (tt_ != nullptr) {
+                uint64_t key = StateHash(actor, *leaf.node->s_ptr());
+                const Node *source = nullptr;
+                if (_tt_find(key, alloc, &source)) {
+                    _expand(leaf.node, tt_resp_, source);
+                    continue;
+                }
+                keys.push_back(key);
+            }
+            nodes.push_back(leaf.node);
+            states.push_back(leaf.node->s_ptr());
+        }
+        if (nodes.empty()) return;
+
+        vector<NodeResponseT<A>> resps;
+        vector<bool> evaluated;
+        _evaluate_batch(actor, states, &resps, &evaluated);
+
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (! evaluated[i]) {
+                for (Leaf &leaf : leaves) {
+                    if (leaf.node == nodes[i]) leaf.evaluated = false;
+                }
+                continue;
+            }
+            if (tt_ != nullptr) tt_->Insert(keys[i], resps[i], nodes[i]->id());
+            _expand(nodes[i], resps[i], nullptr);
+        }
     }
 };
 
@@ -205,12 +349,27 @@ public:
     using TSOneThread = TSOneThreadT<S, A>;
     using NodeAlloc = NodeAllocT<S, A>;
     using MCTSResult = MCTSResultT<A>;
+    using TranspositionTable = TranspositionTableT<A>;
 
     TreeSearchT(const TSOptions &options, std::function<Actor *(int)> actor_gen)
-        : pool_(options.num_threads), options_(options) {
+        : pool_(options.num_threads), options_(options), stop_ponder_(false) {
+
+        // Without virtual loss, all the rollouts of a thread would end at the same leaf.
+        if (options_.num_leaves_per_thread > 1 && options_.virtual_loss <= 0.0) {
+            cout << "TreeSearch: several leaves per thread need a virtual loss, using 1" << endl;
+            options_.virtual_loss = 1.0;
+        }
+
+        if (options.tt_size > 0) {
+            if (HasStateHash<Actor, S>::value) {
+                tt_.reset(new TranspositionTable(options.tt_size));
+            } else {
+                cout << "TreeSearch: no state_hash in the actor or the state, the transposition table is off" << endl;
+            }
+        }
 
         for (int i = 0; i < options.num_threads; ++i) {
-            threads_.emplace_back(new TSOneThread(i, options_));
+            threads_.emplace_back(new TSOneThread(i, options_, tt_.get()));
             actors_.emplace_back(actor_gen(i));
         }
 
@@ -239,7 +398,18 @@ public:
     size_t size() const { return actors_.size(); }
     string info() const { return alloc_.root()->info(alloc_); }
 
+    // Empty if there is no transposition table.
+    TTStats GetTTStats() const { return tt_ != nullptr ? tt_->GetStats() : TTStats(); }
+
     MCTSResult Run(const S& root_state) {
+        StopPonder();
+
+        // The last search stopped growing the tree when it ran out of nodes.
+        if (alloc_.exhausted()) {
+            cout << "TreeSearch: out of nodes, the tree is cleared" << endl;
+            Clear();
+        }
+
         Node *root = alloc_.root();
         if (root == nullptr) {
             cout << "TreeSearch::root cannot be null!" << endl;
@@ -247,7 +417,15 @@ public:
         }
         root->SetStateIfNull([&]() { return new S(root_state); });
 
-        notify_state_ready(options_.num_rollout_per_thread);
+        // With a time budget, num_rollout_per_thread <= 0 means no limit on #rollouts.
+        RunInfo run_info;
+        run_info.num_rollout = options_.num_rollout_per_thread;
+        if (options_.time_ms_per_move > 0) {
+            if (run_info.num_rollout <= 0) run_info.num_rollout = INT_MAX;
+            run_info.has_deadline = true;
+            run_info.deadline = RunInfo::Clock::now() + chrono::milliseconds(options_.time_ms_per_move);
+        }
+        notify_state_ready(run_info);
 
         // Wait until all tree searches are done.
         tree_ready_.wait(pool_.size());
@@ -268,33 +446,70 @@ public:
             cout << "MCTS Pick method unknown! " << options_.pick_method << endl;
             throw std::range_error("MCTS Pick method unknown! " + options_.pick_method);
         }
+        FillVisits(root->sa(), &result);
 
         if (output_ != nullptr) {
             *output_ << "===================" << endl;
             *output_ << options_.info() << endl;
             *output_ << info() << endl;
             *output_ << "Choice: " << result.info() << endl;
+            if (tt_ != nullptr) *output_ << GetTTStats().info() << endl;
         }
 
         return result;
     }
 
+    // Keep searching from the current root in the background, until StopPonder (or Run, TreeAdvance,
+    // Clear, Stop). Each thread does at most num_rollout_per_thread rollouts, or searches until it is
+    // stopped if that is <= 0. Returns false if the root has no state to search from.
+    bool StartPonder() {
+        if (pondering_) return true;
+        Node *root = alloc_.root();
+        if (root == nullptr || root->s_ptr() == nullptr) return false;
+
+        RunInfo run_info;
+        run_info.num_rollout = options_.num_rollout_per_thread > 0 ? options_.num_rollout_per_thread : INT_MAX;
+        run_info.stop = &stop_ponder_;
+        stop_ponder_ = false;
+        pondering_ = true;
+        notify_state_ready(run_info);
+        return true;
+    }
+
+    void StopPonder() {
+        if (! pondering_) return;
+        stop_ponder_ = true;
+        tree_ready_.wait(pool_.size());
+        tree_ready_.reset();
+        pondering_ = false;
+    }
+
+    bool pondering() const { return pondering_; }
+
     void TreeAdvance(const A &a) {
+        StopPonder();
         alloc_.TreeAdvance(a);
+        // The nodes left behind are reused, so their ids in the table are stale.
+        if (tt_ != nullptr) tt_->ForgetNodes();
     }
 
     void Clear() {
+        StopPonder();
         alloc_.Clear();
+        if (tt_ != nullptr) tt_->ForgetNodes();
     }
 
     void Stop() {
+        StopPonder();
         done_.set();
 
         // cout << "About to send notify in Stop " << endl;
-        notify_state_ready(0);
-
-        tree_ready_.wait(pool_.size());
+        RunInfo run_info;
+        run_info.num_rollout = 0;
+        notify_state_ready(run_info);
 
+        // A thread that sees done_ before it takes the notification exits without reporting to tree_ready_,
+        // so only wait for the threads to exit.
         done_.wait(pool_.size());
     }
 
@@ -311,6 +526,7 @@ private:
     unique_ptr<ostream> output_;
 
     NodeAlloc alloc_;
+    unique_ptr<TranspositionTable> tt_;
 
     RunInfo run_info_;
 
@@ -318,11 +534,12 @@ private:
     Notif done_;
     SemaCollector tree_ready_;
 
-    void notify_state_ready(int num_rollout) {
-        RunInfo info;
-        info.num_rollout = num_rollout;
+    bool pondering_ = false;
+    atomic_bool stop_ponder_;
+
+    void notify_state_ready(const RunInfo &run_info) {
         for (size_t i = 0; i < threads_.size(); ++i) {
-            threads_[i]->NotifyReady(info);
+            threads_[i]->NotifyReady(run_info);
         }
     }
 };
@@ -6,7 +6,18 @@
 * LICENSE file in the root directory of this source tree.
 */
 
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <random>
 #include <type_traits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "tree_search_base.h"
 
 namespace mcts {
@@ -14,34 +25,116 @@ namespace mcts {
 using namespace std;
 
 // Algorithms.
-template <typename Map>
-pair<typename Map::key_type, float> UCT(const Map& vals, float count, bool use_prior = true, ostream *oo = nullptr) {
-    // Simple PUCT algorithm.
-    using A = typename Map::key_type;
-    static_assert(is_same<typename Map::mapped_type, EdgeInfo>::value, "key type must be EdgeInfo");
-
-    A best_a = A();
+// Score of edge i is
+//   (acc_reward[i] + seed_reward[i] + 0.5 + prior_coeff * prior[i]) / (n[i] + seed_n[i] + virtual_loss[i] + 1),
+// virtual loss counting as visits with zero reward.
+// Returns the first edge with the highest score and the score, or -1 if there is no edge.
+inline pair<int, float> PUCTArgMax(const float *prior, const int *n, const float *acc_reward, const float *virtual_loss,
+        const float *seed_n, const float *seed_reward, int size, float prior_coeff) {
+    int best = -1;
     float max_score = std::numeric_limits<float>::lowest();
-    const float c_puct = 0.5;
-    const float sqrt_count1 = sqrt(count + 1);
-
-    if (oo) *oo << "UCT prior = " << (use_prior ? "True" : "False") << endl;
+    int i = 0;
+
+#ifdef __AVX2__
+    if (size >= 8) {
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 coeff = _mm256_set1_ps(prior_coeff);
+        const __m256i step = _mm256_set1_epi32(8);
+        __m256i idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256 vmax = _mm256_set1_ps(max_score);
+        __m256i vbest = _mm256_setzero_si256();
+
+        for (; i + 8 <= size; i += 8) {
+            __m256 visits = _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(n + i)));
+            visits = _mm256_add_ps(_mm256_add_ps(visits, _mm256_loadu_ps(virtual_loss + i)), one);
+            visits = _mm256_add_ps(visits, _mm256_loadu_ps(seed_n + i));
+            __m256 num = _mm256_add_ps(_mm256_loadu_ps(acc_reward + i), half);
+            num = _mm256_add_ps(num, _mm256_loadu_ps(seed_reward + i));
+            num = _mm256_add_ps(num, _mm256_mul_ps(coeff, _mm256_loadu_ps(prior + i)));
+            __m256 score = _mm256_div_ps(num, visits);
+
+            // Strictly greater, so each lane keeps its first maximum.
+            __m256 gt = _mm256_cmp_ps(score, vmax, _CMP_GT_OQ);
+            vmax = _mm256_blendv_ps(vmax, score, gt);
+            vbest = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(vbest), _mm256_castsi256_ps(idx), gt));
+            idx = _mm256_add_epi32(idx, step);
+        }
 
-    for (const auto& action_pair : vals) {
-        const A& a = action_pair.first;
-        const EdgeInfo &info = action_pair.second;
+        float lane_max[8];
+        int lane_best[8];
+        _mm256_storeu_ps(lane_max, vmax);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lane_best), vbest);
+        for (int k = 0; k < 8; ++k) {
+            if (lane_max[k] > max_score || (lane_max[k] == max_score && lane_best[k] < best)) {
+                max_score = lane_max[k];
+                best = lane_best[k];
+            }
+        }
+    }
+#endif
 
-        float score = (info.acc_reward + 0.5) / (info.n + 1);
-        if (use_prior) score += c_puct * info.prior / (1 + info.n) * sqrt_count1;
+    for (; i < size; ++i) {
+        float visits = n[i] + virtual_loss[i] + 1.0f + seed_n[i];
+        float score = (acc_reward[i] + 0.5f + seed_reward[i] + prior_coeff * prior[i]) / visits;
+        if (score > max_score) {
+            max_score = score;
+            best = i;
+        }
+    }
+    return make_pair(best, max_score);
+}
 
-        if (oo) *oo << "UCT [a=" << a << "] prior: " << info.prior << " score: " <<  score << endl;
+// Simple PUCT algorithm. Returns the index of the picked edge in edges (-1 if there is none) and its score.
+template <typename A>
+pair<int, float> UCT(const EdgeArrayT<A> &edges, float count, bool use_prior = true, ostream *oo = nullptr) {
+    const float c_puct = 0.5;
+    const float prior_coeff = use_prior ? c_puct * sqrt(count + 1) : 0.0;
+
+    if (oo) {
+        *oo << "UCT prior = " << (use_prior ? "True" : "False") << endl;
+        for (const auto& action_pair : edges) {
+            const EdgeInfo &info = action_pair.second;
+            float score = (info.acc_reward + 0.5f + info.seed_reward + prior_coeff * info.prior)
+                / (info.n + info.virtual_loss + 1.0f + info.seed_n);
+            *oo << "UCT [a=" << action_pair.first << "] prior: " << info.prior << " score: " <<  score << endl;
+        }
+    }
 
+    const int size = edges.size();
+#ifdef __AVX2__
+    // The counts change under us, so PUCTArgMax scans a copy of them, a block at a time. The copy costs
+    // more than the scan, but less than the scalar loop saves (see benchmark-uct.cpp).
+    const int kBlock = 64;
+    int n[kBlock];
+    float acc_reward[kBlock], virtual_loss[kBlock];
+    pair<int, float> best(-1, std::numeric_limits<float>::lowest());
+    for (int begin = 0; begin < size; begin += kBlock) {
+        const int len = std::min(kBlock, size - begin);
+        edges.LoadStats(begin, len, n, acc_reward, virtual_loss);
+        pair<int, float> r = PUCTArgMax(edges.prior_data() + begin, n, acc_reward, virtual_loss,
+            edges.seed_n_data() + begin, edges.seed_reward_data() + begin, len, prior_coeff);
+        // Strictly greater, so that the first maximum wins as in one scan.
+        if (r.first >= 0 && r.second > best.second) best = make_pair(begin + r.first, r.second);
+    }
+    return best;
+#else
+    // Same as the scalar loop of PUCTArgMax, reading the counts in place.
+    const float *prior = edges.prior_data();
+    const float *seed_n = edges.seed_n_data();
+    const float *seed_reward = edges.seed_reward_data();
+    int best = -1;
+    float max_score = std::numeric_limits<float>::lowest();
+    for (int i = 0; i < size; ++i) {
+        float visits = edges.n(i) + edges.virtual_loss(i) + 1.0f + seed_n[i];
+        float score = (edges.acc_reward(i) + 0.5f + seed_reward[i] + prior_coeff * prior[i]) / visits;
         if (score > max_score) {
             max_score = score;
-            best_a = a;
+            best = i;
         }
     }
-    return make_pair(best_a, max_score);
+    return make_pair(best, max_score);
+#endif
 };
 
 template <typename Map>
@@ -59,6 +152,26 @@ MCTSResultT<typename Map::key_type> MostVisited(const Map& vals) {
     return res;
 };
 
+// Fill res->pi with the visit distribution of the edges, and res->value with their mean reward.
+template <typename Map>
+void FillVisits(const Map& vals, MCTSResultT<typename Map::key_type> *res) {
+    using A = typename Map::key_type;
+    static_assert(is_same<typename Map::mapped_type, EdgeInfo>::value, "key type must be EdgeInfo");
+
+    int total = 0;
+    float acc_reward = 0.0;
+    for (const pair<A, EdgeInfo> & action_pair : vals) {
+        total += action_pair.second.n;
+        acc_reward += action_pair.second.acc_reward;
+    }
+    res->pi.clear();
+    res->value = total > 0 ? acc_reward / total : 0.0;
+    if (total == 0) return;
+    for (const pair<A, EdgeInfo> & action_pair : vals) {
+        if (action_pair.second.n > 0) res->pi.push_back(make_pair(action_pair.first, (float)action_pair.second.n / total));
+    }
+};
+
 template <typename Map>
 MCTSResultT<typename Map::key_type> StrongestPrior(const Map& vals) {
     using A = typename Map::key_type;
@@ -93,7 +206,8 @@ MCTSResultT<typename Map::key_type> UniformRandom(const Map& vals) {
     auto it = vals.begin();
     while (--idx >= 0) ++ it;
 
-    res.feed(it->second.n, *it);
+    const pair<A, EdgeInfo> action_pair = *it;
+    res.feed(action_pair.second.n, action_pair);
     return res;
 };
 
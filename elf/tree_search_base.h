@@ -8,10 +8,15 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
+#include <limits>
+#include <memory>
 #include <unordered_map>
 #include <string>
 #include <sstream>
+#include <type_traits>
+#include <vector>
 
 namespace mcts {
 
@@ -38,7 +43,15 @@ struct EdgeInfo {
     float acc_reward;
     int n;
 
-    EdgeInfo(float p = 0.0) : prior(p), next(NodeIdInvalid), acc_reward(0), n(0) { }
+    // Pending (lost) visits of rollouts that went through this edge but are not backpropagated yet.
+    float virtual_loss;
+
+    // Visits and reward carried over from a transposition. They only steer the selection, and are
+    // not visits of this edge (for the node count, MostVisited or FillVisits).
+    float seed_n;
+    float seed_reward;
+
+    EdgeInfo(float p = 0.0) : prior(p), next(NodeIdInvalid), acc_reward(0), n(0), virtual_loss(0), seed_n(0), seed_reward(0) { }
 
     string info() const {
         std::stringstream ss;
@@ -47,12 +60,204 @@ struct EdgeInfo {
     }
 };
 
+// Action -> edge index without hashing. Small integral actions (e.g. board coordinates)
+// index a table directly; other actions are found by a linear scan.
+template <typename A, typename Enable = void>
+class ActionIndexT {
+public:
+    void Build(const vector<A> &) { }
+    void clear() { }
+
+    int find(const vector<A> &actions, const A &a) const {
+        for (size_t i = 0; i < actions.size(); ++i) {
+            if (actions[i] == a) return i;
+        }
+        return -1;
+    }
+};
+
+template <typename A>
+class ActionIndexT<A, typename std::enable_if<std::is_integral<A>::value>::type> {
+public:
+    void Build(const vector<A> &actions) {
+        index_.clear();
+        for (size_t i = 0; i < actions.size(); ++i) {
+            long long k = static_cast<long long>(actions[i]);
+            if (k < 0 || k >= kMaxDenseAction) {
+                index_.clear();
+                return;
+            }
+            if ((size_t)k >= index_.size()) index_.resize(k + 1, -1);
+            index_[k] = i;
+        }
+    }
+
+    void clear() { index_.clear(); }
+
+    int find(const vector<A> &actions, const A &a) const {
+        if (index_.empty()) {
+            for (size_t i = 0; i < actions.size(); ++i) {
+                if (actions[i] == a) return i;
+            }
+            return -1;
+        }
+        long long k = static_cast<long long>(a);
+        if (k < 0 || (size_t)k >= index_.size()) return -1;
+        return index_[k];
+    }
+
+private:
+    // Larger actions fall back to the scan.
+    static constexpr long long kMaxDenseAction = 1 << 12;
+    vector<short> index_;
+};
+
+// Edges of one node as parallel arrays (structure of arrays), so that selection can go through
+// all priors/counts/rewards with vector loads. The statistics are atomics and are updated without a lock.
+// Edges are set once in Init() (while the node is being expanded) and never move afterwards.
+// The child of an edge is only set the first time a rollout goes through it.
+// Iterating gives a pair<A, EdgeInfo> snapshot of each edge, like the map it replaces.
+template <typename A>
+class EdgeArrayT {
+public:
+    using key_type = A;
+    using mapped_type = EdgeInfo;
+    using value_type = pair<A, EdgeInfo>;
+
+    static_assert(sizeof(atomic<float>) == sizeof(float) && sizeof(atomic<int>) == sizeof(int),
+        "The selection loop reads the atomic arrays as plain arrays");
+
+    class const_iterator {
+    public:
+        const_iterator(const EdgeArrayT<A> *edges, size_t i) : edges_(edges), i_(i) { }
+        value_type operator*() const { return (*edges_)[i_]; }
+        const_iterator &operator++() { ++ i_; return *this; }
+        bool operator==(const const_iterator &other) const { return i_ == other.i_; }
+        bool operator!=(const const_iterator &other) const { return i_ != other.i_; }
+
+    private:
+        const EdgeArrayT<A> *edges_;
+        size_t i_;
+    };
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    void clear() {
+        size_ = 0;
+        actions_.clear();
+        prior_.clear();
+        seed_n_.clear();
+        seed_reward_.clear();
+        next_.reset();
+        n_.reset();
+        acc_reward_.reset();
+        virtual_loss_.reset();
+        index_.clear();
+    }
+
+    // Not thread safe. Called once, before the node is marked as visited.
+    void Init(const vector<A> &actions, const vector<EdgeInfo> &infos) {
+        size_ = actions.size();
+        actions_ = actions;
+        prior_.resize(size_);
+        seed_n_.resize(size_);
+        seed_reward_.resize(size_);
+        next_.reset(new atomic<NodeId>[size_]);
+        n_.reset(new atomic<int>[size_]);
+        acc_reward_.reset(new atomic<float>[size_]);
+        virtual_loss_.reset(new atomic<float>[size_]);
+        for (size_t i = 0; i < size_; ++i) {
+            prior_[i] = infos[i].prior;
+            seed_n_[i] = infos[i].seed_n;
+            seed_reward_[i] = infos[i].seed_reward;
+            next_[i] = infos[i].next;
+            n_[i] = infos[i].n;
+            acc_reward_[i] = infos[i].acc_reward;
+            virtual_loss_[i] = infos[i].virtual_loss;
+        }
+        index_.Build(actions_);
+    }
+
+    value_type operator[](size_t i) const {
+        EdgeInfo info(prior_[i]);
+        info.next = next_[i].load(memory_order_acquire);
+        info.n = n_[i].load(memory_order_relaxed);
+        info.acc_reward = acc_reward_[i].load(memory_order_relaxed);
+        info.virtual_loss = virtual_loss_[i].load(memory_order_relaxed);
+        info.seed_n = seed_n_[i];
+        info.seed_reward = seed_reward_[i];
+        return make_pair(actions_[i], info);
+    }
+
+    // Edge index of action a, or -1.
+    int find(const A &a) const { return index_.find(actions_, a); }
+
+    const A &action(int i) const { return actions_[i]; }
+    NodeId next(int i) const { return next_[i].load(memory_order_acquire); }
+
+    // Set the child of edge i if it has none yet, and return the child the edge ends up with.
+    NodeId SetNextIfInvalid(int i, NodeId id) {
+        NodeId expected = NodeIdInvalid;
+        if (next_[i].compare_exchange_strong(expected, id, memory_order_acq_rel)) return id;
+        return expected;
+    }
+
+    void Accumulate(int i, float reward, float virtual_loss) {
+        atomic_add(acc_reward_[i], reward);
+        n_[i].fetch_add(1, memory_order_relaxed);
+        if (virtual_loss != 0.0) atomic_add(virtual_loss_[i], -virtual_loss);
+    }
+
+    void AddVirtualLoss(int i, float virtual_loss) { atomic_add(virtual_loss_[i], virtual_loss); }
+
+    // For the selection loop.
+    const float *prior_data() const { return prior_.data(); }
+    const float *seed_n_data() const { return seed_n_.data(); }
+    const float *seed_reward_data() const { return seed_reward_.data(); }
+    // Other threads update these while we select. Each value is loaded atomically, but not all at one instant.
+    int n(int i) const { return n_[i].load(memory_order_relaxed); }
+    float acc_reward(int i) const { return acc_reward_[i].load(memory_order_relaxed); }
+    float virtual_loss(int i) const { return virtual_loss_[i].load(memory_order_relaxed); }
+    // Copy of edges [begin, begin + len), for the vectorized loop.
+    void LoadStats(int begin, int len, int *n, float *acc_reward, float *virtual_loss) const {
+        for (int i = 0; i < len; ++i) {
+            n[i] = n_[begin + i].load(memory_order_relaxed);
+            acc_reward[i] = acc_reward_[begin + i].load(memory_order_relaxed);
+            virtual_loss[i] = virtual_loss_[begin + i].load(memory_order_relaxed);
+        }
+    }
+
+private:
+    size_t size_ = 0;
+    vector<A> actions_;
+    vector<float> prior_;
+    vector<float> seed_n_, seed_reward_;
+    unique_ptr<atomic<NodeId>[]> next_;
+    unique_ptr<atomic<int>[]> n_;
+    unique_ptr<atomic<float>[]> acc_reward_;
+    unique_ptr<atomic<float>[]> virtual_loss_;
+    ActionIndexT<A> index_;
+
+    static void atomic_add(atomic<float> &v, float delta) {
+        float old = v.load(memory_order_relaxed);
+        while (! v.compare_exchange_weak(old, old + delta, memory_order_relaxed)) { }
+    }
+};
+
 template <typename A>
 struct MCTSResultT {
     A best_a;
     float max_score;
     EdgeInfo edge_info;
 
+    // Visit distribution over the root edges, and the mean reward of the rollouts from the root.
+    vector<pair<A, float>> pi;
+    float value = 0.0;
+
     MCTSResultT() : best_a(A()), max_score(std::numeric_limits<float>::lowest()) {
     }
 
@@ -9,8 +9,12 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
 #include <functional>
+#include <iostream>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 
@@ -66,6 +70,11 @@ protected:
     mutex lock_state_;
     unique_ptr<S> s_;
     atomic<int> s_state_;
+
+    void reset_state() {
+        s_.reset();
+        s_state_ = NODE_NULL;
+    }
 };
 
 // Tree node.
@@ -75,18 +84,33 @@ public:
     using Node = NodeT<S, A>;
     using NodeAlloc = NodeAllocT<S, A>;
 
+    using EdgeArray = EdgeArrayT<A>;
+
     enum VisitType { NODE_NOT_VISITED = 0, NODE_JUST_VISITED, NODE_ALREADY_VISITED };
 
-    NodeT(Node *parent) : parent_(parent), visited_(false), count_(0) { }
+    NodeT(Node *parent = nullptr) : parent_(parent), visited_(false), count_(0) { }
     NodeT(const Node&) = delete;
     Node &operator=(const Node&) = delete;
 
-    const unordered_map<A, EdgeInfo> &sa() const { return sa_; }
+    // Make the node a fresh one, when the allocator hands it out again.
+    void Reset(Node *parent, NodeId id) {
+        this->reset_state();
+        id_ = id;
+        parent_ = parent;
+        visited_ = false;
+        sa_.clear();
+        count_ = 0;
+        V_ = 0.0;
+    }
+
+    NodeId id() const { return id_; }
+    const EdgeArray &sa() const { return sa_; }
     int count() const { return count_; }
+    bool visited() const { return visited_; }
     float value() const { return V_; }
 
     template <typename ExpandFunc, typename InitFunc>
-    VisitType ExpandIfNecessary(ExpandFunc func, InitFunc init, NodeAlloc &alloc) {
+    VisitType ExpandIfNecessary(ExpandFunc func, InitFunc init) {
         if (visited_) return NODE_ALREADY_VISITED;
 
         // Otherwise visit.
@@ -96,14 +120,18 @@ public:
         auto resp = func(this);
 
         // Then we need to allocate sa_val_
+        // The children are allocated later, when a rollout first goes through their edge (see Child()).
+        vector<A> actions;
+        vector<EdgeInfo> infos;
         for (const pair<A, float> & action_pair : resp.pi) {
-            auto res = sa_.insert(make_pair(action_pair.first, EdgeInfo(action_pair.second)));
-            res.first->second.next = alloc.Alloc(this);
-            init(res.first->second);
+            actions.push_back(action_pair.first);
+            infos.emplace_back(action_pair.second);
+            init(infos.back());
             // Compute v here.
-            // Node *child = alloc[res.first->second.next];
+            // Node *child = alloc[infos.back().next];
             // child->V_ = V_ + log(action_pair.second + 1e-6);
         }
+        sa_.Init(actions, infos);
 
         // value
         V_ = resp.value;
@@ -113,26 +141,42 @@ public:
         return NODE_JUST_VISITED;
     }
 
-    bool AccumulateStats(const A &a, float reward) {
-        auto res = elf_utils::map_get(sa_, a);
-        // Not found, skip
-        if (! res.second) return false;
+    // Edges are addressed by their index in sa(), see UCT().
+    // Called on descent, so that other rollouts in flight avoid this edge until AccumulateStats.
+    void AddVirtualLoss(int edge, float virtual_loss) {
+        if (virtual_loss != 0.0) sa_.AddVirtualLoss(edge, virtual_loss);
+    }
+
+    // For a rollout that is dropped before its backpropagation.
+    void RemoveVirtualLoss(int edge, float virtual_loss) {
+        if (virtual_loss != 0.0) sa_.AddVirtualLoss(edge, -virtual_loss);
+    }
 
+    // virtual_loss is what AddVirtualLoss put on the edge for this rollout, and is reverted here.
+    void AccumulateStats(int edge, float reward, float virtual_loss = 0.0) {
         // Inc #visited
         count_ ++;
+        sa_.Accumulate(edge, reward, virtual_loss);
+    }
 
-        EdgeInfo &info = res.first->second;
-        // Async modification (we probably need to add a locker in the future, or not for speed).
-        lock_guard<mutex> lock(lock_node_);
-        info.acc_reward += reward;
-        info.n ++;
-        return true;
+    // Allocate the child of the edge if no rollout went through it yet.
+    // Returns NodeIdInvalid if the allocator is out of nodes.
+    NodeId Child(int edge, NodeAlloc &alloc) {
+        NodeId next = sa_.next(edge);
+        if (next != NodeIdInvalid) return next;
+
+        NodeId id = alloc.Alloc(this);
+        if (id == NodeIdInvalid) return NodeIdInvalid;
+        next = sa_.SetNextIfInvalid(edge, id);
+        // Another rollout got there first.
+        if (next != id) alloc.Free(id);
+        return next;
     }
 
     NodeId Descent(const A &a) const {
-        auto res = elf_utils::map_get(sa_, a);
-        if (! res.second) return NodeIdInvalid;
-        return res.first->second.next;
+        int edge = sa_.find(a);
+        if (edge < 0) return NodeIdInvalid;
+        return sa_.next(edge);
     }
 
     string _info(int indent, const NodeAlloc &alloc) const {
@@ -143,7 +187,7 @@ public:
         for (const auto & p : sa_) {
             if (p.second.n > 0) {
                 const Node *n = alloc[p.second.next];
-                if (n->visited_) {
+                if (n != nullptr && n->visited_) {
                     ss << indent_str << "[" << p.first << "] " << p.second.info();
                     ss << ", V: " << n->V_ << endl;
                     ss << n->_info(indent + 2, alloc);
@@ -159,91 +203,174 @@ public:
 
 private:
     // For state.
+    NodeId id_ = NodeIdInvalid;
     Node *parent_;
     mutex lock_node_;
     atomic_bool visited_;
-    unordered_map<A, EdgeInfo> sa_;
+    EdgeArray sa_;
 
     atomic<int> count_;
     float V_ = 0.0;
 };
 
+// Nodes live in chunks that are allocated on demand, so a node id is also its position, and lookups are
+// wait-free. A node is allocated the first time a rollout goes through its edge.
+// TreeAdvance puts the subtrees that are left behind on a garbage list as they are, which only takes
+// one step per edge of the old root. Alloc reuses the garbage first: it takes a node, puts its children on
+// the list and resets it, so the old subtrees are reclaimed one node at a time while the new tree grows.
+// Fresh ids are only taken when there is no garbage left. Clear drops everything and frees the chunks.
 template <typename S, typename A>
 class NodeAllocT {
 public:
     using Node = NodeT<S, A>;
     using NodeAlloc = NodeAllocT<S, A>;
 
-    NodeAllocT() { Clear(); }
+    NodeAllocT() : chunks_(new atomic<Node *>[kMaxChunks]) {
+        for (int i = 0; i < kMaxChunks; ++i) chunks_[i] = nullptr;
+        allocated_node_count_ = 0;
+        Clear();
+    }
 
     NodeAllocT(const NodeAlloc&) = delete;
     NodeAlloc &operator=(const NodeAlloc&) = delete;
 
+    // Not thread safe with respect to a running search.
+    // The chunks are kept and handed out again from the start, so a reset costs nothing. A node keeps
+    // its state and edges until it is allocated again.
     void Clear() {
-        allocated_.clear();
         allocated_node_count_ = 0;
+        garbage_.clear();
+        num_garbage_ = 0;
+        exhausted_ = false;
         root_id_ = Alloc();
     }
 
+    // Not thread safe with respect to a running search either.
+    // The other children of the root (and their subtrees) are not reachable anymore, and go to the garbage.
     void TreeAdvance(const A& a) {
-        NodeId next_root = NodeIdInvalid;
-        Node *r = root();
-
-        for (const auto &p : r->sa()) {
-            if (p.first == a) next_root = p.second.next;
-            else RecursiveFree(p.second.next);
-        }
-        // Free root.
-        Free(root_id_);
-        if (next_root == NodeIdInvalid) {
-            root_id_ = Alloc();
-        } else {
-            root_id_ = next_root;
+        Node *old_root = root();
+        NodeId next_root = old_root->Descent(a);
+        {
+            lock_guard<mutex> lock(garbage_mutex_);
+            for (size_t i = 0; i < old_root->sa().size(); ++i) {
+                NodeId child = old_root->sa().next(i);
+                if (child != NodeIdInvalid && child != next_root) garbage_.push_back(child);
+            }
+            // Without its edges, so that the new root is not reclaimed with it.
+            old_root->Reset(nullptr, root_id_);
+            garbage_.push_back(root_id_);
+            num_garbage_ = garbage_.size();
         }
+
+        root_id_ = (next_root != NodeIdInvalid ? next_root : Alloc());
+        if (root_id_ == NodeIdInvalid) Clear();
     }
 
     Node *root() { return (*this)[root_id_]; }
     const Node *root() const { return (*this)[root_id_]; }
 
     // Low level functions.
+    // Returns NodeIdInvalid if all 2^28 nodes are in use. The search then stops growing the tree,
+    // and exhausted() tells the caller to Clear() before the next one.
     NodeId Alloc(Node *parent = nullptr) {
-        lock_guard<mutex> lock(alloc_mutex_);
-        allocated_[allocated_node_count_].reset(new Node(parent));
-        return allocated_node_count_ ++;
+        NodeId id = reuse();
+        if (id == NodeIdInvalid) id = fresh();
+        if (id == NodeIdInvalid) {
+            exhausted_ = true;
+            return NodeIdInvalid;
+        }
+        node_at(id)->Reset(parent, id);
+        return id;
     }
 
+    // Give back a node that was just allocated and never made part of the tree.
     void Free(NodeId id) {
-        allocated_.erase(id);
+        lock_guard<mutex> lock(garbage_mutex_);
+        garbage_.push_back(id);
+        num_garbage_ = garbage_.size();
     }
 
-    void RecursiveFree(NodeId id) {
-        Node *root = (*this)[id];
-        for (const auto &p : root->sa()) {
-            RecursiveFree(p.second.next);
-        }
-        Free(id);
-    }
+    bool exhausted() const { return exhausted_.load(); }
+
+    size_t size() const { return allocated_node_count_.load(); }
 
     Node *operator[](NodeId i) {
-        lock_guard<mutex> lock(alloc_mutex_);
-        auto it = allocated_.find(i);
-        if (it == allocated_.end()) return nullptr;
-        else return it->second.get();
+        if (i < 0 || i >= allocated_node_count_.load()) return nullptr;
+        return chunks_[i >> kChunkBits].load(memory_order_acquire) + (i & kChunkMask);
     }
 
     const Node *operator[](NodeId i) const {
-        lock_guard<mutex> lock(alloc_mutex_);
-        auto it = allocated_.find(i);
-        if (it == allocated_.end()) return nullptr;
-        else return it->second.get();
+        if (i < 0 || i >= allocated_node_count_.load()) return nullptr;
+        return chunks_[i >> kChunkBits].load(memory_order_acquire) + (i & kChunkMask);
+    }
+
+    ~NodeAllocT() {
+        free_chunks();
     }
 
 private:
-    // TODO: We might just allocate one chunk at a time.
-    unordered_map<NodeId, unique_ptr<Node>> allocated_;
-    NodeId allocated_node_count_;
-    mutable mutex alloc_mutex_;
+    // 4096 nodes per chunk, and at most 2^28 nodes.
+    static constexpr int kChunkBits = 12;
+    static constexpr NodeId kChunkMask = (1 << kChunkBits) - 1;
+    static constexpr int kMaxChunks = 1 << 16;
+
+    unique_ptr<atomic<Node *>[]> chunks_;
+    atomic<NodeId> allocated_node_count_;
+    mutex alloc_mutex_;
     NodeId root_id_;
+
+    // Roots of the subtrees to reclaim.
+    mutex garbage_mutex_;
+    vector<NodeId> garbage_;
+    atomic<size_t> num_garbage_;
+    atomic_bool exhausted_;
+
+    NodeId reuse() {
+        if (num_garbage_.load() == 0) return NodeIdInvalid;
+        lock_guard<mutex> lock(garbage_mutex_);
+        if (garbage_.empty()) return NodeIdInvalid;
+        NodeId id = garbage_.back();
+        garbage_.pop_back();
+        const Node *node = (*this)[id];
+        for (size_t i = 0; i < node->sa().size(); ++i) {
+            NodeId child = node->sa().next(i);
+            if (child != NodeIdInvalid) garbage_.push_back(child);
+        }
+        num_garbage_ = garbage_.size();
+        return id;
+    }
+
+    NodeId fresh() {
+        NodeId id = allocated_node_count_.load();
+        do {
+            if (id >> kChunkBits >= kMaxChunks) return NodeIdInvalid;
+        } while (! allocated_node_count_.compare_exchange_weak(id, id + 1));
+        return id;
+    }
+
+    // Chunks stay allocated beyond allocated_node_count_ after a Clear(), so look at all of them.
+    void free_chunks() {
+        for (int i = 0; i < kMaxChunks; ++i) {
+            delete [] chunks_[i].load();
+            chunks_[i] = nullptr;
+        }
+        allocated_node_count_ = 0;
+    }
+
+    // Only called for ids that were just allocated, so the chunk might still be missing.
+    Node *node_at(NodeId i) {
+        atomic<Node *> &chunk = chunks_[i >> kChunkBits];
+        Node *p = chunk.load(memory_order_acquire);
+        if (p == nullptr) {
+            lock_guard<mutex> lock(alloc_mutex_);
+            p = chunk.load(memory_order_relaxed);
+            if (p == nullptr) {
+                p = new Node[1 << kChunkBits];
+                chunk.store(p, memory_order_release);
+            }
+        }
+        return p + (i & kChunkMask);
+    }
 };
 
 
@@ -22,12 +22,17 @@ struct TSOptions {
     int max_num_moves = 0;
     int num_threads = 16;
     int num_rollout_per_thread = 100;
+    // Time budget per move in ms (0 = none). The search stops at the budget or after num_rollout_per_thread
+    // rollouts, whichever comes first. With a budget, num_rollout_per_thread <= 0 means no limit.
+    int time_ms_per_move = 0;
     bool verbose = false;
     bool verbose_time = false;
 
     string save_tree_filename;
 
     bool persistent_tree = false;
+    // Keep searching below our move while the opponent is thinking. Needs persistent_tree.
+    bool ponder = false;
     // [TODO] Not a good design.
     // string pick_method = "strongest_prior";
     string pick_method = "most_visited";
@@ -36,22 +41,34 @@ struct TSOptions {
     // Pre-added pseudo playout.
     int pseudo_games = 0;
 
+    // #lost visits put on each edge of a rollout until it is backpropagated (0 = off).
+    float virtual_loss = 0.0;
+
+    // #leaves each thread collects (with virtual loss) before sending them for evaluation at once.
+    int num_leaves_per_thread = 1;
+
+    // #entries of the transposition table (0 = no table). Needs a state_hash hook on the actor or the state.
+    int tt_size = 0;
+
     string info() const {
       stringstream ss;
       ss << "Maximal #moves (0 = no constraint): " << max_num_moves << endl;
       ss << "#Threads: " << num_threads << endl;
       ss << "#Rollout per thread: " << num_rollout_per_thread << endl;
+      if (time_ms_per_move > 0) ss << "Time per move: " << time_ms_per_move << "ms" << endl;
       ss << "Verbose: " << elf_utils::print_bool(verbose) << ", Verbose_time: " << elf_utils::print_bool(verbose_time) << endl;
       if (! save_tree_filename.empty())
         ss << "Save tree filename: " << save_tree_filename << endl;
       ss << "Use prior: " << elf_utils::print_bool(use_prior) << endl;
-      ss << "Persistent tree: " << elf_utils::print_bool(persistent_tree) << endl;
+      ss << "Persistent tree: " << elf_utils::print_bool(persistent_tree) << ", Ponder: " << elf_utils::print_bool(ponder) << endl;
       ss << "#Pseudo game: " << pseudo_games << endl;
+      ss << "Virtual loss: " << virtual_loss << ", #Leaves per thread: " << num_leaves_per_thread << endl;
+      ss << "Transposition table size: " << tt_size << endl;
       ss << "Pick method: " << pick_method << endl;
       return ss.str();
     }
 
-    REGISTER_PYBIND_FIELDS(max_num_moves, num_threads, num_rollout_per_thread, verbose, persistent_tree, pick_method, use_prior, pseudo_games, verbose_time, save_tree_filename);
+    REGISTER_PYBIND_FIELDS(max_num_moves, num_threads, num_rollout_per_thread, verbose, persistent_tree, pick_method, use_prior, pseudo_games, verbose_time, save_tree_filename, virtual_loss, num_leaves_per_thread, tt_size, time_ms_per_move, ponder);
 };
 
 } // namespace mcts
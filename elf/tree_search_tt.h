@@ -0,0 +1,176 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "member_check.h"
+#include "tree_search_node.h"
+
+namespace mcts {
+
+using namespace std;
+
+// The state hash hook: Actor::state_hash(const S &) if the actor has it, otherwise S::state_hash().
+MEMBER_FUNC_CHECK(state_hash)
+
+template <typename Actor, typename S>
+struct HasStateHash {
+    static constexpr bool value = has_func_state_hash<Actor>::value || has_func_state_hash<S>::value;
+};
+
+template <typename Actor, typename S, typename std::enable_if<has_func_state_hash<Actor>::value>::type *U = nullptr>
+uint64_t StateHash(const Actor &actor, const S &s) {
+    return actor.state_hash(s);
+}
+
+template <typename Actor, typename S,
+          typename std::enable_if<! has_func_state_hash<Actor>::value && has_func_state_hash<S>::value>::type *U = nullptr>
+uint64_t StateHash(const Actor &, const S &s) {
+    return s.state_hash();
+}
+
+template <typename Actor, typename S, typename std::enable_if<! HasStateHash<Actor, S>::value>::type *U = nullptr>
+uint64_t StateHash(const Actor &, const S &) {
+    return 0;
+}
+
+struct TTStats {
+    int64_t lookups = 0;
+    int64_t hits = 0;
+    int64_t inserts = 0;
+    // An insert that replaced a different position.
+    int64_t evictions = 0;
+
+    size_t entries = 0;
+    size_t capacity = 0;
+    size_t memory_bytes = 0;
+
+    float hit_rate() const { return lookups > 0 ? (float)hits / lookups : 0.0; }
+
+    // Sum over several tables (e.g., one per game).
+    TTStats &operator+=(const TTStats &s) {
+        lookups += s.lookups;
+        hits += s.hits;
+        inserts += s.inserts;
+        evictions += s.evictions;
+        entries += s.entries;
+        capacity += s.capacity;
+        memory_bytes += s.memory_bytes;
+        return *this;
+    }
+
+    string info() const {
+        stringstream ss;
+        ss << "TT: " << entries << "/" << capacity << " entries, " << memory_bytes / 1024 << " KB, "
+           << "hit rate: " << hit_rate() << " (" << hits << "/" << lookups << "), evictions: " << evictions;
+        return ss.str();
+    }
+};
+
+// Cache of network evaluations keyed by a 64-bit state hash, shared by all search threads.
+// Each entry also remembers the node that was expanded with it, so that a transposition can start
+// from that node's edge statistics. The table has a fixed number of entries, split into stripes that
+// are locked separately. Within a stripe, a position goes to one slot and replaces whatever was there.
+template <typename A>
+class TranspositionTableT {
+public:
+    using NodeResponse = NodeResponseT<A>;
+
+    TranspositionTableT(size_t capacity, int num_stripes = 64)
+        : num_stripes_(num_stripes), node_generation_(0), lookups_(0), hits_(0), inserts_(0), evictions_(0), entries_(0), pi_bytes_(0) {
+        size_t per_stripe = (capacity + num_stripes - 1) / num_stripes;
+        if (per_stripe == 0) per_stripe = 1;
+        for (int i = 0; i < num_stripes; ++i) {
+            stripes_.emplace_back(new Stripe);
+            stripes_.back()->slots.resize(per_stripe);
+        }
+        capacity_ = per_stripe * num_stripes;
+    }
+
+    // On a hit, fill resp, and node with the node expanded from the entry (NodeIdInvalid if that is
+    // from before the last ForgetNodes()).
+    bool Find(uint64_t key, NodeResponse *resp, NodeId *node) {
+        lookups_ ++;
+        Stripe &stripe = stripe_of(key);
+        lock_guard<mutex> lock(stripe.lock);
+        const Entry &e = stripe.slots[slot_of(key, stripe)];
+        if (! e.used || e.key != key) return false;
+
+        hits_ ++;
+        *resp = e.resp;
+        *node = (e.node_generation == node_generation_.load() ? e.node : NodeIdInvalid);
+        return true;
+    }
+
+    void Insert(uint64_t key, const NodeResponse &resp, NodeId node) {
+        inserts_ ++;
+        Stripe &stripe = stripe_of(key);
+        lock_guard<mutex> lock(stripe.lock);
+        Entry &e = stripe.slots[slot_of(key, stripe)];
+        if (! e.used) entries_ ++;
+        else if (e.key != key) evictions_ ++;
+
+        pi_bytes_ -= e.resp.pi.capacity() * sizeof(pair<A, float>);
+        e.used = true;
+        e.key = key;
+        e.resp = resp;
+        e.node = node;
+        e.node_generation = node_generation_.load();
+        pi_bytes_ += e.resp.pi.capacity() * sizeof(pair<A, float>);
+    }
+
+    // The tree was cleared or advanced, so node ids in the table are stale. The evaluations are still good.
+    void ForgetNodes() { node_generation_ ++; }
+
+    TTStats GetStats() const {
+        TTStats stats;
+        stats.lookups = lookups_.load();
+        stats.hits = hits_.load();
+        stats.inserts = inserts_.load();
+        stats.evictions = evictions_.load();
+        stats.entries = entries_.load();
+        stats.capacity = capacity_;
+        stats.memory_bytes = capacity_ * sizeof(Entry) + pi_bytes_.load();
+        return stats;
+    }
+
+private:
+    struct Entry {
+        bool used = false;
+        uint64_t key = 0;
+        NodeResponse resp;
+        NodeId node = NodeIdInvalid;
+        int node_generation = 0;
+    };
+
+    struct Stripe {
+        mutex lock;
+        vector<Entry> slots;
+    };
+
+    const int num_stripes_;
+    size_t capacity_;
+    vector<unique_ptr<Stripe>> stripes_;
+    atomic<int> node_generation_;
+
+    atomic<int64_t> lookups_, hits_, inserts_, evictions_;
+    atomic<size_t> entries_, pi_bytes_;
+
+    Stripe &stripe_of(uint64_t key) { return *stripes_[key % num_stripes_]; }
+    size_t slot_of(uint64_t key, const Stripe &stripe) const { return (key / num_stripes_) % stripe.slots.size(); }
+};
+
+}  // namespace mcts
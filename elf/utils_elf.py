@@ -263,26 +263,30 @@ class GCWrapper:
             gstat.hist_len = T
 
             gstat.name = v.get("name", "")
+            gstat.num_inflight = v.get("num_inflight", 1)
+            gstat.target_p99_usec = v.get("target_p99_usec", 0)
             timeout_usec = v.get("timeout_usec", 0)
 
             gpu2gid.append(list())
             for i in range(num_recv_thread):
-                group_id = GC.AddCollectors(batchsize, len(gpu2gid) - 1, timeout_usec, gstat)
-
-                input_batch = Batch.load(GC, "input", input, group_id, use_gpu=use_gpu, use_numpy=use_numpy)
-                input_batch.batchsize = batchsize
-                inputs.append(input_batch)
-                if reply is not None:
-                    reply_batch = Batch.load(GC, "reply", reply, group_id, use_gpu=use_gpu, use_numpy=use_numpy)
-                    reply_batch.batchsize= batchsize
-                    replies.append(reply_batch)
-                else:
-                    replies.append(None)
-
-                idx2name[group_id] = key
-                name2idx[key].append(group_id)
-                gpu2gid[-1].append(group_id)
-                gid2gpu[group_id] = len(gpu2gid) - 1
+                first_id = GC.AddCollectors(batchsize, len(gpu2gid) - 1, timeout_usec, gstat)
+
+                # Each in-flight batch has its own group id and tensors.
+                for group_id in range(first_id, first_id + gstat.num_inflight):
+                    input_batch = Batch.load(GC, "input", input, group_id, use_gpu=use_gpu, use_numpy=use_numpy)
+                    input_batch.batchsize = batchsize
+                    inputs.append(input_batch)
+                    if reply is not None:
+                        reply_batch = Batch.load(GC, "reply", reply, group_id, use_gpu=use_gpu, use_numpy=use_numpy)
+                        reply_batch.batchsize= batchsize
+                        replies.append(reply_batch)
+                    else:
+                        replies.append(None)
+
+                    idx2name[group_id] = key
+                    name2idx[key].append(group_id)
+                    gpu2gid[-1].append(group_id)
+                    gid2gpu[group_id] = len(gpu2gid) - 1
 
         print(GC.GetCollectorInfos())
 
@@ -12,6 +12,10 @@
 #include "go_state.h"
 #include "elf/ai.h"
 
+namespace GO_NS {
+
 using AI = elf::AI_T<GoState, Coord>;
 using AIWithComm = elf::AIWithCommT<GoState, Coord, AIComm>;
 using AIHoldStateWithComm = elf::AIHoldStateWithCommT<GoState, Coord, AIComm>;
+
+}  // namespace GO_NS
@@ -0,0 +1,112 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//g++ -O3 -march=native -std=c++11 benchmark-playout.cpp board.cc common.cc -o benchmark-playout
+// Usage: ./benchmark-playout [#playouts] [self_atari_thres]
+//
+// Random playouts from the empty board, one FindAllCandidateMoves per ply, scored with GetTrompTaylorScore.
+// The same playouts are run with the per-point move generation that the bitboards replaced, and both
+// have to pick the same moves and scores. Add -DGO_BOARD_SIZE=9 (or 13) for the smaller boards.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "board.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace GO_NS;
+
+// The old generator: TryPlay (ko and suicide), IsTrueEye, and a self-atari check that plays the move on a copy.
+static bool IsSelfAtariByCopy(const Board *board, const GroupId4 *ids, Coord c, Stone player, int *num_stones) {
+  if (ids->liberty >= 2) return false;
+  for (int i = 0; i < 4; ++i) {
+    if (ids->ids[i] != 0 && ids->colors[i] == player && ids->group_liberties[i] > 2) return false;
+  }
+  Board b2;
+  CopyBoard(&b2, board);
+  Play(&b2, ids);
+  short id = b2._infos[c].id;
+  if (b2._groups[id].liberties != 1) return false;
+  *num_stones = b2._groups[id].stones;
+  return true;
+}
+
+static void FindAllCandidateMovesPerPoint(const Board *board, Stone player, int self_atari_thres, AllMoves *all_moves) {
+  all_moves->board = board;
+  all_moves->num_moves = 0;
+  GroupId4 ids;
+  int self_atari_count = 0;
+  // Same order as the bitboards (increasing coord).
+  for (int y = 0; y < BOARD_SIZE; ++y) {
+    for (int x = 0; x < BOARD_SIZE; ++x) {
+      Coord c = OFFSETXY(x, y);
+      if (! EMPTY(board->_infos[c].color)) continue;
+      if (! TryPlay(board, x, y, player, &ids)) continue;
+      if (IsTrueEye(board, c, player)) continue;
+      if (IsSelfAtariByCopy(board, &ids, c, player, &self_atari_count) && self_atari_count >= self_atari_thres) continue;
+      all_moves->moves[all_moves->num_moves++] = c;
+    }
+  }
+}
+
+typedef void (*MoveGen)(const Board *, Stone, int, AllMoves *);
+
+// Returns the sum of the scores, so that the two generators can be compared.
+static float RunPlayouts(MoveGen gen, int num_playouts, int self_atari_thres, int64_t *num_plies, bool tt_by_flood_fill) {
+  std::mt19937 rng(0);
+  Board board;
+  AllMoves all_moves;
+  Stone territory[BOARD_SIZE * BOARD_SIZE];
+  float total = 0;
+  *num_plies = 0;
+
+  for (int i = 0; i < num_playouts; ++i) {
+    ClearBoard(&board);
+    int passes = 0;
+    while (passes < 2 && board._ply < 3 * NUM_INTERSECTION) {
+      gen(&board, board._next_player, self_atari_thres, &all_moves);
+      Coord c = all_moves.num_moves > 0 ? all_moves.moves[rng() % all_moves.num_moves] : M_PASS;
+      passes = (c == M_PASS ? passes + 1 : 0);
+      GroupId4 ids;
+      TryPlay2(&board, c, &ids);
+      Play(&board, &ids);
+      (*num_plies) ++;
+    }
+    total += GetTrompTaylorScore(&board, NULL, tt_by_flood_fill ? territory : NULL);
+  }
+  return total;
+}
+
+int main(int argc, char *argv[]) {
+  int num_playouts = argc > 1 ? atoi(argv[1]) : 2000;
+  int self_atari_thres = argc > 2 ? atoi(argv[2]) : 3;
+
+  cout << BOARD_SIZE << "x" << BOARD_SIZE << ", " << num_playouts << " playouts, self-atari threshold " << self_atari_thres << endl;
+
+  int64_t plies_bits = 0, plies_point = 0;
+  auto start = steady_clock::now();
+  float score_bits = RunPlayouts(FindAllCandidateMoves, num_playouts, self_atari_thres, &plies_bits, false);
+  double sec_bits = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+  start = steady_clock::now();
+  float score_point = RunPlayouts(FindAllCandidateMovesPerPoint, num_playouts, self_atari_thres, &plies_point, true);
+  double sec_point = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+  if (plies_bits != plies_point || score_bits != score_point) {
+    cout << "Mismatch: bitboards " << plies_bits << " plies, score " << score_bits
+         << ", per point " << plies_point << " plies, score " << score_point << endl;
+    return 1;
+  }
+
+  cout << "  bitboards: " << num_playouts / sec_bits << " playouts/sec, " << sec_bits * 1e9 / plies_bits << " ns/ply" << endl;
+  cout << "  per point: " << num_playouts / sec_point << " playouts/sec, " << sec_point * 1e9 / plies_point << " ns/ply" << endl;
+  return 0;
+}
@@ -9,10 +9,122 @@
 #include "board.h"
 #include <vector>
 
+namespace GO_NS {
+
 #define assert(p, text) do { if (!(p)) { printf((text)); } }while(0)
 #define min(a, b) ( ((a) < (b)) ? (a) : (b) )
 #define max(a, b) ( ((a) > (b)) ? (a) : (b) )
 
+// Zobrist keys. Each key is a fixed mix (splitmix64) of its index, so there is no table to set up,
+// and the hashes are the same in every process.
+static inline uint64_t zobrist_key(uint64_t i) {
+  uint64_t z = (i + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+#define ZOBRIST_STONE(c, s) zobrist_key((uint64_t)(c) * 2 + (s) - S_BLACK)
+#define ZOBRIST_KO(c) zobrist_key(2 * BOUND_COORD + (c))
+#define ZOBRIST_WHITE_TO_MOVE zobrist_key(3 * BOUND_COORD)
+
+static inline uint64_t HashSideToMove(const Board *board) {
+  return board->_next_player == S_WHITE ? ZOBRIST_WHITE_TO_MOVE : 0;
+}
+
+static inline uint64_t HashSimpleKo(const Board *board) {
+  return board->_ko_age == 0 && board->_simple_ko != M_PASS ? ZOBRIST_KO(board->_simple_ko) : 0;
+}
+
+// Bitboard operations. All loops run over BITBOARD_WORDS, which is a compile-time constant.
+static inline void bb_zero(Bitboard *bb) {
+  memset(bb, 0, sizeof(Bitboard));
+}
+
+static inline bool bb_is_zero(const Bitboard *bb) {
+  uint64_t any = 0;
+  for (int i = 0; i < BITBOARD_WORDS; ++i) any |= bb->w[i];
+  return any == 0;
+}
+
+static inline int bb_count(const Bitboard *bb) {
+  int n = 0;
+  for (int i = 0; i < BITBOARD_WORDS; ++i) n += __builtin_popcountll(bb->w[i]);
+  return n;
+}
+
+// out[c] = in[c + d], i.e. whether the neighbour at c + d is in the set.
+static inline void bb_from_next(Bitboard *out, const Bitboard *in, int d) {
+  for (int i = 0; i < BITBOARD_WORDS; ++i) {
+    out->w[i] = (in->w[i] >> d) | (i + 1 < BITBOARD_WORDS ? in->w[i + 1] << (64 - d) : 0);
+  }
+}
+
+// out[c] = in[c - d].
+static inline void bb_from_prev(Bitboard *out, const Bitboard *in, int d) {
+  for (int i = 0; i < BITBOARD_WORDS; ++i) {
+    out->w[i] = (in->w[i] << d) | (i > 0 ? in->w[i - 1] >> (64 - d) : 0);
+  }
+}
+
+// Points with at least one of the four neighbours in the set.
+static inline void bb_neighbors(Bitboard *out, const Bitboard *in) {
+  Bitboard l, r, t, b;
+  bb_from_prev(&l, in, 1);
+  bb_from_next(&r, in, 1);
+  bb_from_prev(&t, in, BOARD_EXPAND_SIZE);
+  bb_from_next(&b, in, BOARD_EXPAND_SIZE);
+  for (int i = 0; i < BITBOARD_WORDS; ++i) out->w[i] = l.w[i] | r.w[i] | t.w[i] | b.w[i];
+}
+
+// Grow region through mask until it stops changing.
+static inline void bb_flood(Bitboard *region, const Bitboard *mask) {
+  Bitboard next;
+  while (true) {
+    bb_neighbors(&next, region);
+    uint64_t changed = 0;
+    for (int i = 0; i < BITBOARD_WORDS; ++i) {
+      uint64_t w = (next.w[i] & mask->w[i]) | region->w[i];
+      changed |= w ^ region->w[i];
+      region->w[i] = w;
+    }
+    if (changed == 0) return;
+  }
+}
+
+static const Bitboard &OnBoardMask() {
+  static const Bitboard on_board = [] {
+    Bitboard bb;
+    bb_zero(&bb);
+    for (int x = 0; x < BOARD_SIZE; ++x) {
+      for (int y = 0; y < BOARD_SIZE; ++y) BB_SET(bb, OFFSETXY(x, y));
+    }
+    return bb;
+  }();
+  return on_board;
+}
+
+static inline void bb_empty_points(const Board *board, Bitboard *empty) {
+  const Bitboard &on_board = OnBoardMask();
+  for (int i = 0; i < BITBOARD_WORDS; ++i) {
+    empty->w[i] = on_board.w[i] & ~(board->_stones[0].w[i] | board->_stones[1].w[i]);
+  }
+}
+
+static inline void bb_add_group(const Board *board, int id, Bitboard *bb) {
+  TRAVERSE(board, id, c) {
+    BB_SET(*bb, c);
+  } ENDTRAVERSE
+}
+
+// Stones of all groups with a single liberty.
+static inline void bb_atari_stones(const Board *board, Bitboard *atari) {
+  bb_zero(atari);
+  for (int id = 1; id < board->_num_groups; ++id) {
+    if (board->_groups[id].liberties == 1) bb_add_group(board, id, atari);
+  }
+}
+
 // Functions..
 void SetAsBorder(Board* board, int /*side*/, int i1, int w, int j1, int h) {
   for (int i = i1; i < i1 + w; i++) {
@@ -42,7 +154,7 @@ void ClearBoard(Board *board) {
   board->_num_groups = 1;
   // The initial ply number is 1.
   board->_ply = 1;
-  // The initial hash is zero.
+  // The initial hash is zero (no stones, black to move, no ko).
 }
 
 bool PlaceHandicap(Board *board, int x, int y, Stone player) {
@@ -184,15 +296,29 @@ bool IsSelfAtari(const Board *board, const GroupId4 *ids, Coord c, Stone player,
     }
   }
 
-  // Then we duplicate a board and check.
-  Board b2;
-  CopyBoard(&b2, board);
-  Play(&b2, ids);
-  // ShowBoard(&b2, SHOW_LAST_MOVE);
+  // Then count the liberties of the group the move would form, without playing it.
+  // They are the empty neighbours of the new stone and our adjacent groups, where the stones
+  // of captured enemy groups count as empty.
+  Bitboard group, space, libs;
+  bb_zero(&group);
+  bb_empty_points(board, &space);
+  BB_SET(group, c);
+  int stones = 1;
+  for (int i = 0; i < 4; ++i) {
+    if (ids->ids[i] == 0) continue;
+    if (ids->colors[i] == player) {
+      bb_add_group(board, ids->ids[i], &group);
+      stones += board->_groups[ids->ids[i]].stones;
+    } else if (ids->group_liberties[i] == 1) {
+      bb_add_group(board, ids->ids[i], &space);
+    }
+  }
+  BB_CLEAR(space, c);
 
-  short id = b2._infos[c].id;
-  if (b2._groups[id].liberties == 1) {
-    if (num_stones != NULL) *num_stones = b2._groups[id].stones;
+  bb_neighbors(&libs, &group);
+  for (int i = 0; i < BITBOARD_WORDS; ++i) libs.w[i] &= space.w[i];
+  if (bb_count(&libs) == 1) {
+    if (num_stones != NULL) *num_stones = stones;
     return true;
   } else {
     return false;
@@ -403,6 +529,8 @@ void RemoveStoneAndAddLiberty(Board *board, Coord c) {
   }
 
   // printf("RemoveStoneAndAddLiberty: Remove stone at (%d, %d), belonging to Group %d\n", X(c), Y(c), board->_infos[c].id);
+  board->_hash ^= ZOBRIST_STONE(c, board->_infos[c].color);
+  BB_CLEAR(board->_stones[board->_infos[c].color - S_BLACK], c);
   board->_infos[c].color = S_EMPTY;
   board->_infos[c].id = 0;
   board->_infos[c].next = 0;
@@ -682,131 +810,137 @@ void GetAllStones(const Board *board, AllMoves *black, AllMoves *white) {
   }
 }
 
-void FindAllCandidateMoves(const Board* board, Stone player, int self_atari_thres, AllMoves *all_moves) {
-  GroupId4 ids;
-  Coord c;
-  all_moves->board = board;
-  all_moves->num_moves = 0;
-  int self_atari_count = 0;
-  for (int x = 0; x < BOARD_SIZE; ++x) {
-    for (int y = 0; y < BOARD_SIZE; ++y) {
-      c = OFFSETXY(x, y);
-      if (!EMPTY(board->_infos[c].color)) continue;
-      StoneLibertyAnalysis(board, player, c, &ids);
-
-      // It is illegal to play at ko locations.
-      if (IsSimpleKoViolation(board, c, player)) continue;
-
-      // It is illegal to play a suicide move.
-      if (IsSuicideMove(&ids)) continue;
+void GetLegalMoveMask(const Board *board, Stone player, Bitboard *legal) {
+  // An empty point is legal if it has an empty neighbour, an own neighbour group with more than one liberty,
+  // or an enemy neighbour group in atari (see IsSuicideMove).
+  const Bitboard &own = board->_stones[player - S_BLACK];
+  const Bitboard &enemy = board->_stones[OPPONENT(player) - S_BLACK];
+  Bitboard empty, atari, reach;
+  bb_empty_points(board, &empty);
+  bb_atari_stones(board, &atari);
+  for (int i = 0; i < BITBOARD_WORDS; ++i) {
+    reach.w[i] = empty.w[i] | (own.w[i] & ~atari.w[i]) | (enemy.w[i] & atari.w[i]);
+  }
+  bb_neighbors(legal, &reach);
+  for (int i = 0; i < BITBOARD_WORDS; ++i) legal->w[i] &= empty.w[i];
 
-      // Never fill a true eye.
-      if (IsTrueEye(board, c, player)) continue;
+  if (board->_ko_age == 0 && board->_simple_ko_color == player && board->_simple_ko != M_PASS) {
+    BB_CLEAR(*legal, board->_simple_ko);
+  }
+}
 
-      // Be careful about self-atari moves.
-      if (IsSelfAtari(board, &ids, c, player, &self_atari_count)) {
-        // For self-atari's with fewer counts, we could tolorate since they are usually important in killing others' group.
-        if (self_atari_count >= self_atari_thres) continue;
-      }
+static void RegionMask(const Region *r, Bitboard *mask) {
+  if (r == NULL) {
+    *mask = OnBoardMask();
+    return;
+  }
+  bb_zero(mask);
+  for (int x = r->left; x < r->right; ++x) {
+    for (int y = r->top; y < r->bottom; ++y) BB_SET(*mask, OFFSETXY(x, y));
+  }
+}
 
-      all_moves->moves[all_moves->num_moves++] = c;
+// Append the points of moves to all_moves, in increasing coord order.
+static inline void AppendMoves(const Bitboard *moves, AllMoves *all_moves) {
+  for (int i = 0; i < BITBOARD_WORDS; ++i) {
+    uint64_t w = moves->w[i];
+    while (w) {
+      all_moves->moves[all_moves->num_moves++] = (Coord)(i * 64 + __builtin_ctzll(w));
+      w &= w - 1;
     }
   }
 }
 
-void FindAllCandidateMovesInRegion(const Board* board, const Region *r, Stone player, int self_atari_thres, AllMoves *all_moves) {
-  GroupId4 ids;
-  Coord c;
+static void FindCandidateMovesInMask(const Board* board, const Bitboard *area, Stone player, int self_atari_thres, AllMoves *all_moves) {
   all_moves->board = board;
   all_moves->num_moves = 0;
-  int self_atari_count = 0;
 
-  int left, top, right, bottom;
-  if (r == NULL) {
-    left = 0;
-    top = 0;
-    right = BOARD_SIZE;
-    bottom = BOARD_SIZE;
-  } else {
-    left = r->left;
-    top = r->top;
-    right = r->right;
-    bottom = r->bottom;
+  Bitboard legal, empty, wall;
+  GetLegalMoveMask(board, player, &legal);
+  bb_empty_points(board, &empty);
+
+  // Neighbours in the four directions: walls (own stones or border) for the eyes, and empty points for liberties.
+  const Bitboard &own = board->_stones[player - S_BLACK];
+  const Bitboard &on_board = OnBoardMask();
+  for (int i = 0; i < BITBOARD_WORDS; ++i) wall.w[i] = own.w[i] | ~on_board.w[i];
+
+  Bitboard wl, wr, wt, wb, el, er, et, eb;
+  bb_from_prev(&wl, &wall, 1);
+  bb_from_next(&wr, &wall, 1);
+  bb_from_prev(&wt, &wall, BOARD_EXPAND_SIZE);
+  bb_from_next(&wb, &wall, BOARD_EXPAND_SIZE);
+  bb_from_prev(&el, &empty, 1);
+  bb_from_next(&er, &empty, 1);
+  bb_from_prev(&et, &empty, BOARD_EXPAND_SIZE);
+  bb_from_next(&eb, &empty, BOARD_EXPAND_SIZE);
+
+  Bitboard eyes, two_libs;
+  for (int i = 0; i < BITBOARD_WORDS; ++i) {
+    legal.w[i] &= area->w[i];
+    // IsEye.
+    eyes.w[i] = legal.w[i] & wl.w[i] & wr.w[i] & wt.w[i] & wb.w[i];
+    // At least two empty neighbours, so the move can never be a self-atari.
+    two_libs.w[i] = (el.w[i] & er.w[i]) | (et.w[i] & eb.w[i]) | ((el.w[i] | er.w[i]) & (et.w[i] | eb.w[i]));
   }
 
-  for (int x = left; x < right; ++x) {
-    for (int y = top; y < bottom; ++y) {
-      c = OFFSETXY(x, y);
-      if (!EMPTY(board->_infos[c].color)) continue;
-      StoneLibertyAnalysis(board, player, c, &ids);
-
-      // It is illegal to play at ko locations.
-      if (IsSimpleKoViolation(board, c, player)) continue;
-
-      // It is illegal to play a suicide move.
-      if (IsSuicideMove(&ids)) continue;
-
-      // Never fill a true eye.
-      if (IsTrueEye(board, c, player)) continue;
-
-      // Be careful about self-atari moves.
-      if (IsSelfAtari(board, &ids, c, player, &self_atari_count)) {
-        // For self-atari's with fewer counts, we could tolorate since they are usually important in killing others' group.
-        if (self_atari_count >= self_atari_thres) continue;
+  // Never fill a true eye. There are only a few eyes, so check their diagonals one by one.
+  if (! bb_is_zero(&eyes)) {
+    for (int i = 0; i < BITBOARD_WORDS; ++i) {
+      uint64_t w = eyes.w[i];
+      while (w) {
+        Coord c = (Coord)(i * 64 + __builtin_ctzll(w));
+        if (! IsFakeEye(board, c, player)) BB_CLEAR(legal, c);
+        w &= w - 1;
       }
+    }
+  }
 
+  GroupId4 ids;
+  int self_atari_count = 0;
+  for (int i = 0; i < BITBOARD_WORDS; ++i) {
+    uint64_t w = legal.w[i];
+    while (w) {
+      Coord c = (Coord)(i * 64 + __builtin_ctzll(w));
+      w &= w - 1;
+      if (! BB_TEST(two_libs, c)) {
+        StoneLibertyAnalysis(board, player, c, &ids);
+        // Be careful about self-atari moves.
+        if (IsSelfAtari(board, &ids, c, player, &self_atari_count)) {
+          // For self-atari's with fewer counts, we could tolorate since they are usually important in killing others' group.
+          if (self_atari_count >= self_atari_thres) continue;
+        }
+      }
       all_moves->moves[all_moves->num_moves++] = c;
     }
   }
 }
 
+void FindAllCandidateMoves(const Board* board, Stone player, int self_atari_thres, AllMoves *all_moves) {
+  FindCandidateMovesInMask(board, &OnBoardMask(), player, self_atari_thres, all_moves);
+}
+
+void FindAllCandidateMovesInRegion(const Board* board, const Region *r, Stone player, int self_atari_thres, AllMoves *all_moves) {
+  Bitboard area;
+  RegionMask(r, &area);
+  FindCandidateMovesInMask(board, &area, player, self_atari_thres, all_moves);
+}
+
 void FindAllValidMoves(const Board* board, Stone player, AllMoves *all_moves) {
-  GroupId4 ids;
-  Coord c;
+  Bitboard legal;
+  GetLegalMoveMask(board, player, &legal);
   all_moves->board = board;
   all_moves->num_moves = 0;
-  for (int x = 0; x < BOARD_SIZE; ++x) {
-    for (int y = 0; y < BOARD_SIZE; ++y) {
-      c = OFFSETXY(x, y);
-      if (!EMPTY(board->_infos[c].color)) continue;
-      StoneLibertyAnalysis(board, player, c, &ids);
-      if (IsSimpleKoViolation(board, c, player)) continue;
-      if (IsSuicideMove(&ids)) continue;
-
-      all_moves->moves[all_moves->num_moves++] = c;
-    }
-  }
+  AppendMoves(&legal, all_moves);
 }
 
 void FindAllValidMovesInRegion(const Board *board, const Region *r, AllMoves *all_moves) {
-  int left, top, right, bottom;
-  if (r == NULL) {
-    left = 0;
-    top = 0;
-    right = BOARD_SIZE;
-    bottom = BOARD_SIZE;
-  } else {
-    left = r->left;
-    top = r->top;
-    right = r->right;
-    bottom = r->bottom;
-  }
-
-  GroupId4 ids;
-  Coord c;
+  Bitboard legal, area;
+  GetLegalMoveMask(board, board->_next_player, &legal);
+  RegionMask(r, &area);
+  for (int i = 0; i < BITBOARD_WORDS; ++i) legal.w[i] &= area.w[i];
   all_moves->board = board;
   all_moves->num_moves = 0;
-  for (int x = left; x < right; ++x) {
-    for (int y = top; y < bottom; ++y) {
-      c = OFFSETXY(x, y);
-      if (!EMPTY(board->_infos[c].color)) continue;
-      StoneLibertyAnalysis(board, board->_next_player, c, &ids);
-      if (IsSimpleKoViolation(board, c, board->_next_player)) continue;
-      if (IsSuicideMove(&ids)) continue;
-
-      all_moves->moves[all_moves->num_moves++] = c;
-    }
-  }
+  AppendMoves(&legal, all_moves);
 }
 
 bool IsIn(const Region *r, Coord c) {
@@ -1009,20 +1143,16 @@ bool OneGroupLives(const Board *board, Stone player, const Region *r) {
   return false;
 }
 
-#define MOVE_HASH(c, player, ply) ( ((ply) << 24) + ((player) << 16) + (c) )
-
 static inline void update_next_move(Board *board, Coord c, Stone player) {
+  board->_hash ^= HashSideToMove(board);
   board->_next_player = OPPONENT(player);
+  board->_hash ^= HashSideToMove(board);
 
   board->_last_move4 = board->_last_move3;
   board->_last_move3 = board->_last_move2;
   board->_last_move2 = board->_last_move;
   board->_last_move = c;
 
-  // Compute the hash code with c, player and ply.
-  // unsigned long seed = MOVE_HASH(c, player, board->_ply);
-  // board->hash ^= fast_random64(&seed);
-
   board->_ply ++;
 }
 
@@ -1032,10 +1162,8 @@ static inline void update_undo(Board *board) {
   board->_last_move2 = board->_last_move3;
   board->_last_move3 = board->_last_move4;
   board->_next_player = OPPONENT(board->_next_player);
+  board->_hash ^= ZOBRIST_WHITE_TO_MOVE;
   board->_ply --;
-
-  // unsigned long seed = MOVE_HASH(c, board->_next_player, board->_ply);
-  // board->hash ^= fast_random64(&seed);
 }
 
 // Return 0 if there is no ladder, otherwise return the depth of the ladder.
@@ -1158,8 +1286,11 @@ bool Play(Board *board, const GroupId4 *ids) {
 
     new_id = CreateNewGroup(board, c, liberty);
   }
+  board->_hash ^= ZOBRIST_STONE(c, player);
+  BB_SET(board->_stones[player - S_BLACK], c);
 
   // Check simple ko conditions.
+  board->_hash ^= HashSimpleKo(board);
   const Group* g = &board->_groups[new_id];
   if (g->liberties == 1 && g->stones == 1 && total_capture == 1) {
     board->_simple_ko = capture_c;
@@ -1169,6 +1300,7 @@ bool Play(Board *board, const GroupId4 *ids) {
     board->_ko_age ++;
     // board->_simple_ko = M_PASS;
   }
+  board->_hash ^= HashSimpleKo(board);
 
   // We need to run it in the end. After that all group index will be invalid.
   RemoveAllEmptyGroups(board);
@@ -1178,6 +1310,40 @@ bool Play(Board *board, const GroupId4 *ids) {
   return false;
 }
 
+uint64_t GetBoardHash(const Board *board) {
+  return board->_hash;
+}
+
+uint64_t GetPositionHash(const Board *board) {
+  return board->_hash ^ HashSideToMove(board) ^ HashSimpleKo(board);
+}
+
+uint64_t GetPositionHashAfterPlay(const Board *board, const GroupId4 *ids) {
+  uint64_t hash = GetPositionHash(board);
+  if (ids->c == M_PASS || ids->c == M_RESIGN) return hash;
+
+  hash ^= ZOBRIST_STONE(ids->c, ids->player);
+  // Enemy groups in atari are captured. StoneLibertyAnalysis lists each group once.
+  for (int i = 0; i < 4; ++i) {
+    if (ids->ids[i] == 0 || ids->colors[i] == ids->player || ids->group_liberties[i] != 1) continue;
+    TRAVERSE(board, ids->ids[i], c) {
+      hash ^= ZOBRIST_STONE(c, ids->colors[i]);
+    } ENDTRAVERSE
+  }
+  return hash;
+}
+
+uint64_t ComputeBoardHash(const Board *board) {
+  uint64_t hash = HashSideToMove(board) ^ HashSimpleKo(board);
+  for (int x = 0; x < BOARD_SIZE; ++x) {
+    for (int y = 0; y < BOARD_SIZE; ++y) {
+      Coord c = OFFSETXY(x, y);
+      if (HAS_STONE(board->_infos[c].color)) hash ^= ZOBRIST_STONE(c, board->_infos[c].color);
+    }
+  }
+  return hash;
+}
+
 bool UndoPass(Board *board) {
   if (board->_last_move != M_PASS) return false;
   update_undo(board);
@@ -1494,6 +1660,18 @@ void VerifyBoard(Board* board) {
     // Free the memory.
     delete [] visited;
   }
+  for (int i = 0; i < BOARD_SIZE; ++i) {
+    for (int j = 0; j < BOARD_SIZE; ++j) {
+      Coord c = OFFSETXY(i, j);
+      Stone s = board->_infos[c].color;
+      if ((bool)BB_TEST(board->_stones[0], c) != (s == S_BLACK) || (bool)BB_TEST(board->_stones[1], c) != (s == S_WHITE)) {
+        printf("[VerifyError]: stone bitboards and color [%d] mismatch at (%d, %d)\n", s, X(c), Y(c));
+      }
+    }
+  }
+  if (board->_hash != ComputeBoardHash(board)) {
+    printf("[VerifyError]: Incremental hash %" PRIx64 " != recomputed hash %" PRIx64 "\n", board->_hash, ComputeBoardHash(board));
+  }
   printf("-----End verifying-----\n");
 }
 
@@ -1581,12 +1759,44 @@ float GetFastScore(const Board* board, const int rule) {
   return cnScore;
 }
 
-float GetTrompTaylorScore(const Board *board, const Stone *group_stats, Stone *territory) {
-  Stone * internal_territory = NULL;
-  if (territory == NULL) {
-    internal_territory = new Stone[BOARD_SIZE * BOARD_SIZE];
-    territory = internal_territory;
+// Tromp-Taylor score on bitboards: an empty point belongs to a color if it only reaches stones of that color.
+static float TrompTaylorScoreBits(const Board *board, const Stone *group_stats) {
+  Bitboard black = board->_stones[0], white = board->_stones[1];
+  if (group_stats != NULL) {
+    // Dead stones count as the opponent's.
+    for (int id = 1; id < board->_num_groups; ++id) {
+      if (! (group_stats[id] & S_DEAD)) continue;
+      Bitboard *from = board->_groups[id].color == S_BLACK ? &black : &white;
+      Bitboard *to = board->_groups[id].color == S_BLACK ? &white : &black;
+      TRAVERSE(board, id, c) {
+        BB_CLEAR(*from, c);
+        BB_SET(*to, c);
+      } ENDTRAVERSE
+    }
+  }
+
+  Bitboard empty, reach_black, reach_white;
+  bb_empty_points(board, &empty);
+  bb_neighbors(&reach_black, &black);
+  bb_neighbors(&reach_white, &white);
+  for (int i = 0; i < BITBOARD_WORDS; ++i) {
+    reach_black.w[i] &= empty.w[i];
+    reach_white.w[i] &= empty.w[i];
   }
+  bb_flood(&reach_black, &empty);
+  bb_flood(&reach_white, &empty);
+
+  int score = bb_count(&black) - bb_count(&white);
+  for (int i = 0; i < BITBOARD_WORDS; ++i) {
+    score += __builtin_popcountll(reach_black.w[i] & ~reach_white.w[i]);
+    score -= __builtin_popcountll(reach_white.w[i] & ~reach_black.w[i]);
+  }
+  return score;
+}
+
+float GetTrompTaylorScore(const Board *board, const Stone *group_stats, Stone *territory) {
+  if (territory == NULL) return TrompTaylorScoreBits(board, group_stats);
+
   ::memset(territory, S_EMPTY, BOARD_SIZE * BOARD_SIZE * sizeof(Stone));
 
   //
@@ -1679,8 +1889,6 @@ float GetTrompTaylorScore(const Board *board, const Stone *group_stats, Stone *t
     }
   }
 
-  if (internal_territory) delete [] internal_territory;
-
   // Finally count the score.
   // printf("black = %d\n", territories[S_BLACK]);
   // printf("white = %d\n", territories[S_WHITE]);
@@ -1715,3 +1923,5 @@ char *get_move_str(Coord m, Stone player, char *buf) {
 void util_show_move(Coord m, Stone player, char *buf) {
   fprintf(stderr,"Move: x = %d, y = %d, m = %d, str = %s\n", X(m), Y(m), m, get_move_str(m, player, buf));
 }
+
+}  // namespace GO_NS
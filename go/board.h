@@ -12,15 +12,34 @@
 #include <memory.h>
 #include "common.h"
 
-// This can be changed to 9x9
-constexpr int BOARD_SIZE = 19;
+// The board size is fixed at compile time. CMakeLists.txt builds the engine once per size (9, 13 and 19),
+// each with its own GO_BOARD_SIZE and in its own namespace (go9, go13, go19), so that one module hosts all of them.
+#ifndef GO_BOARD_SIZE
+#define GO_BOARD_SIZE 19
+#endif
+
+#define GO_NS_CONCAT2(a, b) a ## b
+#define GO_NS_CONCAT(a, b) GO_NS_CONCAT2(a, b)
+#define GO_NS GO_NS_CONCAT(go, GO_BOARD_SIZE)
 
 // 19x19 only
 #define STAR_ON19(i, j) ( ((i) == 3 || (i) == 9 || (i) == 15) && ((j) == 3 || (j) == 9 || (j) == 15) )
+// 13x13 only
+#define STAR_ON13(i, j) ( ( ((i) == 3 || (i) == 9) && ((j) == 3 || (j) == 9) ) || (i == 6 && j == 6) )
 // 9x9 only
 #define STAR_ON9(i, j) ( ( ((i) == 2 || (i) == 6) && ((j) == 2 || (j) == 6) ) || (i == 4 && j == 4) )
 
+#if GO_BOARD_SIZE == 9
+#define STAR STAR_ON9
+#elif GO_BOARD_SIZE == 13
+#define STAR STAR_ON13
+#else
 #define STAR STAR_ON19
+#endif
+
+namespace GO_NS {
+
+constexpr int BOARD_SIZE = GO_BOARD_SIZE;
 
 constexpr int BOARD_MARGIN = 1;
 constexpr int BOARD_EXPAND_SIZE = BOARD_SIZE + 2;
@@ -63,8 +82,14 @@ typedef struct {
 } GroupId4;
 
 // How many live groups can possibly be there in a game?
-// We use 173 so that sizeof(MBoard) <= 4096. This is important for atomic data transmission using pipe.
+// We use 173 so that sizeof(MBoard) <= 4096. This was important for atomic data transmission using pipe.
+// (Boards are only copied in memory here, and with the stone bitboards 19x19 is a bit over 4096.)
+// Smaller boards are well under that, so they get 2/3 of their intersections.
+#if GO_BOARD_SIZE == 19
 #define MAX_GROUP 173
+#else
+#define MAX_GROUP (NUM_INTERSECTION * 2 / 3)
+#endif
 /*
 Next step
 1. No PASS handling. need to add.
@@ -74,6 +99,17 @@ Next step
 // Maximum possible value of coords.
 constexpr int BOUND_COORD = BOARD_EXPAND_SIZE * BOARD_EXPAND_SIZE;
 
+// A set of intersections, one bit per coord (bit c is Coord c). Border bits are never set by the board,
+// so the neighbours of a set are shifts by 1 and BOARD_EXPAND_SIZE, and rows do not leak into each other.
+constexpr int BITBOARD_WORDS = (BOUND_COORD + 63) / 64;
+typedef struct {
+  uint64_t w[BITBOARD_WORDS];
+} Bitboard;
+
+#define BB_TEST(bb, c) ( ((bb).w[(c) >> 6] >> ((c) & 63)) & 1 )
+#define BB_SET(bb, c) ( (bb).w[(c) >> 6] |= 1ULL << ((c) & 63) )
+#define BB_CLEAR(bb, c) ( (bb).w[(c) >> 6] &= ~(1ULL << ((c) & 63)) )
+
 // Board
 typedef struct {
   // Board
@@ -120,8 +156,12 @@ typedef struct {
   // The current ply number, it will be increase after each play.
   // The initial ply number is 1.
   short _ply;
-  // uint64_t hash for the current board situatons. If we want to enable it, then make MAX_GROUP smaller.
-  // uint64_t hash;
+  // Zobrist hash of the stones, the side to move and the active simple ko point.
+  // Play() keeps it up to date with one xor per stone change.
+  uint64_t _hash;
+
+  // Stones of S_BLACK and S_WHITE (index player - S_BLACK), kept in sync with _infos.
+  Bitboard _stones[2];
 } Board;
 
 // Save all candidate moves.
@@ -269,8 +309,12 @@ bool IsIn(const Region *region, Coord c);
 void Expand(Region *region, Coord c);
 bool GroupInRegion(const Board *board, short group_idx, const Region *r);
 
-// Pretty slow. Need some improvements.
-// Find all valid moves excluding self-atari.
+// Legal moves of player (not occupied, no suicide, no simple ko violation) as a bitboard.
+// A handful of word ops per call, e.g. for masking the policy.
+void GetLegalMoveMask(const Board *board, Stone player, Bitboard *legal);
+
+// Find all valid moves, excluding those that fill an own true eye or self-atari self_atari_thres or more stones.
+// These work on bitboards, only points with fewer than two empty neighbours need a self-atari check.
 void FindAllCandidateMoves(const Board* board, Stone player, int self_atari_thres, AllMoves *all_moves);
 void FindAllCandidateMovesInRegion(const Board* board, const Region *r, Stone player, int self_atari_thres, AllMoves *all_moves);
 
@@ -322,6 +366,16 @@ Coord GetSimpleKoLocation(const Board *board, Stone *player);
 // Check if the game has ended
 bool IsGameEnd(const Board *board);
 
+// Zobrist hashes.
+// The board hash covers the stones, the side to move and the active simple ko point.
+// The position hash only covers the stones, which is what positional superko compares.
+uint64_t GetBoardHash(const Board *board);
+uint64_t GetPositionHash(const Board *board);
+// The position hash after the move in ids (from TryPlay) would be played, without playing it.
+uint64_t GetPositionHashAfterPlay(const Board *board, const GroupId4 *ids);
+// Hash the board from scratch. Used to verify the incremental one.
+uint64_t ComputeBoardHash(const Board *board);
+
 void GetAllEmptyLocations(const Board* board, AllMoves *all_moves);
 
 bool IsEye(const Board *board, Coord c, Stone player);
@@ -369,3 +423,4 @@ bool GetDistanceMap(const Board* board, Stone player, float *data);
 char *get_move_str(Coord m, Stone player, char *buf);
 void util_show_move(Coord m, Stone player, char *buf);
 
+}  // namespace GO_NS
@@ -11,6 +11,8 @@
 #include <cmath>
 using namespace std;
 
+namespace GO_NS {
+
 #define S_ISA(c1, c2) ( (c2 == S_EMPTY) || (c1 == c2) )
 // For feature extraction.
 // Distance transform
@@ -165,6 +167,21 @@ static float *board_plane(vector<float> *features, int idx) {
 
 #define LAYER(idx) board_plane(features, idx)
 
+const short *BoardFeature::D4Index(Rot rot, bool flip) {
+  // [flip][rot][coord]
+  static const vector<short> tables = [] {
+    vector<short> t(2 * 4 * BOUND_COORD);
+    for (int code = 0; code < 8; ++code) {
+      for (int c = 0; c < BOUND_COORD; ++c) {
+        auto p = Transform(make_pair(X(c), Y(c)), (Rot)(code % 4), code >= 4);
+        t[code * BOUND_COORD + c] = EXPORT_OFFSET_XY(p.first, p.second);
+      }
+    }
+    return t;
+  }();
+  return &tables[((flip ? 4 : 0) + rot) * BOUND_COORD];
+}
+
 /* darkforestGo/utils/goutils.lua
 extended = {
     "our liberties", "opponent liberties", "our simpleko", "our stones", "opponent stones", "empty stones", "our history", "opponent history",
@@ -194,3 +211,57 @@ void BoardFeature::Extract(std::vector<float> *features) const {
   GetDistanceMap(OPPONENT(player), LAYER(OPPONENT_CLOSEST_COLOR));
 }
 
+void BoardFeature::ExtractU8(std::vector<unsigned char> *features) const {
+  const int N = BOARD_SIZE * BOARD_SIZE;
+  Stone player = _board->_next_player;
+  Stone opponent = OPPONENT(player);
+
+  features->resize(MAX_NUM_FEATURE * N);
+  std::fill(features->begin(), features->end(), 0);
+  unsigned char *data = &(*features)[0];
+
+  // Liberties, == 1, == 2, >= 3.
+  for (int i = 1; i < _board->_num_groups; ++i) {
+    const Group &g = _board->_groups[i];
+    if (g.color != player && g.color != opponent) continue;
+    int offset = (g.color == player ? OUR_LIB : OPPONENT_LIB) + (g.liberties == 1 ? 0 : (g.liberties == 2 ? 1 : 2));
+    unsigned char *plane = data + offset * N;
+    TRAVERSE(_board, i, c) {
+      plane[_index[c]] = 1;
+    } ENDTRAVERSE
+  }
+
+  Coord ko = GetSimpleKoLocation(_board, NULL);
+  if (ko != M_PASS) data[OUR_SIMPLE_KO * N + _index[ko]] = 1;
+
+  // Stones and history in one pass. The distance planes start at 0 on the stones and U8_MAX_DISTANCE elsewhere.
+  float dist_ours[BOARD_SIZE * BOARD_SIZE], dist_opponent[BOARD_SIZE * BOARD_SIZE];
+  for (int j = 0; j < BOARD_SIZE; ++j) {
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+      Coord c = OFFSETXY(i, j);
+      int idx = _index[c];
+      const Info &info = _board->_infos[c];
+      dist_ours[idx] = dist_opponent[idx] = U8_MAX_DISTANCE;
+
+      if (info.color == S_EMPTY) {
+        data[EMPTY_STONES * N + idx] = 1;
+        continue;
+      }
+      bool ours = (info.color == player);
+      data[(ours ? OUR_STONES : OPPONENT_STONES) * N + idx] = 1;
+      (ours ? dist_ours : dist_opponent)[idx] = 0;
+
+      float h = exp( (info.last_placed - _board->_ply) / 10.0 );
+      data[(ours ? OUR_HISTORY : OPPONENT_HISTORY) * N + idx] = (unsigned char)lround(h * U8_HISTORY_SCALE);
+    }
+  }
+
+  DistanceTransform(dist_ours);
+  DistanceTransform(dist_opponent);
+  for (int k = 0; k < N; ++k) {
+    data[OUR_CLOSEST_COLOR * N + k] = (unsigned char)min(dist_ours[k], (float)U8_MAX_DISTANCE);
+    data[OPPONENT_CLOSEST_COLOR * N + k] = (unsigned char)min(dist_opponent[k], (float)U8_MAX_DISTANCE);
+  }
+}
+
+}  // namespace GO_NS
@@ -10,6 +10,8 @@
 
 #include "board.h"
 #include <vector>
+
+namespace GO_NS {
 #define MAX_NUM_FEATURE 25
 
 #define OUR_LIB          0
@@ -27,26 +29,38 @@
 #define OUR_CLOSEST_COLOR    14
 #define OPPONENT_CLOSEST_COLOR   15
 
+// ExtractU8 stores the history planes as round(value * 255), and the closest color planes as distances
+// saturated at 255 (which only happens without any stone of that color, where Extract gives 10000).
+// All other planes are binary.
+#define U8_HISTORY_SCALE 255
+#define U8_MAX_DISTANCE  255
+
 class BoardFeature {
 public:
     enum Rot { NONE = 0, CCW90, CCW180, CCW270 };
 
-    BoardFeature(const Board &b, Rot rot, bool flip) : _board(&b), _rot(rot), _flip(flip) { }
-    BoardFeature(const Board &b) : _board(&b), _rot(NONE), _flip(false) { }
-    void SetD4Group(Rot new_rot, bool new_flip) { _rot = new_rot; _flip = new_flip; }
+    BoardFeature(const Board &b, Rot rot, bool flip) : _board(&b) { SetD4Group(rot, flip); }
+    BoardFeature(const Board &b) : BoardFeature(b, NONE, false) { }
+    void SetD4Group(Rot new_rot, bool new_flip) {
+        _rot = new_rot;
+        _flip = new_flip;
+        _index = D4Index(_rot, _flip);
+    }
 
-    std::pair<int, int> Transform(const std::pair<int, int> &p) const {
+    static std::pair<int, int> Transform(const std::pair<int, int> &p, Rot rot, bool flip) {
         std::pair<int, int> output;
 
-        if (_rot == CCW90) output = std::make_pair(p.second, BOARD_SIZE - p.first - 1);
-        else if (_rot == CCW180) output = std::make_pair(BOARD_SIZE - p.first - 1, BOARD_SIZE - p.second - 1);
-        else if (_rot == CCW270) output = std::make_pair(BOARD_SIZE - p.second - 1, p.first);
+        if (rot == CCW90) output = std::make_pair(p.second, BOARD_SIZE - p.first - 1);
+        else if (rot == CCW180) output = std::make_pair(BOARD_SIZE - p.first - 1, BOARD_SIZE - p.second - 1);
+        else if (rot == CCW270) output = std::make_pair(BOARD_SIZE - p.second - 1, p.first);
         else output = p;
 
-        if (_flip) std::swap(output.first, output.second);
+        if (flip) std::swap(output.first, output.second);
         return output;
     }
 
+    std::pair<int, int> Transform(const std::pair<int, int> &p) const { return Transform(p, _rot, _flip); }
+
     std::pair<int, int> InvTransform(const std::pair<int, int> &p) const {
         std::pair<int, int> output(p);
 
@@ -60,6 +74,7 @@ public:
     }
 
     int64_t Coord2Action(Coord m) const {
+        if (m < BOUND_COORD) return _index[m];
         auto p = Transform(std::make_pair(X(m), Y(m)));
         return EXPORT_OFFSET_XY(p.first, p.second);
     }
@@ -71,23 +86,28 @@ public:
     }
 
     void Extract(std::vector<float> *features) const;
+    // The same planes as uint8, 4x less to copy and send. See U8_HISTORY_SCALE for the non-binary planes.
+    void ExtractU8(std::vector<unsigned char> *features) const;
 
 private:
     const Board *_board;
     Rot _rot;
     bool _flip;
+    // Coord -> transformed export offset, one table per D4 symmetry (precomputed Transform).
+    const short *_index;
+
+    static const short *D4Index(Rot rot, bool flip);
 
     int transform(int x, int y) const {
-        auto p = Transform(std::make_pair(x, y));
-        return EXPORT_OFFSET_XY(p.first, p.second);
+        return _index[OFFSETXY(x, y)];
     }
 
     int transform(Coord m) const {
-        return transform(X(m), Y(m));
+        return _index[m];
     }
 
     int transform(Coord m, int c) const {
-        return transform(X(m), Y(m)) + c * BOARD_SIZE * BOARD_SIZE;
+        return _index[m] + c * BOARD_SIZE * BOARD_SIZE;
     }
 
     // Compute features.
@@ -100,3 +120,5 @@ private:
     bool GetHistoryExp(Stone player, float *data) const;
     bool GetDistanceMap(Stone player, float *data) const;
 };
+
+}  // namespace GO_NS
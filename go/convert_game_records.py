@@ -0,0 +1,19 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# File: convert_game_records.py
+
+# Parse a list of sgf files (or a tar of them) once into a .gorec file, which can then be given
+# to --list_file for offline training.
+
+import argparse
+import go_game as go
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument("list_file", help="text file with one sgf per line, or a .tar of sgf files")
+    parser.add_argument("output", help="output game record file, ending with .gorec")
+    args = parser.parse_args()
+
+    if not args.output.endswith(".gorec"):
+        parser.error("the output file has to end with .gorec")
+    go.ConvertGameRecords(args.list_file, args.output)
@@ -1,5 +1,6 @@
 from rlpytorch import Model, ActorCritic
 from multiple_prediction import MultiplePrediction
+from features import expand_uint8_features
 
 import torch
 import torch.nn as nn
@@ -46,7 +47,7 @@ class Model_Policy(Model):
         ]
 
     def forward(self, x):
-        s = self._var(x["s"])
+        s = self._var(x["s"]) if "s" in x else self._var(expand_uint8_features(x["s_u8"]))
 
         for conv, conv_bn in zip(self.convs, self.convs_bn):
             s = conv_bn(self.relu(conv(s)))
@@ -1,5 +1,6 @@
 from rlpytorch import Model, ActorCritic
 from multiple_prediction import MultiplePrediction
+from features import expand_uint8_features
 
 import torch
 import torch.nn as nn
@@ -71,7 +72,7 @@ class Model_PolicyValue(Model):
         ]
 
     def forward(self, x):
-        s = self._var(x["s"])
+        s = self._var(x["s"]) if "s" in x else self._var(expand_uint8_features(x["s_u8"]))
 
         s = self.init_conv(s)
         for conv_lower, conv_upper in self.convs:
@@ -0,0 +1,17 @@
+import torch
+
+# Planes of BoardFeature (board_feature.h) that ExtractU8 does not store as 0/1.
+HISTORY_PLANES = (10, 11)
+CLOSEST_COLOR_PLANES = (14, 15)
+U8_HISTORY_SCALE = 255.0
+U8_MAX_DISTANCE = 255
+
+def expand_uint8_features(s_u8):
+    ''' Turn a batch of uint8 planes (s_u8, from --uint8_features) into the float planes that s would have had.
+    The history planes are quantized to 1/255. '''
+    s = s_u8.float()
+    history = s[:, HISTORY_PLANES[0]:HISTORY_PLANES[1] + 1] / U8_HISTORY_SCALE
+    closest = s[:, CLOSEST_COLOR_PLANES[0]:CLOSEST_COLOR_PLANES[1] + 1]
+    # A saturated distance means there is no stone of that color, for which Extract gives 10000.
+    closest = closest.masked_fill(s_u8[:, CLOSEST_COLOR_PLANES[0]:CLOSEST_COLOR_PLANES[1] + 1] == U8_MAX_DISTANCE, 10000.0)
+    return torch.cat([s[:, :HISTORY_PLANES[0]], history, s[:, HISTORY_PLANES[1] + 1:CLOSEST_COLOR_PLANES[0]], closest, s[:, CLOSEST_COLOR_PLANES[1] + 1:]], 1)
@@ -14,11 +14,15 @@
 #include "mcts.h"
 #include "elf/tar_loader.h"
 
+#include <cmath>
 #include <fstream>
 
+namespace GO_NS {
+
 ////////////////// GoGame /////////////////////
-GoGame::GoGame(int game_idx, const ContextOptions &context_options, const GameOptions& options)
-  : _options(options), _context_options(context_options), _curr_loader_idx(0) {
+GoGame::GoGame(int game_idx, const ContextOptions &context_options, const GameOptions& options,
+               SelfPlayRecorder *recorder, ResignStats *resign_stats)
+  : _options(options), _context_options(context_options), _curr_loader_idx(0), _recorder(recorder), _resign_stats(resign_stats) {
     _game_idx = game_idx;
     if (options.seed == 0) {
         auto now = chrono::system_clock::now();
@@ -36,15 +40,19 @@ GoGame::GoGame(int game_idx, const ContextOptions &context_options, const GameOp
 void GoGame::Init(AIComm *ai_comm) {
     assert(ai_comm);
     if (_options.mode == "online" || _options.mode == "selfplay") {
+        _state.SetSuperko(_options.superko);
         if (_options.use_mcts) {
             auto *ai = new MCTSGoAI(ai_comm, _context_options.mcts_options);
             _ai.reset(ai);
+            _mcts_ai = ai;
         } else {
             auto *ai = new DirectPredictAI();
             ai->InitAIComm(ai_comm);
             ai->SetActorName("actor");
             _ai.reset(ai);
+            _direct_ai = ai;
         }
+        start_game();
     } else {
         // Open many offline instances.
         for (int i = 0; i < _options.num_games_per_thread; ++i) {
@@ -77,19 +85,18 @@ void GoGame::Act(const elf::Signal &signal) {
             } while(! signal.PrepareStop());
         }
 
+        Stone player = _state.NextPlayer();
         _ai->Act(_state, &c, &signal.done());
-        if (! _state.forward(c)) {
+        if (should_resign(player)) {
+            end_game(player);
+        } else if (! _state.forward(c)) {
             cout << _state.ShowBoard() << endl;
             cout << "No valid move [" << c << "][" << coord2str(c) << "][" << coord2str2(c) << "], restarting the game" << endl;
-            _state.Reset();
-
-            if (_tar_writer != nullptr) {
-              _tar_writer->Write(std::to_string(_game_idx), coords2sgfstr(_moves));
-            }
-            _moves.clear();
-            _game_idx++;
+            end_game(S_EMPTY, true);
         } else {
-          _moves.push_back(c);
+            record_move(player, c);
+            // Two passes.
+            if (_options.mode == "selfplay" && IsGameEnd(&_state.board())) end_game();
         }
     } else {
         // Replays hold a state by itself.
@@ -98,3 +105,88 @@ void GoGame::Act(const elf::Signal &signal) {
         loader->Act(&c, &signal.done());
     }
 }
+
+float GoGame::last_value(Stone player) const {
+    float value = 0.0;
+    if (_mcts_ai != nullptr) value = _mcts_ai->get()->last_result().value;
+    else if (_direct_ai != nullptr) value = _direct_ai->get_last_value();
+    // Like the winner label, the value is +1 for a black win.
+    return player == S_BLACK ? value : -value;
+}
+
+bool GoGame::resign_enabled() const {
+    return _options.mode == "selfplay" && _options.resign_threshold > -1.0;
+}
+
+bool GoGame::should_resign(Stone player) {
+    if (! resign_enabled()) return false;
+    if (last_value(player) >= _options.resign_threshold) return false;
+    if (! _calibration_game) return true;
+    if (_would_resign == S_EMPTY) _would_resign = player;
+    return false;
+}
+
+void GoGame::record_move(Stone player, Coord c) {
+    if (_recorder == nullptr) return;
+    vector<pair<Coord, float>> pi;
+    if (_mcts_ai != nullptr) pi = _mcts_ai->get()->last_result().pi;
+    else if (_direct_ai != nullptr) _direct_ai->get_last_policy(&pi);
+    // Back to the sign of the network.
+    float value = last_value(S_BLACK);
+    _record.AddMove(player, c, pi, value);
+}
+
+void GoGame::start_game() {
+    // Without resignation, there is nothing to calibrate.
+    std::uniform_real_distribution<float> dist(0.0, 1.0);
+    _calibration_game = resign_enabled() && dist(_rng) < _options.resign_calibration;
+    _would_resign = S_EMPTY;
+}
+
+void GoGame::end_game(Stone resigned, bool aborted) {
+    if (aborted) {
+        // The board is not finished, so its score is neither a result to train on nor to judge
+        // resignations by.
+        reset_game();
+        return;
+    }
+
+    Stone winner = S_OFF_BOARD;
+    float win_margin = 0.0;
+    if (resigned != S_EMPTY) {
+        winner = OPPONENT(resigned);
+    } else {
+        float score = GetTrompTaylorScore(&_state.board(), NULL, NULL) - _options.komi;
+        winner = score > 0 ? S_BLACK : (score < 0 ? S_WHITE : S_OFF_BOARD);
+        win_margin = fabs(score);
+    }
+
+    if (_resign_stats != nullptr && _options.mode == "selfplay") {
+        _resign_stats->games ++;
+        if (resigned != S_EMPTY) _resign_stats->resigned ++;
+        if (_calibration_game) {
+            _resign_stats->calibration_games ++;
+            if (_would_resign != S_EMPTY) {
+                _resign_stats->would_resign ++;
+                if (winner == _would_resign) _resign_stats->false_positives ++;
+            }
+        }
+    }
+
+    if (_recorder != nullptr && _record.NumMoves() > 0) {
+        if (! _recorder->Record(_record, winner, win_margin, 0) && _options.verbose) {
+            cout << "[" << _game_idx << "] Recorder queue is full, game dropped" << endl;
+        }
+    }
+    reset_game();
+}
+
+void GoGame::reset_game() {
+    _record.Clear();
+    _state.Reset();
+    _ai->GameEnd();
+    _game_idx++;
+    start_game();
+}
+
+}  // namespace GO_NS
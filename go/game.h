@@ -12,13 +12,42 @@
 #include "elf/pybind_helper.h"
 #include "elf/comm_template.h"
 #include "elf/ai_comm.h"
+#include "elf/shard_writer.h"
 
 #include "ai.h"
 #include "go_game_specific.h"
 #include "go_state.h"
+#include "go_ai.h"
+#include "mcts.h"
 #include "offpolicy_loader.h"
+#include "selfplay_recorder.h"
+#include <atomic>
 #include <random>
 #include <map>
+#include <sstream>
+
+namespace GO_NS {
+
+// Resignations of the self-play games, shared by all games.
+struct ResignStats {
+    std::atomic<int64_t> games{0};
+    std::atomic<int64_t> resigned{0};
+    // Calibration games, in which nobody resigns.
+    std::atomic<int64_t> calibration_games{0};
+    // Calibration games in which a player would have resigned, and those where that player won.
+    std::atomic<int64_t> would_resign{0};
+    std::atomic<int64_t> false_positives{0};
+
+    float false_positive_rate() const { return would_resign > 0 ? (float)false_positives / would_resign : 0.0; }
+
+    std::string info() const {
+        std::stringstream ss;
+        ss << "Resign: " << resigned << "/" << games << " games resigned, calibration: " << calibration_games
+           << " games, " << would_resign << " would resign, false positive rate: " << false_positive_rate()
+           << " (" << false_positives << "/" << would_resign << ")";
+        return ss.str();
+    }
+};
 
 // Game interface for Go.
 class GoGame {
@@ -34,15 +63,37 @@ private:
 
     std::unique_ptr<AI> _ai;
     std::unique_ptr<AI> _human_player;
+    // The concrete type of _ai, for the search policy of recorded games.
+    MCTSGoAI *_mcts_ai = nullptr;
+    DirectPredictAI *_direct_ai = nullptr;
 
     // Only used when we want to run online
     GoState _state;
 
-    std::vector<Coord> _moves;
-    std::unique_ptr<elf::tar::TarWriter> _tar_writer;
+    // Shared by all games, owned by the GameContext. nullptr if games are not recorded.
+    SelfPlayRecorder *_recorder;
+    SelfPlayGame _record;
+
+    // Shared by all games, owned by the GameContext.
+    ResignStats *_resign_stats;
+    // Whether nobody resigns in this game, and who would have resigned first (S_EMPTY if nobody).
+    bool _calibration_game = false;
+    Stone _would_resign = S_EMPTY;
+
+    // Value of the last move's position for the player who moved, from the network or the search.
+    float last_value(Stone player) const;
+    bool resign_enabled() const;
+    bool should_resign(Stone player);
+    void record_move(Stone player, Coord c);
+    // resigned is the player who resigned, or S_EMPTY if the game is scored. An aborted game (e.g., by
+    // an invalid move) is neither recorded nor counted in the resign stats.
+    void end_game(Stone resigned = S_EMPTY, bool aborted = false);
+    void reset_game();
+    void start_game();
 
 public:
-    GoGame(int game_idx, const ContextOptions &context_options, const GameOptions& options);
+    GoGame(int game_idx, const ContextOptions &context_options, const GameOptions& options,
+           SelfPlayRecorder *recorder = nullptr, ResignStats *resign_stats = nullptr);
 
     void Init(AIComm *ai_comm);
 
@@ -55,4 +106,7 @@ public:
 
     void Act(const elf::Signal &signal);
     string ShowBoard() const { return _state.ShowBoard(); }
+    mcts::TTStats GetTTStats() const { return _mcts_ai != nullptr ? _mcts_ai->get()->GetTTStats() : mcts::TTStats(); }
 };
+
+}  // namespace GO_NS
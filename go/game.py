@@ -32,6 +32,20 @@ class Loader:
                 ("move_cutoff", dict(type=int, default=-1, help="Cutoff ply in replay")),
                 ("mode", "online"),
                 ("use_mcts", dict(action="store_true")),
+                ("board_size", dict(type=int, default=19, choices=[9, 13, 19])),
+                ("superko", dict(action="store_true", help="forbid moves that repeat an earlier position (positional superko)")),
+                ("replay_buffer_size", dict(type=int, default=100000, help="max number of loaded games kept in memory (0 is no bound)")),
+                ("replay_buffer_mb", dict(type=int, default=0, help="max memory of the loaded games in MB (0 is no bound, or 2048 with --sample_positions)")),
+                ("num_prefetch_threads", dict(type=int, default=0, help="threads that load the next games in the background")),
+                ("sample_positions", dict(action="store_true", help="offline: every sample is a new random position (uniform over positions with a .gorec list file)")),
+                ("checkpoint_interval", dict(type=int, default=16, help="with --sample_positions, keep a board every this many moves")),
+                ("uint8_features", dict(action="store_true", help="send the board features as uint8 planes (s_u8) instead of float (s)")),
+                ("record_prefix", dict(type=str, default="", help="selfplay: write finished games to <record_prefix>-*.gz shards")),
+                ("record_shard_mb", dict(type=int, default=64, help="start a new record shard every this many MB")),
+                ("record_queue_mb", dict(type=int, default=256, help="drop finished games when this many MB wait to be written")),
+                ("komi", dict(type=float, default=7.5, help="komi for the Tromp-Taylor result of self-play games")),
+                ("resign_threshold", dict(type=float, default=-1.0, help="selfplay: resign when the value for the player to move is below this (-1 is never)")),
+                ("resign_calibration", dict(type=float, default=0.1, help="fraction of self-play games without resignation, to measure false resignations")),
                 ("gpu", dict(type=int, default=None))
             ],
             more_args = ["batchsize", "T"],
@@ -49,30 +63,44 @@ class Loader:
         opt.list_filename = args.list_file
         opt.mode = args.mode
         opt.use_mcts = args.use_mcts
+        opt.superko = args.superko
+        opt.uint8_features = args.uint8_features
         opt.verbose = args.verbose
         opt.data_aug = args.data_aug
         opt.ratio_pre_moves = args.ratio_pre_moves
         opt.start_ratio_pre_moves = args.start_ratio_pre_moves
         opt.move_cutoff = args.move_cutoff
         opt.num_games_per_thread = args.num_games_per_thread
-        GC = go.GameContext(co, opt)
+        opt.replay_buffer_size = args.replay_buffer_size
+        opt.replay_buffer_mb = args.replay_buffer_mb
+        opt.num_prefetch_threads = args.num_prefetch_threads
+        opt.sample_positions = args.sample_positions
+        opt.checkpoint_interval = args.checkpoint_interval
+        opt.record_prefix = args.record_prefix
+        opt.record_shard_mb = args.record_shard_mb
+        opt.record_queue_mb = args.record_queue_mb
+        opt.komi = args.komi
+        opt.resign_threshold = args.resign_threshold
+        opt.resign_calibration = args.resign_calibration
+        GC = getattr(go, "GameContext%d" % args.board_size)(co, opt)
         print("Version: ", GC.Version())
 
         params = GC.GetParams()
         print("Num Actions: ", params["num_action"])
 
+        s = "s_u8" if args.uint8_features else "s"
         desc = {}
         if args.mode == "online":
             desc["human_actor"] = dict(
                 batchsize=args.batchsize,
-                input=dict(T=1, keys=set(["s"])),
+                input=dict(T=1, keys=set([s])),
                 reply=dict(T=1, keys=set(["pi", "a"])),
                 name="human_actor",
             )
             # Used for MCTS/Direct play.
             desc["actor"] = dict(
                 batchsize=args.batchsize,
-                input=dict(T=1, keys=set(["s"])),
+                input=dict(T=1, keys=set([s])),
                 reply=dict(T=1, keys=set(["pi", "V", "a"])),
                 name="actor",
             )
@@ -80,7 +108,7 @@ class Loader:
             # Used for MCTS/Direct play.
             desc["actor"] = dict(
                 batchsize=args.batchsize,
-                input=dict(T=1, keys=set(["s"])),
+                input=dict(T=1, keys=set([s])),
                 reply=dict(T=1, keys=set(["pi", "V"])),
                 name="actor",
                 timeout_usec = 10,
@@ -88,7 +116,7 @@ class Loader:
         else:
             desc["train"] = dict(
                 batchsize=args.batchsize,
-                input=dict(T=args.T, keys=set(["s", "offline_a"])),
+                input=dict(T=args.T, keys=set([s, "offline_a"])),
                 reply=None
             )
 
@@ -126,7 +154,8 @@ if __name__ == '__main__':
     def train(batch):
         # Collect statistics.
         b = batch.hist(0)
-        for game_idx, move_idx, s in zip(b["game_record_idx"], b["move_idx"], b["s"]):
+        features = b["s_u8"].float() if args.uint8_features else b["s"]
+        for game_idx, move_idx, s in zip(b["game_record_idx"], b["move_idx"], features):
             bin_idx =  move_idx // 10
             if bin_idx >= nbin: continue
             game_records_visited[game_idx] += 1
@@ -0,0 +1,30 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <pybind11/stl.h>
+
+#include "game_context.h"
+
+namespace GO_NS {
+
+void RegisterGameContext(py::module &m, const char *name) {
+  CONTEXT_REGISTER_AS(GameContext, name)
+      .def("GetParams", &GameContext::GetParams)
+      .def("ShowBoard", &GameContext::ShowBoard)
+      .def("GetRecorderStats", &GameContext::GetRecorderStats)
+      .def("GetResignStats", &GameContext::GetResignStats)
+      .def("GetTTStats", &GameContext::GetTTStats);
+      //.def("ApplyHandicap", &GameContext::ApplyHandicap)
+      //.def("UndoMove", &GameContext::UndoMove);
+}
+
+void RegisterGameRecordConverter(py::module &m) {
+  m.def("ConvertGameRecords", &OfflineLoader::ConvertGameRecords);
+}
+
+}  // namespace GO_NS
@@ -19,11 +19,16 @@
 #include "offpolicy_loader.h"
 #include "board_feature.h"
 
+namespace GO_NS {
+
 class GameContext {
   public:
     using GC = Context;
 
   private:
+    // Declared before _context, so that it is destroyed (and written out) after the game threads stop.
+    std::unique_ptr<SelfPlayRecorder> _recorder;
+    ResignStats _resign_stats;
     std::unique_ptr<GC> _context;
     std::vector<std::unique_ptr<GoGame>> _games;
     const int _num_action = BOARD_SIZE * BOARD_SIZE;
@@ -31,20 +36,21 @@ class GameContext {
   public:
     GameContext(const ContextOptions& context_options, const GameOptions& options) {
       _context.reset(new GC{context_options, options});
+      if (options.mode == "selfplay" && ! options.record_prefix.empty()) _recorder.reset(new SelfPlayRecorder(options));
       for (int i = 0; i < context_options.num_games; ++i) {
-          _games.emplace_back(new GoGame(i, context_options, options));
+          _games.emplace_back(new GoGame(i, context_options, options, _recorder.get(), &_resign_stats));
       }
-      if (! options.list_filename.empty()) OfflineLoader::InitSharedBuffer(options.list_filename);
+      if (! options.list_filename.empty()) OfflineLoader::InitSharedBuffer(options);
     }
 
     void Start() {
-        auto f = [this](int game_idx, const ContextOptions &context_options, const GameOptions&,
+        auto f = [this](int game_idx, const ContextOptions &context_options, const GameOptions& options,
                 const elf::Signal& signal, GC::Comm* comm) {
             GC::AIComm ai_comm(game_idx, comm);
             auto &state = ai_comm.info().data;
             state.InitHist(context_options.T);
             for (auto &s : state.v()) {
-                s.Init(game_idx, _num_action);
+                s.Init(game_idx, _num_action, options.uint8_features);
             }
             auto* game = _games[game_idx].get();
             game->Init(&ai_comm);
@@ -70,7 +76,7 @@ class GameContext {
 
         std::string type_name = mm->type();
 
-        if (key == "s") return EntryInfo(key, type_name, {MAX_NUM_FEATURE, BOARD_SIZE, BOARD_SIZE});
+        if (key == "s" || key == "s_u8") return EntryInfo(key, type_name, {MAX_NUM_FEATURE, BOARD_SIZE, BOARD_SIZE});
         else if (key == "offline_a") return EntryInfo(key, type_name, {_context->options().num_future_actions});
         else if (key == "last_terminal" || key == "id" || key == "seq" || key == "game_counter") return EntryInfo(key, type_name);
         else if (key == "move_idx") return EntryInfo(key, type_name);
@@ -86,6 +92,19 @@ class GameContext {
         return game_idx < 0 || game_idx >= (int)_games.size();
     }
 
+    std::string GetRecorderStats() const {
+        return _recorder != nullptr ? _recorder->GetStats().info() : std::string();
+    }
+
+    std::string GetResignStats() const { return _resign_stats.info(); }
+
+    // Transposition tables of all the games.
+    std::string GetTTStats() const {
+        mcts::TTStats stats;
+        for (const auto &game : _games) stats += game->GetTTStats();
+        return stats.info();
+    }
+
     std::string ShowBoard(int game_idx) const {
         if (_check_game_idx(game_idx)) return "Invalid game_idx [" + std::to_string(game_idx) + "]";
         return _games[game_idx]->ShowBoard();
@@ -108,5 +127,14 @@ class GameContext {
     void Stop() {
       _context.reset(nullptr);
       // [TODO] there may be issues when deleting shared_buffer.
+      // Write out the queued games.
+      _recorder.reset(nullptr);
     }
 };
+
+// Register GameContext of this board size to the python module.
+void RegisterGameContext(py::module &m, const char *name);
+// ConvertGameRecords(list_filename, record_filename), see OfflineLoader.
+void RegisterGameRecordConverter(py::module &m);
+
+}  // namespace GO_NS
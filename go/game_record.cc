@@ -0,0 +1,219 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+// go_state.h first: it pulls in elf headers, which cannot follow board.h and its short macros (T(c), ...).
+#include "go_state.h"
+#include "game_record.h"
+
+namespace GO_NS {
+
+///////////// GameRecord ////////////////////
+GameRecord::GameRecord(const Sgf &sgf) {
+    memset(&_header, 0, sizeof(_header));
+    _header.board_size = sgf.GetBoardSize();
+    _header.winner = sgf.GetWinner();
+    _header.handicap = sgf.GetHandicapStones();
+    _header.komi = sgf.GetKomi();
+    _header.win_margin = sgf.GetWinMargin();
+
+    // Like Sgf::NumMoves(), stop at the first pass. Nodes without a move (e.g., setup or comments
+    // only) are skipped, and a move off the board ends the game.
+    for (auto it = sgf.begin(); ! it.done(); ++it) {
+        SgfMove m = it.GetCurrMove();
+        if (m.player != S_BLACK && m.player != S_WHITE) continue;
+        if (m.move == M_PASS || m.move >= BOUND_COORD) break;
+        int x = X(m.move), y = Y(m.move);
+        if (x < 0 || x >= _header.board_size || y < 0 || y >= _header.board_size) break;
+        _owned.push_back(EncodeMove(m));
+    }
+    _header.num_moves = _owned.size();
+}
+
+uint16_t GameRecord::EncodeMove(const SgfMove &m) {
+    uint16_t code = (m.move == M_PASS ? GAME_RECORD_PASS : (Y(m.move) << 5 | X(m.move)));
+    return m.player == S_WHITE ? (code | GAME_RECORD_WHITE) : code;
+}
+
+void GameRecord::BuildCheckpoints(int interval) {
+    _checkpoint_interval = interval;
+    _checkpoints.clear();
+    if (interval <= 0) return;
+
+    GoState s;
+    s.ApplyHandicap(GetHandicapStones());
+    for (int i = 0; i < NumMoves(); ++i) {
+        if (i % interval == 0) _checkpoints.push_back(s.board());
+        if (! s.forward(GetMove(i).move)) break;
+    }
+    _checkpoints.shrink_to_fit();
+}
+
+const Board *GameRecord::GetCheckpoint(int move_idx, int *checkpoint_idx) const {
+    if (_checkpoints.empty() || move_idx < 0) return nullptr;
+    int i = std::min(move_idx / _checkpoint_interval, (int)_checkpoints.size() - 1);
+    *checkpoint_idx = i * _checkpoint_interval;
+    return &_checkpoints[i];
+}
+
+///////////// GameRecordFile ////////////////////
+bool GameRecordFile::IsGameRecordFile(const std::string &filename) {
+    return filename.substr(filename.find_last_of(".") + 1) == "gorec";
+}
+
+static void check_record_file(bool ok, const std::string &filename, const std::string &what) {
+    if (ok) return;
+    std::cout << "GameRecordFile: " << filename << ": " << what << std::endl;
+    throw std::range_error("GameRecordFile: " + filename + ": " + what);
+}
+
+GameRecordFile::GameRecordFile(const std::string &filename) {
+    try {
+        open_file(filename);
+    } catch (...) {
+        close_file();
+        throw;
+    }
+}
+
+void GameRecordFile::open_file(const std::string &filename) {
+    _fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    check_record_file(_fd >= 0 && ::fstat(_fd, &st) == 0, filename, strerror(errno));
+    _size = st.st_size;
+    check_record_file(_size >= sizeof(GameRecordFileHeader), filename, "too short");
+
+    void *p = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+    check_record_file(p != MAP_FAILED, filename, strerror(errno));
+    _data = static_cast<const char *>(p);
+
+    const GameRecordFileHeader *h = reinterpret_cast<const GameRecordFileHeader *>(_data);
+    check_record_file(memcmp(h->magic, GAME_RECORD_MAGIC, 8) == 0, filename, "not a game record file");
+    check_record_file(h->version == GAME_RECORD_VERSION, filename, "unknown version " + std::to_string(h->version));
+    _num_games = h->num_games;
+    // The offsets come from the file: compare them before any arithmetic on them, which could wrap around.
+    check_record_file(h->index_offset <= h->names_offset && h->names_offset <= _size &&
+            h->index_offset % sizeof(uint64_t) == 0 &&
+            _num_games <= (h->names_offset - h->index_offset) / sizeof(uint64_t),
+            filename, "corrupted index");
+    _offsets = reinterpret_cast<const uint64_t *>(_data + h->index_offset);
+
+    // Get() reads the records in place, so they all have to be in the file.
+    for (size_t i = 0; i < _num_games; ++i) {
+        const uint64_t offset = _offsets[i];
+        bool ok = offset >= sizeof(GameRecordFileHeader) && offset % 4 == 0 && offset <= _size - sizeof(GameRecordHeader);
+        if (ok) {
+            const GameRecordHeader *record = reinterpret_cast<const GameRecordHeader *>(_data + offset);
+            ok = record->num_moves <= (_size - offset - sizeof(GameRecordHeader)) / sizeof(uint16_t);
+        }
+        check_record_file(ok, filename, "corrupted record " + std::to_string(i));
+    }
+
+    const char *name = _data + h->names_offset;
+    const char *end = _data + _size;
+    _names.reserve(_num_games);
+    for (size_t i = 0; i < _num_games; ++i) {
+        size_t len = strnlen(name, end - name);
+        check_record_file(name + len < end, filename, "corrupted names");
+        _names.emplace_back(name, len);
+        _index[_names.back()] = i;
+        name += len + 1;
+    }
+    ::madvise(const_cast<char *>(_data), _size, MADV_RANDOM);
+}
+
+void GameRecordFile::close_file() {
+    if (_data != nullptr) ::munmap(const_cast<char *>(_data), _size);
+    if (_fd >= 0) ::close(_fd);
+    _data = nullptr;
+    _fd = -1;
+}
+
+GameRecordFile::~GameRecordFile() {
+    close_file();
+}
+
+int GameRecordFile::Find(const std::string &name) const {
+    auto it = _index.find(name);
+    return it == _index.end() ? -1 : it->second;
+}
+
+GameRecord GameRecordFile::Get(size_t i) const {
+    const char *p = _data + _offsets[i];
+    const GameRecordHeader *h = reinterpret_cast<const GameRecordHeader *>(p);
+    return GameRecord(*h, reinterpret_cast<const uint16_t *>(p + sizeof(GameRecordHeader)));
+}
+
+///////////// PositionIndex ////////////////////
+PositionIndex::PositionIndex(const GameRecordFile &file, std::function<int (const GameRecord &)> num_positions) {
+    _cumsum.resize(file.size());
+    uint64_t total = 0;
+    for (size_t i = 0; i < file.size(); ++i) {
+        total += std::max(num_positions(file.Get(i)), 0);
+        _cumsum[i] = total;
+    }
+}
+
+int PositionIndex::GetGame(uint64_t r) const {
+    return std::upper_bound(_cumsum.begin(), _cumsum.end(), r) - _cumsum.begin();
+}
+
+bool GameRecordFile::Write(const std::string &filename, const std::vector<std::string> &names, const std::vector<GameRecord> &records) {
+    if (names.size() != records.size()) {
+        std::cout << "GameRecordFile: " << names.size() << " names for " << records.size() << " records" << std::endl;
+        return false;
+    }
+    std::ofstream oFile(filename, std::ios::binary);
+    if (! oFile.is_open()) return false;
+
+    GameRecordFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, GAME_RECORD_MAGIC, 8);
+    h.version = GAME_RECORD_VERSION;
+    h.num_games = records.size();
+    oFile.write(reinterpret_cast<const char *>(&h), sizeof(h));
+
+    std::vector<uint64_t> offsets;
+    uint64_t pos = sizeof(h);
+    const char padding[8] = { 0 };
+    for (const GameRecord &record : records) {
+        offsets.push_back(pos);
+        oFile.write(reinterpret_cast<const char *>(&record.header()), sizeof(GameRecordHeader));
+        size_t bytes = record.NumMoves() * sizeof(uint16_t);
+        oFile.write(reinterpret_cast<const char *>(record.moves()), bytes);
+        // Keep the next header aligned.
+        size_t pad = (4 - bytes % 4) % 4;
+        oFile.write(padding, pad);
+        pos += sizeof(GameRecordHeader) + bytes + pad;
+    }
+
+    // The offsets are read in place.
+    size_t pad = (8 - pos % 8) % 8;
+    oFile.write(padding, pad);
+    pos += pad;
+
+    h.index_offset = pos;
+    oFile.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    h.names_offset = pos + offsets.size() * sizeof(uint64_t);
+    for (const std::string &name : names) oFile.write(name.c_str(), name.size() + 1);
+
+    oFile.seekp(0);
+    oFile.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    return oFile.good();
+}
+
+}  // namespace GO_NS
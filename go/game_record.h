@@ -0,0 +1,193 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sgf.h"
+
+namespace GO_NS {
+
+// Preparsed game records, for offline training without SGF parsing.
+//
+// File layout (native byte order, see GameRecordFile::Write):
+//   GameRecordFileHeader
+//   for each game: GameRecordHeader, then num_moves uint16 moves, padded to 4 bytes
+//   uint64 offset of each game
+//   the name of each game, NUL-terminated
+//
+// A move is (y << 5 | x), GAME_RECORD_PASS for a pass, with GAME_RECORD_WHITE set for white.
+// This does not depend on BOARD_SIZE, so one file serves every board size.
+#define GAME_RECORD_MAGIC "ELFGOREC"
+#define GAME_RECORD_VERSION 1
+#define GAME_RECORD_PASS 0x7fff
+#define GAME_RECORD_WHITE 0x8000
+
+struct GameRecordFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_games;
+    uint64_t index_offset;
+    uint64_t names_offset;
+};
+
+struct GameRecordHeader {
+    uint8_t board_size;
+    // S_BLACK, S_WHITE, or S_OFF_BOARD if unknown.
+    Stone winner;
+    uint8_t handicap;
+    uint8_t reserved;
+    float komi;
+    float win_margin;
+    // Moves of the main variation, up to the first pass.
+    uint32_t num_moves;
+};
+
+// One game: a header and a move array. Either a view into a GameRecordFile, or owning its moves
+// (converted from an Sgf). Has the same iterator interface as Sgf, for OfflineLoader.
+class GameRecord {
+public:
+    class iterator {
+      public:
+          iterator() : _record(nullptr), _move_idx(-1) { }
+          iterator(const GameRecord &record) : _record(&record), _move_idx(0) { }
+
+          SgfMove GetCurrMove() const { return done() ? SgfMove() : _record->GetMove(_move_idx); }
+          Coord GetCoord() const { return done() ? M_PASS : _record->GetMove(_move_idx).move; }
+
+          bool done() const { return _record == nullptr || _move_idx >= _record->NumMoves(); }
+
+          iterator &operator ++() {
+              if (! done()) _move_idx ++;
+              return *this;
+          }
+
+          int GetCurrIdx() const { return _move_idx; }
+          void Seek(int move_idx) { _move_idx = move_idx; }
+
+          int StepLeft() const {
+              if (_record == nullptr) return 0;
+              return _record->NumMoves() - _move_idx - 1;
+          }
+
+          const GameRecord &GetRecord() const { return *_record; }
+
+          vector<SgfMove> GetForwardMoves(int k) const {
+              vector<SgfMove> res;
+              for (int i = 0; i < k; ++i) {
+                  res.push_back(_record != nullptr && _move_idx + i < _record->NumMoves() ? _record->GetMove(_move_idx + i) : SgfMove());
+              }
+              return res;
+          }
+
+      private:
+          const GameRecord *_record;
+          int _move_idx;
+    };
+
+    GameRecord(const GameRecordHeader &header, const uint16_t *moves) : _header(header), _moves(moves) { }
+    explicit GameRecord(const Sgf &sgf);
+
+    iterator begin() const { return iterator(*this); }
+
+    Stone GetWinner() const { return _header.winner; }
+    int GetHandicapStones() const { return _header.handicap; }
+    int GetBoardSize() const { return _header.board_size; }
+    float GetKomi() const { return _header.komi; }
+    int NumMoves() const { return _header.num_moves; }
+
+    SgfMove GetMove(int i) const { return DecodeMove(moves()[i]); }
+
+    const GameRecordHeader &header() const { return _header; }
+    const uint16_t *moves() const { return _owned.empty() ? _moves : &_owned[0]; }
+    // Memory held by this record (a view does not own its moves).
+    size_t MemoryBytes() const {
+        return sizeof(*this) + _owned.capacity() * sizeof(uint16_t) + _checkpoints.capacity() * sizeof(Board);
+    }
+
+    // Keep the board before move 0, interval, 2 * interval, ... (only in memory), so that a position can be
+    // reached with at most interval - 1 moves. Stops at the first illegal move.
+    void BuildCheckpoints(int interval);
+    int CheckpointInterval() const { return _checkpoint_interval; }
+    // The last checkpoint at or before move_idx, and its move index. nullptr if there is none.
+    const Board *GetCheckpoint(int move_idx, int *checkpoint_idx) const;
+
+    static uint16_t EncodeMove(const SgfMove &m);
+    static SgfMove DecodeMove(uint16_t m) {
+        Stone player = (m & GAME_RECORD_WHITE) ? S_WHITE : S_BLACK;
+        m &= ~GAME_RECORD_WHITE;
+        if (m == GAME_RECORD_PASS) return SgfMove(player, M_PASS);
+        return SgfMove(player, OFFSETXY(m & 31, m >> 5));
+    }
+
+private:
+    GameRecordHeader _header;
+    const uint16_t *_moves = nullptr;
+    vector<uint16_t> _owned;
+
+    int _checkpoint_interval = 0;
+    vector<Board> _checkpoints;
+};
+
+// A game record file, mmapped. Read-only after construction, so it can be shared by all threads.
+class GameRecordFile {
+public:
+    GameRecordFile(const std::string &filename);
+    GameRecordFile(const GameRecordFile &) = delete;
+    GameRecordFile &operator=(const GameRecordFile &) = delete;
+    ~GameRecordFile();
+
+    static bool IsGameRecordFile(const std::string &filename);
+
+    size_t size() const { return _num_games; }
+    const std::vector<std::string> &List() const { return _names; }
+    // Index of the game, or -1.
+    int Find(const std::string &name) const;
+    GameRecord Get(size_t i) const;
+
+    // Returns false if the file cannot be written.
+    static bool Write(const std::string &filename, const std::vector<std::string> &names, const std::vector<GameRecord> &records);
+
+private:
+    int _fd = -1;
+    const char *_data = nullptr;
+    size_t _size = 0;
+
+    size_t _num_games = 0;
+    const uint64_t *_offsets = nullptr;
+    std::vector<std::string> _names;
+    std::unordered_map<std::string, int> _index;
+
+    // Map the file and check it, throws if it is corrupted.
+    void open_file(const std::string &filename);
+    // Unmap and close the file. The constructor calls it too before it throws.
+    void close_file();
+};
+
+// Samples games of a GameRecordFile in proportion to their number of usable positions, so that
+// (game, position within the game) is uniform over all positions.
+class PositionIndex {
+public:
+    // num_positions gives the number of positions of a game that can be sampled.
+    PositionIndex(const GameRecordFile &file, std::function<int (const GameRecord &)> num_positions);
+
+    uint64_t NumPositions() const { return _cumsum.empty() ? 0 : _cumsum.back(); }
+    // Game of the r-th position, r in [0, NumPositions()).
+    int GetGame(uint64_t r) const;
+
+private:
+    // _cumsum[i] is the number of positions in games [0, i].
+    std::vector<uint64_t> _cumsum;
+};
+
+}  // namespace GO_NS
@@ -13,6 +13,8 @@
 
 using namespace std;
 
+namespace GO_NS {
+
 class DirectPredictAI: public AIWithComm {
 public:
     using Data = AIWithComm::Data;
@@ -67,6 +69,17 @@ public:
         *output_pi = tmp;
     }
 
+    // The whole policy of the last reply (get_last_pi keeps the top valid moves only).
+    void get_last_policy(vector<pair<Coord, float>> *output_pi) const {
+        assert(last_state_ != nullptr);
+        const vector<float> &pi = data().newest().pi;
+        const auto &bf = last_state_->last_extractor();
+        output_pi->clear();
+        for (size_t i = 0; i < pi.size(); ++i) {
+            if (pi[i] > 0) output_pi->push_back(make_pair(bf.Action2Coord(i), pi[i]));
+        }
+    }
+
     float get_last_value() const {
         assert(last_state_ != nullptr);
         return data().newest().V;
@@ -82,7 +95,7 @@ protected:
         gs.move_idx = state.GetPly();
         gs.winner = 0;
         const auto &bf = state.last_extractor();
-        bf.Extract(&gs.s);
+        ExtractFeatures(bf, &gs);
         last_state_ = &state;
     }
 
@@ -109,7 +122,7 @@ protected:
         gs.move_idx = state.GetPly();
         gs.winner = 0;
         const auto &bf = state.last_extractor();
-        bf.Extract(&gs.s);
+        ExtractFeatures(bf, &gs);
     }
 
     bool handle_response(const GoState &s, const Data &data, Coord *c) override {
@@ -118,3 +131,5 @@ protected:
         return true;
     }
 };
+
+}  // namespace GO_NS
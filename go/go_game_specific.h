@@ -33,6 +33,12 @@ struct GameOptions {
     // Use mcts engine.
     bool use_mcts = false;
 
+    // Forbid moves that repeat an earlier position of the game (positional superko) in online/selfplay games.
+    bool superko = false;
+
+    // Send the board features as uint8 planes in s_u8 instead of float planes in s.
+    bool uint8_features = false;
+
     // -1 is random, 0-7 mean specific data aug.
     int data_aug = -1;
 
@@ -51,15 +57,44 @@ struct GameOptions {
 
     // A list file containing the files to load.
     std::string list_filename;
+
+    // Bounds of the cache of loaded games shared by the offline loaders (0 is no bound), and the
+    // number of threads that load the next games in the background (0 is none).
+    int replay_buffer_size = 100000;
+    int replay_buffer_mb = 0;
+    int num_prefetch_threads = 0;
+
+    // Offline: instead of walking through each loaded game, every sample jumps to a new random position.
+    // With a .gorec list file, positions are uniform over all positions (otherwise over games).
+    // Positions are reached from board checkpoints taken every checkpoint_interval moves, which are kept
+    // with the game in the replay buffer. They are large, so replay_buffer_mb = 0 means 2 GB here.
+    bool sample_positions = false;
+    int checkpoint_interval = 16;
+
+    // Selfplay: write finished games (moves, search policy and value, Tromp-Taylor result with komi) to
+    // gzip shards <record_prefix>-*.gz of about record_shard_mb each. Empty record_prefix is no recording.
+    // Games are written by a background thread. If more than record_queue_mb are waiting, games are dropped.
+    std::string record_prefix;
+    int record_shard_mb = 64;
+    int record_queue_mb = 256;
+    float komi = 7.5;
+
+    // Selfplay: a player resigns when the value of the position (for the player to move, in [-1, 1]) is
+    // below resign_threshold (-1 is never). In a resign_calibration fraction of the games, nobody resigns,
+    // and the games are played out to count how often a resignation would have lost a won game.
+    float resign_threshold = -1.0;
+    float resign_calibration = 0.1;
     bool verbose = false;
 
-    REGISTER_PYBIND_FIELDS(seed, mode, data_aug, start_ratio_pre_moves, ratio_pre_moves, move_cutoff, num_planes, num_future_actions, list_filename, verbose, num_games_per_thread, use_mcts);
+    REGISTER_PYBIND_FIELDS(seed, mode, data_aug, start_ratio_pre_moves, ratio_pre_moves, move_cutoff, num_planes, num_future_actions, list_filename, verbose, num_games_per_thread, use_mcts, superko, uint8_features, replay_buffer_size, replay_buffer_mb, num_prefetch_threads, sample_positions, checkpoint_interval, record_prefix, record_shard_mb, record_queue_mb, komi, resign_threshold, resign_calibration);
 };
 
 struct GameState {
     using State = GameState;
     // Board state 19x19
     std::vector<float> s;
+    // Same planes as uint8 (see BoardFeature::ExtractU8), filled instead of s with uint8_features.
+    std::vector<unsigned char> s_u8;
 
     // Next k actions.
     std::vector<int64_t> offline_a;
@@ -81,10 +116,14 @@ struct GameState {
     std::vector<float> pi;
     float V;
 
+    // Not sent. Which of s / s_u8 the feature extraction fills.
+    bool uint8_features = false;
+
     void Clear() { game_record_idx = -1; aug_code = 0; winner = 0; move_idx = -1; }
 
-    void Init(int iid, int num_action) {
+    void Init(int iid, int num_action, bool u8 = false) {
         id = iid;
+        uint8_features = u8;
         pi.resize(num_action, 0.0);
     }
 
@@ -109,8 +148,8 @@ struct GameState {
         last_terminal = 0;
     }
 
-    DECLARE_FIELD(GameState, id, seq, game_counter, last_terminal, s, offline_a, a, V, pi, move_idx, winner, aug_code, game_record_idx);
-    REGISTER_PYBIND_FIELDS(id, seq, game_counter, last_terminal, s, offline_a, a, V, move_idx, winner, aug_code);
+    DECLARE_FIELD(GameState, id, seq, game_counter, last_terminal, s, s_u8, offline_a, a, V, pi, move_idx, winner, aug_code, game_record_idx);
+    REGISTER_PYBIND_FIELDS(id, seq, game_counter, last_terminal, s, s_u8, offline_a, a, V, move_idx, winner, aug_code);
 };
 
 using Context = ContextT<GameOptions, HistT<GameState>>;
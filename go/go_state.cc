@@ -12,6 +12,8 @@
 #include "go_state.h"
 #include "board_feature.h"
 
+namespace GO_NS {
+
 static std::vector<std::string> split(const std::string &s, char delim) {
     std::stringstream ss(s);
     std::string item;
@@ -22,11 +24,20 @@ static std::vector<std::string> split(const std::string &s, char delim) {
     return elems;
 }
 
+// The handicap table is written for 19x19. Its lines are the 4-4 lines and the centre line,
+// so move them to the same lines on smaller boards (the 3-3 lines on 9x9).
+static int remap_line(int i) {
+    const int edge = BOARD_SIZE >= 13 ? 3 : 2;
+    if (i == 3) return edge;
+    if (i == 15) return BOARD_SIZE - 1 - edge;
+    return BOARD_SIZE / 2;
+}
+
 static Coord s2c(const string &s) {
     int row = s[0] - 'A';
     if (row >= 9) row --;
     int col = stoi(s.substr(1)) - 1;
-    return GetCoord(row, col);
+    return GetCoord(remap_line(row), remap_line(col));
 }
 
 HandicapTable::HandicapTable() {
@@ -73,21 +84,49 @@ void HandicapTable::Apply(int handi, Board *board) const {
 bool GoState::forward(const Coord &c) {
     GroupId4 ids;
     if (! TryPlay2(&_board, c, &ids)) return false;
+    if (IsSuperkoViolation(ids)) return false;
     Play(&_board, &ids);
+    if (_superko && c != M_PASS && c != M_RESIGN) _history.push_back(GetPositionHash(&_board));
     return true;
 }
 
 bool GoState::CheckMove(const Coord &c) const {
     GroupId4 ids;
-    return TryPlay2(&_board, c, &ids);
+    return TryPlay2(&_board, c, &ids) && ! IsSuperkoViolation(ids);
 }
 
 void GoState::ApplyHandicap(int handi) {
     _handi_table.Apply(handi, &_board);
+    ResetHistory();
+}
+
+void GoState::SetBoard(const Board &board) {
+    CopyBoard(&_board, &board);
+    _moves.clear();
+    ResetHistory();
 }
 
 void GoState::Reset() {
     ClearBoard(&_board);
+    ResetHistory();
+}
+
+void GoState::ResetHistory() {
+    _history.clear();
+    if (_superko) _history.push_back(GetPositionHash(&_board));
+}
+
+bool GoState::IsSuperkoViolation(const GroupId4 &ids) const {
+    // A pass keeps the position, so it never counts as a repetition.
+    if (! _superko || ids.c == M_PASS || ids.c == M_RESIGN) return false;
+    uint64_t hash = GetPositionHashAfterPlay(&_board, &ids);
+    // Games are a few hundred moves, a linear scan is cheaper than keeping a set in every copied state.
+    for (uint64_t h : _history) {
+        if (h == hash) return true;
+    }
+    return false;
 }
 
 HandicapTable GoState::_handi_table;
+
+}  // namespace GO_NS
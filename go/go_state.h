@@ -18,6 +18,8 @@
 
 using namespace std;
 
+namespace GO_NS {
+
 class HandicapTable {
 private:
     // handicap table.
@@ -43,11 +45,23 @@ public:
 
     void Reset();
     void ApplyHandicap(int handi);
+    // Jump to a position (e.g., a checkpoint of a game record). The superko history restarts from it.
+    void SetBoard(const Board &board);
 
-    GoState(const GoState &s) : _bf(_board) {
+    GoState(const GoState &s) : _bf(_board), _superko(s._superko), _history(s._history) {
         CopyBoard(&_board, &s._board);
     }
 
+    // Positional superko: a move may not recreate any earlier position of the game. Off by default.
+    void SetSuperko(bool superko) {
+        _superko = superko;
+        ResetHistory();
+    }
+    bool Superko() const { return _superko; }
+
+    // Zobrist hash of the stones, the side to move and the ko point. This is the transposition key for MCTS.
+    uint64_t state_hash() const { return GetBoardHash(&_board); }
+
     static HandicapTable &handi_table() { return _handi_table; }
 
     const Board &board() const { return _board; }
@@ -106,6 +120,20 @@ protected:
     float _final_value = 0.0;
     bool _has_final_value = false;
 
+    // Position hashes since the start of the game, only kept with superko.
+    bool _superko = false;
+    vector<uint64_t> _history;
+
     static HandicapTable _handi_table;
+
+    void ResetHistory();
+    bool IsSuperkoViolation(const GroupId4 &ids) const;
 };
 
+// Fill gs.s, or gs.s_u8 if the state asks for uint8 features.
+inline void ExtractFeatures(const BoardFeature &bf, GameState *gs) {
+    if (gs->uint8_features) bf.ExtractU8(&gs->s_u8);
+    else bf.Extract(&gs->s);
+}
+
+}  // namespace GO_NS
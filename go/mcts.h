@@ -11,42 +11,73 @@
 #include "elf/mcts.h"
 #include "go_ai.h"
 
+namespace GO_NS {
+
 class MCTSActor {
 public:
     using Action = Coord;
     using State = GoState;
     using NodeResponse = mcts::NodeResponseT<Action>;
 
-    MCTSActor(AIComm *ai_comm) {
-        ai_.reset(new DirectPredictAI);
-        ai_->InitAIComm(ai_comm);
-        ai_->SetActorName("actor");
+    MCTSActor(AIComm *ai_comm) : MCTSActor(vector<AIComm *>{ ai_comm }) {
+    }
+
+    // One AIComm (and DirectPredictAI) per leaf that is evaluated in the same batch.
+    MCTSActor(const vector<AIComm *> &ai_comms) {
+        for (AIComm *ai_comm : ai_comms) {
+            ai_.emplace_back(new DirectPredictAI);
+            ai_.back()->InitAIComm(ai_comm);
+            ai_.back()->SetActorName("actor");
+        }
     }
 
     void set_ostream(ostream *oo) { oo_ = oo; }
 
     NodeResponse &evaluate(const GoState &s) {
-        ai_->Act(s, nullptr, nullptr);
-        ai_->get_last_pi(&resp_.pi, oo_);
-        resp_.value = ai_->get_last_value();
+        ai_[0]->Act(s, nullptr, nullptr);
+        ai_[0]->get_last_pi(&resp_.pi, oo_);
+        resp_.value = ai_[0]->get_last_value();
         return resp_;
     }
 
+    // Send all states first and then wait, so that they are evaluated in the same batch.
+    // (*evaluated)[i] is false if states[i] could not be sent, e.g., when the game is stopping.
+    void evaluate_batch(const vector<const GoState *> &states, vector<NodeResponse> *resps, vector<bool> *evaluated) {
+        resps->resize(states.size());
+        evaluated->assign(states.size(), false);
+        for (size_t start = 0; start < states.size(); start += ai_.size()) {
+            size_t n = min(ai_.size(), states.size() - start);
+            vector<bool> sent(n);
+            for (size_t i = 0; i < n; ++i) {
+                sent[i] = ai_[i]->SendAct(*states[start + i], nullptr);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                NodeResponse &resp = (*resps)[start + i];
+                if (! sent[i]) continue;
+                if (! ai_[i]->WaitAct(*states[start + i], nullptr)) continue;
+                ai_[i]->get_last_pi(&resp.pi, oo_);
+                resp.value = ai_[i]->get_last_value();
+                (*evaluated)[start + i] = true;
+            }
+        }
+    }
+
     bool forward(GoState &s, Coord a) {
         return s.forward(a);
     }
 
     void SetId(int id) {
-        ai_->SetId(id);
+        for (auto &ai : ai_) ai->SetId(id);
     }
 
     string info() const { return string(); }
 
 protected:
     NodeResponse resp_;
-    unique_ptr<DirectPredictAI> ai_;
+    vector<unique_ptr<DirectPredictAI>> ai_;
     ostream *oo_ = nullptr;
 };
 
 using MCTSGoAI = elf::MCTSAIWithCommT<MCTSActor, AIComm>;
 
+}  // namespace GO_NS
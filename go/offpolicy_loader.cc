@@ -9,81 +9,192 @@
 
 #include <fstream>
 
+namespace GO_NS {
+
 ///////////// OfflineLoader ////////////////////
 std::unique_ptr<elf::tar::TarLoader> OfflineLoader::_tar_loader;
+std::unique_ptr<GameRecordFile> OfflineLoader::_record_file;
+std::unique_ptr<PositionIndex> OfflineLoader::_position_index;
 vector<string> OfflineLoader::_games;
 string OfflineLoader::_list_filename;
 string OfflineLoader::_path;
 
+// Bound of the replay buffer with sample_positions when replay_buffer_mb is not set. The checkpoints take
+// about 70 KB per game on 19x19, so the default 100000 games would take about 7 GB.
+static const int kCheckpointBufferMB = 2048;
+
 OfflineLoader::OfflineLoader(const GameOptions &options, int seed)
     : _options(options), _game_loaded(0), _rng(seed) {
       ReplayLoader::Reload();
 }
 
-void OfflineLoader::InitSharedBuffer(const std::string &list_filename) {
+// Names of the sgf files in list_filename (a tar, or a text file with one name per line, relative to it).
+static bool read_game_list(const std::string &list_filename, vector<string> *games, string *path,
+        std::unique_ptr<elf::tar::TarLoader> *tar_loader) {
+    if (elf::tar::file_is_tar(list_filename)) {
+        tar_loader->reset(new elf::tar::TarLoader(list_filename));
+        *games = (*tar_loader)->List();
+        *path = "";
+        return true;
+    }
+    // Get all .sgf file in the directory.
+    ifstream iFile(list_filename);
+    if (! iFile.is_open()) {
+        std::cout << "Loading " << list_filename << " failed!" << std::endl;
+        return false;
+    }
+    games->clear();
+    for (string this_game; std::getline(iFile, this_game) ; ) {
+        games->push_back(this_game);
+    }
+    while (! games->empty() && games->back().empty()) games->pop_back();
 
-    if (list_filename.empty()) return;
+    // Get the path of the filename.
+    *path = string(list_filename);
+    int i = path->size() - 1;
+    while (i >= 0 && (*path)[i] != '/') i --;
 
-    if (elf::tar::file_is_tar(list_filename)) {
-        _tar_loader.reset(new elf::tar::TarLoader(list_filename));
-        _games = _tar_loader->List();
-    } else {
-        // Get all .sgf file in the directory.
-        ifstream iFile(list_filename);
-        if (! iFile.is_open()) {
-            std::cout << "Loading " << list_filename << " failed!" << std::endl;
-            return;
-        }
-        _games.clear();
-        for (string this_game; std::getline(iFile, this_game) ; ) {
-            _games.push_back(this_game);
-        }
-        while (_games.back().empty()) _games.pop_back();
+    if (i >= 0) *path = path->substr(0, i + 1);
+    else *path = "";
+    return true;
+}
+
+static bool load_sgf(const std::string &name, const elf::tar::TarLoader *tar_loader, Sgf *sgf) {
+    return tar_loader != nullptr ? sgf->Load(name, *tar_loader) : sgf->Load(name);
+}
 
-        // Get the path of the filename.
-        _path = string(list_filename);
-        int i = _path.size() - 1;
-        while (_path[i] != '/' && i >= 0) i --;
+void OfflineLoader::InitSharedBuffer(const GameOptions &options) {
+    const std::string &list_filename = options.list_filename;
+    if (list_filename.empty()) return;
 
-        if (i >= 0) _path = _path.substr(0, i + 1);
-        else _path = "";
+    if (GameRecordFile::IsGameRecordFile(list_filename)) {
+        _record_file.reset(new GameRecordFile(list_filename));
+        _games = _record_file->List();
+        _path = "";
+    } else if (! read_game_list(list_filename, &_games, &_path, &_tar_loader)) {
+        return;
     }
     _list_filename = list_filename;
 
     std::cout << "Loading list_file: " << list_filename << std::endl;
     std::cout << "Loaded: #Game: " << _games.size() << std::endl;
 
-    elf::tar::TarLoader *tar_loader = _tar_loader.get();
-    auto gen = [tar_loader](const std::string &name) {
-                std::unique_ptr<Sgf> sgf(new Sgf());
-                if (tar_loader != nullptr) {
-                    sgf->Load(name, *tar_loader);
+    if (options.sample_positions) {
+        if (_record_file != nullptr) {
+            _position_index.reset(new PositionIndex(*_record_file,
+                        [&options](const GameRecord &record) { return num_positions(options, record); }));
+            std::cout << "#Positions: " << _position_index->NumPositions() << std::endl;
+            if (_position_index->NumPositions() == 0) _position_index.reset();
+        }
+        if (_position_index == nullptr) std::cout << "Sampling positions uniformly over games, not over positions" << std::endl;
+    }
+
+    const elf::tar::TarLoader *tar_loader = _tar_loader.get();
+    const GameRecordFile *record_file = _record_file.get();
+    const int checkpoint_interval = (options.sample_positions ? options.checkpoint_interval : 0);
+    auto gen = [tar_loader, record_file, checkpoint_interval](const int &game_idx) {
+                std::unique_ptr<GameRecord> record;
+                if (record_file != nullptr) {
+                    // A view into the mapped file (_games is in the same order).
+                    record.reset(new GameRecord(record_file->Get(game_idx)));
                 } else {
-                    sgf->Load(name);
+                    // Only the moves are kept, not the parsed sgf tree.
+                    Sgf sgf;
+                    load_sgf(_path + _games[game_idx], tar_loader, &sgf);
+                    record.reset(new GameRecord(sgf));
                 }
-                return sgf;
+                if (checkpoint_interval > 0 && record->GetBoardSize() == BOARD_SIZE) record->BuildCheckpoints(checkpoint_interval);
+                return record;
            };
-    ReplayLoader::Init(gen);
+
+    SharedReplayBufferOptions buffer_options;
+    buffer_options.max_entries = options.replay_buffer_size;
+    buffer_options.max_bytes = (size_t)options.replay_buffer_mb << 20;
+    if (checkpoint_interval > 0 && buffer_options.max_bytes == 0) {
+        std::cout << "Keeping at most " << kCheckpointBufferMB << " MB of games with checkpoints (see replay_buffer_mb)" << std::endl;
+        buffer_options.max_bytes = (size_t)kCheckpointBufferMB << 20;
+    }
+    buffer_options.num_prefetch_threads = options.num_prefetch_threads;
+    ReplayLoader::Init(gen, buffer_options, [](const GameRecord &record) { return record.MemoryBytes(); });
+}
+
+int OfflineLoader::ConvertGameRecords(const std::string &list_filename, const std::string &record_filename) {
+    vector<string> games;
+    string path;
+    std::unique_ptr<elf::tar::TarLoader> tar_loader;
+    if (! read_game_list(list_filename, &games, &path, &tar_loader)) return 0;
+
+    vector<string> names;
+    vector<GameRecord> records;
+    for (const string &game : games) {
+        Sgf sgf;
+        if (! load_sgf(path + game, tar_loader.get(), &sgf)) continue;
+        // Names are the keys that OfflineLoader looks up.
+        names.push_back(game);
+        records.emplace_back(sgf);
+    }
+    if (! GameRecordFile::Write(record_filename, names, records)) {
+        std::cout << "Writing " << record_filename << " failed!" << std::endl;
+        return 0;
+    }
+    std::cout << "Converted " << records.size() << "/" << games.size() << " games from " << list_filename
+        << " to " << record_filename << std::endl;
+    return records.size();
 }
 
 // Private functions.
-bool OfflineLoader::after_reload(const std::string & /*full_name*/, Sgf::iterator &it) {
-    const Sgf &sgf = it.GetSgf();
+int OfflineLoader::num_positions(const GameOptions &options, const GameRecord &record) {
+    // Same conditions as after_reload and need_reload.
+    if (record.NumMoves() < 10 || record.GetBoardSize() != BOARD_SIZE) return 0;
+    int n = record.NumMoves() - options.num_future_actions;
+    if (options.move_cutoff >= 0) n = std::min(n, options.move_cutoff);
+    return n;
+}
+
+bool OfflineLoader::jump_to_random_position(GameRecord::iterator &it) {
+    const GameRecord &record = it.GetRecord();
+    int n = num_positions(_options, record);
+    if (n <= 0) return false;
+    int target = _rng() % n;
+
+    int move_idx = 0;
+    const Board *checkpoint = record.GetCheckpoint(target, &move_idx);
+    if (checkpoint != nullptr) {
+        s().SetBoard(*checkpoint);
+    } else {
+        s().Reset();
+        s().ApplyHandicap(record.GetHandicapStones());
+    }
+    it.Seek(move_idx);
+    for (; move_idx < target; ++move_idx, ++it) {
+        if (! s().forward(it.GetCoord())) return false;
+    }
+    _jumped = true;
+
+    if (_options.verbose) print_context();
+    return true;
+}
+
+bool OfflineLoader::after_reload(const int &game_idx, GameRecord::iterator &it) {
+    _curr_game = game_idx;
+    const GameRecord &record = it.GetRecord();
     /*
     if (_options.verbose) {
         std::cout << "Loaded file " << full_name << std::endl;
     }
     */
     // If the game record is too short or the boardsize is not what we want, return false.
-    if (sgf.NumMoves() < 10 || sgf.GetBoardSize() != BOARD_SIZE) return false;
+    if (record.NumMoves() < 10 || record.GetBoardSize() != BOARD_SIZE) return false;
     if (need_reload(it)) return false;
 
+    if (_options.sample_positions) return jump_to_random_position(it);
+
     // iterator valid, now we change the state accordingly.
 
     s().Reset();
 
     // Place handicap stones if there is any.
-    int handi = sgf.GetHandicapStones();
+    int handi = record.GetHandicapStones();
     if (_options.verbose) std::cout << "#Handi = " << handi << std::endl;
     s().ApplyHandicap(handi);
 
@@ -94,7 +205,7 @@ bool OfflineLoader::after_reload(const std::string & /*full_name*/, Sgf::iterato
     // Then we need to randomly play the game.
     const float ratio_pre_moves = (_game_loaded == 1 ? _options.start_ratio_pre_moves : _options.ratio_pre_moves);
 
-    int random_base = static_cast<int>(sgf.NumMoves() * ratio_pre_moves + 0.5);
+    int random_base = static_cast<int>(record.NumMoves() * ratio_pre_moves + 0.5);
     if (random_base == 0) random_base ++;
     int pre_moves = _rng() % random_base;
 
@@ -107,17 +218,25 @@ bool OfflineLoader::after_reload(const std::string & /*full_name*/, Sgf::iterato
     return true;
 }
 
-std::string OfflineLoader::get_key() {
-    _curr_game = _rng() % _games.size();
-    return elf::tar::file_is_tar(_list_filename) ? _games[_curr_game] : _path + _games[_curr_game];
+int OfflineLoader::get_key() {
+    if (_position_index != nullptr) {
+        std::uniform_int_distribution<uint64_t> position(0, _position_index->NumPositions() - 1);
+        return _position_index->GetGame(position(_rng));
+    }
+    return _rng() % _games.size();
 }
 
-bool OfflineLoader::need_reload(const Sgf::iterator &it) const {
+bool OfflineLoader::need_reload(const GameRecord::iterator &it) const {
    return (it.done() || it.StepLeft() < _options.num_future_actions 
             || (_options.move_cutoff >= 0 && it.GetCurrIdx() >= _options.move_cutoff));
 }
 
 void OfflineLoader::next() {
+    // Every sample is a new position.
+    if (_options.sample_positions) {
+        ReplayLoader::Reload();
+        return;
+    }
     if (need_reload(curr())) ReplayLoader::Reload();
 
     bool res = s().forward(curr().GetCoord());
@@ -129,7 +248,7 @@ void OfflineLoader::extract(Data *data) {
     auto& gs = data->newest();
     gs.game_record_idx = _curr_game;
     gs.move_idx = s().GetPly();
-    Stone winner = this->curr().GetSgf().GetWinner();
+    Stone winner = this->curr().GetRecord().GetWinner();
     gs.winner = (winner == S_BLACK ? 1 : (winner == S_WHITE ? -1 : 0));
 
     int code = _options.data_aug;
@@ -140,7 +259,7 @@ void OfflineLoader::extract(Data *data) {
     bool flip = (code >> 2) == 1;
     const BoardFeature &bf = s().extractor(rot, flip);
 
-    bf.Extract(&gs.s);
+    ExtractFeatures(bf, &gs);
     save_forward_moves(bf, &gs.offline_a);
 }
 
@@ -172,3 +291,4 @@ bool OfflineLoader::save_forward_moves(const BoardFeature &bf, vector<int64_t> *
     return true;
 }
 
+}  // namespace GO_NS
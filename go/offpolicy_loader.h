@@ -11,21 +11,35 @@
 #include "elf/replay_loader.h"
 #include "elf/tar_loader.h"
 #include "ai.h"
+#include "game_record.h"
 
 using namespace std;
 
-class OfflineLoader : public elf::ReplayLoaderT<std::string, Sgf>, public AIHoldStateWithComm {
+namespace GO_NS {
+
+// Games are kept as GameRecord. list_filename can be a list of sgf files, a tar of sgf files,
+// or a .gorec file made by ConvertGameRecords.
+// The replay buffer is keyed by the index of the game in _games.
+class OfflineLoader : public elf::ReplayLoaderT<int, GameRecord>, public AIHoldStateWithComm {
 public:
     using Data = typename AIHoldStateWithComm::Data;
-    using ReplayLoader = elf::ReplayLoaderT<std::string, Sgf>; 
+    using ReplayLoader = elf::ReplayLoaderT<int, GameRecord>;
 
 public:
     OfflineLoader(const GameOptions &options, int seed);
-    static void InitSharedBuffer(const std::string &list_filename);
+    static void InitSharedBuffer(const GameOptions &options);
+
+    // Parse all games of list_filename (list of sgf files, or tar) into a game record file.
+    // Returns the number of games written.
+    static int ConvertGameRecords(const std::string &list_filename, const std::string &record_filename);
 
 protected:
     // Database
+    // Shared by all loader threads, lookups are lock-free.
     static std::unique_ptr<elf::tar::TarLoader> _tar_loader;
+    static std::unique_ptr<GameRecordFile> _record_file;
+    // With sample_positions and a game record file.
+    static std::unique_ptr<PositionIndex> _position_index;
     static vector<string> _games;
     static string _list_filename;
     static string _path;
@@ -36,18 +50,26 @@ protected:
     int _curr_game;
     int _game_loaded;
     std::mt19937 _rng;
+    // Jumped to a sampled position since the last sample.
+    bool _jumped = false;
 
     // Virtual function for ReplayLoader:
-    std::string get_key() override;
-    bool after_reload(const std::string &full_name, Sgf::iterator &it) override;
+    int get_key() override;
+    bool after_reload(const int &game_idx, GameRecord::iterator &it) override;
 
     // Helper function.
-    bool need_reload(const Sgf::iterator &it) const;
+    bool need_reload(const GameRecord::iterator &it) const;
     void next();
 
+    // Number of positions of the game that can be sampled.
+    static int num_positions(const GameOptions &options, const GameRecord &record);
+    bool jump_to_random_position(GameRecord::iterator &it);
+
     // Virtual function for AIHoldStateWithComm
     void before_act(const std::atomic_bool *) override { 
-        if (s().JustStarted()) ai_comm()->Restart();
+        // A sampled position does not continue the previous sample.
+        if (s().JustStarted() || _jumped) ai_comm()->Restart();
+        _jumped = false;
     }
 
     void extract(Data *data) override;
@@ -57,7 +79,7 @@ protected:
         std::stringstream ss;
         const auto &it = this->curr();
         Coord m = it.GetCoord();
-        ss << it.GetCurrIdx() << "/" << it.GetSgf().NumMoves() << ": " << coord2str(m) << ", " << coord2str2(m) << " (" << m << ")" << std::endl;
+        ss << it.GetCurrIdx() << "/" << it.GetRecord().NumMoves() << ": " << coord2str(m) << ", " << coord2str2(m) << " (" << m << ")" << std::endl;
         return ss.str();
     }
 
@@ -68,3 +90,4 @@ protected:
     bool save_forward_moves(const BoardFeature &bf, vector<int64_t> *actions) const;
 };
 
+}  // namespace GO_NS
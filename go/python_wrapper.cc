@@ -13,19 +13,34 @@
 #include <pybind11/stl.h>
 
 #include "../elf/pybind_helper.h"
+#include "../elf/pybind_interface.h"
 
-#include "game_context.h"
+#include "go_game_specific.h"
 
 namespace py = pybind11;
 
-PYBIND11_MODULE(go_game, m) {
-  register_common_func<GameContext>(m);
+// The engine is compiled once per board size, each in its own namespace (see board.h).
+namespace go9 { void RegisterGameContext(py::module &m, const char *name); }
+namespace go13 { void RegisterGameContext(py::module &m, const char *name); }
+namespace go19 {
+void RegisterGameContext(py::module &m, const char *name);
+void RegisterGameRecordConverter(py::module &m);
+}
 
-  CONTEXT_REGISTER(GameContext)
-      .def("GetParams", &GameContext::GetParams)
-      .def("ShowBoard", &GameContext::ShowBoard);
-      //.def("ApplyHandicap", &GameContext::ApplyHandicap)
-      //.def("UndoMove", &GameContext::UndoMove);
+// All board sizes share the same context and options types.
+struct CommonContext {
+  using GC = Context;
+};
+
+PYBIND11_MODULE(go_game, m) {
+  register_common_func<CommonContext>(m);
+
+  go9::RegisterGameContext(m, "GameContext9");
+  go13::RegisterGameContext(m, "GameContext13");
+  go19::RegisterGameContext(m, "GameContext19");
+  m.attr("GameContext") = m.attr("GameContext19");
+  // Game record files do not depend on the board size, and the 19x19 engine reads sgf up to 19x19.
+  go19::RegisterGameRecordConverter(m);
 
   // Also register other objects.
   PYCLASS_WITH_FIELDS(m, GameOptions)
@@ -0,0 +1,69 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# File: selfplay_reader.py
+
+# Read the self-play shards written with --record_prefix (see selfplay_recorder.h for the layout).
+# Run as a script to print a summary of the given shards.
+
+import argparse
+import gzip
+import struct
+
+MAGIC = b"ELFGOSPL"
+VERSION = 1
+PI_SCALE = 65535.0
+PASS = 0x7fff
+WHITE = 0x8000
+
+_file_header = struct.Struct("=8sI")
+_game_header = struct.Struct("=BBBBffI")
+_move = struct.Struct("=HfH")
+_pi_entry = struct.Struct("=HH")
+
+def decode_move(m):
+    ''' Returns (player, x, y), player is "B" or "W", and (x, y) is None for a pass. '''
+    player = "W" if m & WHITE else "B"
+    m &= ~WHITE
+    if m == PASS:
+        return player, None
+    return player, (m & 31, m >> 5)
+
+def read_shard(filename):
+    ''' Yield one dict per game of the shard. '''
+    with gzip.open(filename, "rb") as f:
+        data = f.read()
+
+    magic, version = _file_header.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("%s: not a self-play shard (version %d)" % (filename, version))
+    pos = _file_header.size
+
+    while pos < len(data):
+        board_size, winner, handicap, _, komi, win_margin, num_moves = _game_header.unpack_from(data, pos)
+        pos += _game_header.size
+        moves, values, policies = [], [], []
+        for _ in range(num_moves):
+            m, value, n = _move.unpack_from(data, pos)
+            pos += _move.size
+            pi = []
+            for _ in range(n):
+                a, prob = _pi_entry.unpack_from(data, pos)
+                pos += _pi_entry.size
+                pi.append((decode_move(a)[1], prob / PI_SCALE))
+            moves.append(decode_move(m))
+            values.append(value)
+            policies.append(pi)
+
+        yield dict(board_size=board_size, winner={1: "B", 2: "W"}.get(winner), handicap=handicap,
+                   komi=komi, win_margin=win_margin, moves=moves, values=values, policies=policies)
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument("shards", nargs="+", help="self-play shards (.gz)")
+    args = parser.parse_args()
+
+    for filename in args.shards:
+        games = list(read_shard(filename))
+        num_moves = sum(len(g["moves"]) for g in games)
+        black_wins = sum(1 for g in games if g["winner"] == "B")
+        print("%s: %d games, %d moves, black wins %d" % (filename, len(games), num_moves, black_wins))
@@ -0,0 +1,73 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include <string.h>
+#include <algorithm>
+
+#include "selfplay_recorder.h"
+
+namespace GO_NS {
+
+template <typename T>
+static void append(std::string *buf, const T &v) {
+    buf->append(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+///////////// SelfPlayGame ////////////////////
+void SelfPlayGame::AddMove(Stone player, Coord c, const std::vector<std::pair<Coord, float>> &pi, float value) {
+    append(&_moves, GameRecord::EncodeMove(SgfMove(player, c)));
+    append(&_moves, value);
+
+    size_t n_pos = _moves.size();
+    uint16_t n = 0;
+    append(&_moves, n);
+    for (const auto &p : pi) {
+        uint16_t prob = (uint16_t)lrintf(std::min(std::max(p.second, 0.0f), 1.0f) * SELFPLAY_PI_SCALE);
+        if (prob == 0) continue;
+        append(&_moves, GameRecord::EncodeMove(SgfMove(player, p.first)));
+        append(&_moves, prob);
+        n ++;
+    }
+    memcpy(&_moves[n_pos], &n, sizeof(n));
+    _num_moves ++;
+}
+
+std::string SelfPlayGame::Finish(Stone winner, float win_margin, float komi, int handicap) const {
+    GameRecordHeader h;
+    memset(&h, 0, sizeof(h));
+    h.board_size = BOARD_SIZE;
+    h.winner = winner;
+    h.handicap = handicap;
+    h.komi = komi;
+    h.win_margin = win_margin;
+    h.num_moves = _num_moves;
+
+    std::string buf;
+    buf.reserve(sizeof(h) + _moves.size());
+    append(&buf, h);
+    buf += _moves;
+    return buf;
+}
+
+///////////// SelfPlayRecorder ////////////////////
+SelfPlayRecorder::SelfPlayRecorder(const GameOptions &options) : _komi(options.komi) {
+    elf::ShardWriterOptions writer_options;
+    writer_options.prefix = options.record_prefix;
+    writer_options.shard_bytes = (size_t)options.record_shard_mb << 20;
+    writer_options.max_queued_bytes = (size_t)options.record_queue_mb << 20;
+
+    writer_options.shard_header = SELFPLAY_MAGIC;
+    append(&writer_options.shard_header, (uint32_t)SELFPLAY_VERSION);
+    _writer.reset(new elf::ShardWriter(writer_options));
+}
+
+bool SelfPlayRecorder::Record(const SelfPlayGame &game, Stone winner, float win_margin, int handicap) {
+    return _writer->Push(game.Finish(winner, win_margin, _komi, handicap));
+}
+
+}  // namespace GO_NS
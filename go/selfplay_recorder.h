@@ -0,0 +1,71 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "elf/shard_writer.h"
+#include "go_game_specific.h"
+#include "game_record.h"
+
+namespace GO_NS {
+
+// Finished self-play games, written to gzip shards (see elf::ShardWriter) for training.
+//
+// Shard layout (native byte order, each shard can be read alone, see go/selfplay_reader.py):
+//   SELFPLAY_MAGIC, uint32 SELFPLAY_VERSION
+//   for each game:
+//     GameRecordHeader: winner and win_margin by Tromp-Taylor score with komi (win_margin is 0 for a
+//                       resignation), num_moves includes passes
+//     for each move:
+//       uint16 move (see GameRecord::EncodeMove), float value (as the network gives it, +1 is a black win)
+//       uint16 n, then n x (uint16 move, uint16 probability * SELFPLAY_PI_SCALE) of the search policy
+#define SELFPLAY_MAGIC "ELFGOSPL"
+#define SELFPLAY_VERSION 1
+#define SELFPLAY_PI_SCALE 65535
+
+// The record of the game being played, kept by its game thread.
+class SelfPlayGame {
+public:
+    void Clear() {
+        _moves.clear();
+        _num_moves = 0;
+    }
+    int NumMoves() const { return _num_moves; }
+
+    // pi is the search policy (e.g., MCTS visits). Moves whose probability rounds to 0 are left out.
+    void AddMove(Stone player, Coord c, const std::vector<std::pair<Coord, float>> &pi, float value);
+
+    // The serialized game, with its result.
+    std::string Finish(Stone winner, float win_margin, float komi, int handicap) const;
+
+private:
+    std::string _moves;
+    int _num_moves = 0;
+};
+
+class SelfPlayRecorder {
+public:
+    // Writes to options.record_prefix-*.gz.
+    SelfPlayRecorder(const GameOptions &options);
+
+    // Hand the game to the writer thread, never waits for I/O. Returns false if it is dropped.
+    bool Record(const SelfPlayGame &game, Stone winner, float win_margin, int handicap);
+
+    elf::ShardWriterStats GetStats() const { return _writer->GetStats(); }
+
+private:
+    float _komi;
+    std::unique_ptr<elf::ShardWriter> _writer;
+};
+
+}  // namespace GO_NS
@@ -8,10 +8,13 @@
 
 #include "sgf.h"
 #include <fstream>
+#include <functional>
 #include <sstream>
 
 using namespace std;
 
+namespace GO_NS {
+
 static std::string trim(const std::string& str) {
     int l = 0;
     while (l < (int)str.size() && (str[l] == ' ' || str[l] == '\n')) l ++;
@@ -25,9 +28,11 @@ static std::string trim(const std::string& str) {
 typedef pair<int, int> seg;
 
 bool Sgf::load_game(const string& filename, const string& game_string) {
-    const char *str = game_string.c_str();
-    int len = game_string.size();
+    return load_game(filename, game_string.c_str(), game_string.size());
+}
 
+// Only reads str[0, len), str does not have to be NUL-terminated.
+bool Sgf::load_game(const string& filename, const char *str, int len) {
     _header.Reset();
     int next_offset = 0;
     if (load_header(str, seg(0, len), &next_offset)) {
@@ -56,8 +61,9 @@ bool Sgf::load_game(const string& filename, const string& game_string) {
     return false;
 }
 
-bool Sgf::Load(const string& filename, elf::tar::TarLoader& tar_loader) {
-  return load_game(filename, tar_loader.Load(filename));
+bool Sgf::Load(const string& filename, const elf::tar::TarLoader& tar_loader) {
+  elf::tar::Slice game = tar_loader.Get(filename);
+  return load_game(filename, game.data, game.size);
 }
 
 bool Sgf::Load(const string& filename) {
@@ -161,11 +167,11 @@ bool Sgf::load_header(const char *s, const seg& range, int *next_offset) {
     // Load the header.
     int i = range.first;
     // std::cout << "[" << range.first << ", " << range.second << ")" << std::endl;
-    while (s[i] != ';' && i < range.second) {
+    while (i < range.second && s[i] != ';') {
         // std::cout << "Char[" << i << "]: " << s[i] << std::endl;
         i++;
     }
-    if (s[i] != ';') return false;
+    if (i >= range.second) return false;
     i ++;
     // Now we have header.
     *next_offset = get_key_values(s, seg(i, range.second), [&](const char *_s, const seg& key, const seg& value) {
@@ -204,11 +210,11 @@ SgfEntry *Sgf::load(const char *s, const seg &range, int *next_offset) {
     ++i;
 
     SgfEntry *entry = new SgfEntry;
-    if (s[i] == '(') {
+    if (i < e && s[i] == '(') {
         ++i;
         // Recursion.
         entry->child.reset(load(s, seg(i, e), next_offset));
-        if (s[*next_offset] != ')') {
+        if (*next_offset >= e || s[*next_offset] != ')') {
             // Corrupted file.
             return nullptr;
         }
@@ -252,3 +258,5 @@ string Sgf::PrintMainVariation() {
     }
     return ss.str();
 }
+
+}  // namespace GO_NS
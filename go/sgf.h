@@ -19,6 +19,8 @@
 
 using namespace std;
 
+namespace GO_NS {
+
 // Load the remaining part.
 inline Coord str2coord(const string &s) {
     if (s.size() < 2) return M_PASS;
@@ -61,8 +63,9 @@ inline string coords2sgfstr(const vector<Coord>& moves) {
 
 
 struct SgfEntry {
-    Coord move;
-    Stone player;
+    // Nodes without B[] or W[] keep these.
+    Coord move = M_INVALID;
+    Stone player = S_OFF_BOARD;
     string comment;
 
     // All other (key, value) pairs.
@@ -125,6 +128,7 @@ private:
 
     static SgfEntry *load(const char *s, const std::pair<int, int>& range, int *next_offset);
     bool load_game(const string& filename, const string& game);
+    bool load_game(const string& filename, const char *game, int len);
 
 public:
     class iterator {
@@ -179,15 +183,20 @@ public:
 
     Sgf() : _num_moves(0) { }
     bool Load(const string& filename);
-    bool Load(const string& gamename, elf::tar::TarLoader& tar_loader);
+    // Parses the game in place in the (mapped) archive, without copying it.
+    bool Load(const string& gamename, const elf::tar::TarLoader& tar_loader);
 
     iterator begin() const { return iterator(*this); }
 
     Stone GetWinner() const { return _header.winner; }
     int GetHandicapStones() const { return _header.handi; }
     int GetBoardSize() const { return _header.size; }
+    float GetKomi() const { return _header.komi; }
+    float GetWinMargin() const { return _header.win_margin; }
     int NumMoves() const { return _num_moves; }
 
     string PrintHeader() const;
     string PrintMainVariation();
 };
+
+}  // namespace GO_NS
@@ -0,0 +1,106 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//gcc -c ../vendor/microtar.c
+//g++ -std=c++11 -O2 -I.. -I../vendor -I../vendor/pybind11/include `python3-config --includes` test_board_feature.cc board.cc board_feature.cc go_state.cc sgf.cc ../elf/tar_loader.cc microtar.o -o test_board_feature
+//
+// Compares BoardFeature::ExtractU8 with Extract on positions of random games, for the 8 symmetries:
+// the history planes have to be round(h * 255), the closest color planes min(distance, 255), and the
+// other planes the same 0 / 1.
+
+#include <math.h>
+#include <iostream>
+#include <random>
+
+#include "go_state.h"
+
+using namespace GO_NS;
+
+struct Coverage {
+    // History values for which truncation would give a different byte than rounding.
+    int rounded_up = 0;
+    // Distances which only fit in a byte once saturated.
+    int saturated = 0;
+    int positions = 0;
+};
+
+static bool compare(const Board &board, BoardFeature::Rot rot, bool flip, Coverage *coverage) {
+    BoardFeature bf(board, rot, flip);
+    std::vector<float> f;
+    std::vector<unsigned char> u8;
+    bf.Extract(&f);
+    bf.ExtractU8(&u8);
+    if (f.size() != u8.size()) {
+        cout << "FAILED: " << u8.size() << " bytes for " << f.size() << " floats" << endl;
+        return false;
+    }
+
+    const int N = BOARD_SIZE * BOARD_SIZE;
+    for (size_t k = 0; k < f.size(); ++k) {
+        const int plane = k / N;
+        int expected;
+        if (plane == OUR_HISTORY || plane == OPPONENT_HISTORY) {
+            expected = lround(f[k] * U8_HISTORY_SCALE);
+            if (expected != (int)(f[k] * U8_HISTORY_SCALE)) coverage->rounded_up ++;
+        } else if (plane == OUR_CLOSEST_COLOR || plane == OPPONENT_CLOSEST_COLOR) {
+            expected = (int)std::min(f[k], (float)U8_MAX_DISTANCE);
+            if (f[k] > U8_MAX_DISTANCE) coverage->saturated ++;
+        } else {
+            expected = (int)f[k];
+        }
+        if (u8[k] != expected) {
+            cout << "FAILED: rot " << rot << ", flip " << flip << ", ply " << board._ply << ": plane " << plane
+                 << ", offset " << k % N << " is " << (int)u8[k] << ", expected " << expected << " (" << f[k] << ")" << endl;
+            ShowBoard(&board, SHOW_LAST_MOVE);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool compare_all(const Board &board, Coverage *coverage) {
+    for (int code = 0; code < 8; ++code) {
+        if (! compare(board, (BoardFeature::Rot)(code % 4), code >= 4, coverage)) return false;
+    }
+    coverage->positions ++;
+    return true;
+}
+
+int main() {
+    std::mt19937 rng(0);
+    Coverage coverage;
+    Board board;
+    for (int game = 0; game < 20; ++game) {
+        ClearBoard(&board);
+        // The empty board, and the first moves where one color has no stone, saturate the distances.
+        if (! compare_all(board, &coverage)) return 1;
+        while (board._ply < 2 * NUM_INTERSECTION) {
+            AllMoves all_moves;
+            FindAllCandidateMoves(&board, board._next_player, 3, &all_moves);
+            Coord c = M_PASS;
+            if (all_moves.num_moves > 0 && rng() % 50 != 0) c = all_moves.moves[rng() % all_moves.num_moves];
+
+            GroupId4 ids;
+            if (! TryPlay2(&board, c, &ids)) {
+                cout << "FAILED: generated move " << c << " cannot be played" << endl;
+                return 1;
+            }
+            const bool end = Play(&board, &ids);
+            if ((board._ply < 4 || rng() % 10 == 0) && ! compare_all(board, &coverage)) return 1;
+            if (end) break;
+        }
+    }
+    if (coverage.rounded_up == 0 || coverage.saturated == 0) {
+        cout << "FAILED: not covered, rounded up history: " << coverage.rounded_up << ", saturated distances: "
+             << coverage.saturated << endl;
+        return 1;
+    }
+    cout << "Passed: " << coverage.positions << " positions x 8 symmetries, " << coverage.rounded_up
+         << " history values rounded up, " << coverage.saturated << " distances saturated" << endl;
+    return 0;
+}
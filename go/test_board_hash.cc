@@ -0,0 +1,145 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//gcc -c ../vendor/microtar.c
+//g++ -std=c++11 -O2 -I.. -I../vendor -I../vendor/pybind11/include `python3-config --includes` test_board_hash.cc board.cc board_feature.cc go_state.cc sgf.cc ../elf/tar_loader.cc microtar.o -o test_board_hash
+//
+// Plays random games and checks the incremental Zobrist hash against a recomputed one after every move,
+// pass and undo, and that GetPositionHashAfterPlay predicts the position. Then plays a double ko, whose
+// cycle only positional superko rejects.
+
+#include <iostream>
+#include <random>
+
+#include "go_state.h"
+
+using namespace GO_NS;
+
+static bool check_hash(const Board *board, const char *what) {
+    if (GetBoardHash(board) != ComputeBoardHash(board)) {
+        cout << "FAILED: incremental hash " << GetBoardHash(board) << " != " << ComputeBoardHash(board) << " after " << what << endl;
+        ShowBoard(board, SHOW_LAST_MOVE);
+        return false;
+    }
+    return true;
+}
+
+static bool test_random_games(int num_games) {
+    std::mt19937 rng(0);
+    int num_captures = 0, num_kos = 0, num_undos = 0;
+    Board board;
+    for (int game = 0; game < num_games; ++game) {
+        ClearBoard(&board);
+        if (! check_hash(&board, "ClearBoard")) return false;
+        while (board._ply < 2 * NUM_INTERSECTION) {
+            Stone player = board._next_player;
+            AllMoves all_moves;
+            // Some self-ataris, for more captures.
+            if (rng() % 4 == 0) FindAllValidMoves(&board, player, &all_moves);
+            else FindAllCandidateMoves(&board, player, 3, &all_moves);
+
+            Coord c = M_PASS;
+            if (all_moves.num_moves > 0 && rng() % 50 != 0) c = all_moves.moves[rng() % all_moves.num_moves];
+
+            if (c == M_PASS && rng() % 2 == 0) {
+                uint64_t before = GetBoardHash(&board);
+                GroupId4 ids;
+                TryPlay2(&board, M_PASS, &ids);
+                Play(&board, &ids);
+                if (! check_hash(&board, "pass")) return false;
+                if (! UndoPass(&board) || ! check_hash(&board, "undo") || GetBoardHash(&board) != before) {
+                    cout << "FAILED: UndoPass does not restore the hash" << endl;
+                    return false;
+                }
+                num_undos ++;
+            }
+
+            GroupId4 ids;
+            if (! TryPlay2(&board, c, &ids)) {
+                cout << "FAILED: generated move " << c << " cannot be played" << endl;
+                return false;
+            }
+            const uint64_t predicted = GetPositionHashAfterPlay(&board, &ids);
+            const bool end = Play(&board, &ids);
+            if (! check_hash(&board, "a move")) return false;
+            if (GetPositionHash(&board) != predicted) {
+                cout << "FAILED: GetPositionHashAfterPlay " << predicted << " != " << GetPositionHash(&board) << endl;
+                ShowBoard(&board, SHOW_LAST_MOVE);
+                return false;
+            }
+            if (board._num_group_removed > 0) num_captures ++;
+            if (board._ko_age == 0 && board._simple_ko != M_PASS && board._last_move == c && c != M_PASS) num_kos ++;
+            if (end) break;
+        }
+    }
+    if (num_captures == 0 || num_kos == 0 || num_undos == 0) {
+        cout << "FAILED: not covered, captures: " << num_captures << ", kos: " << num_kos << ", undos: " << num_undos << endl;
+        return false;
+    }
+    cout << "Random games: " << num_games << " games, " << num_captures << " captures, " << num_kos << " kos, "
+         << num_undos << " undos" << endl;
+    return true;
+}
+
+// Two kos, K1 (black to take at (3, 2)) and K2 (white to take at (12, 2)):
+//   . X O .   . . .   . O X .
+//   X O . O   . . .   O X . X
+//   . X O .   . . .   . O X .
+// Black takes K1, white takes K2, black passes, white retakes K1 and black retakes K2, which brings back
+// the stones of the start. Simple ko allows each of these moves.
+static bool play_double_ko(bool superko, bool *last_move_played) {
+    const int setup[][2] = {
+        { 2, 1 }, { 3, 1 }, { 1, 2 }, { 2, 2 }, { 2, 3 }, { 4, 2 }, { 12, 1 }, { 3, 3 },
+        { 11, 2 }, { 11, 1 }, { 13, 2 }, { 10, 2 }, { 12, 3 }, { 11, 3 },
+    };
+    GoState state;
+    state.SetSuperko(superko);
+    for (const auto &xy : setup) {
+        if (! state.forward(GetCoord(xy[0], xy[1]))) {
+            cout << "FAILED: setup move (" << xy[0] << ", " << xy[1] << ") is rejected" << endl;
+            return false;
+        }
+    }
+    const Coord cycle[] = { GetCoord(3, 2), GetCoord(12, 2), M_PASS, GetCoord(2, 2) };
+    for (Coord c : cycle) {
+        if (! state.forward(c)) {
+            cout << "FAILED: move " << coord2str(c) << " of the double ko is rejected" << endl;
+            return false;
+        }
+    }
+    const Coord last = GetCoord(11, 2);
+    *last_move_played = state.CheckMove(last);
+    if (state.forward(last) != *last_move_played) {
+        cout << "FAILED: CheckMove and forward disagree on " << coord2str(last) << endl;
+        return false;
+    }
+    return true;
+}
+
+static bool test_superko() {
+    bool played;
+    if (! play_double_ko(false, &played)) return false;
+    if (! played) {
+        cout << "FAILED: without superko, the double ko should go on" << endl;
+        return false;
+    }
+    if (! play_double_ko(true, &played)) return false;
+    if (played) {
+        cout << "FAILED: with superko, the move that repeats the position should be rejected" << endl;
+        return false;
+    }
+    cout << "Superko: the double ko cycle is rejected" << endl;
+    return true;
+}
+
+int main() {
+    if (! test_random_games(200)) return 1;
+    if (! test_superko()) return 1;
+    cout << "Passed" << endl;
+    return 0;
+}
@@ -0,0 +1,166 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//gcc -c ../vendor/microtar.c
+//g++ -std=c++11 -O2 -I.. -I../vendor -I../vendor/pybind11/include `python3-config --includes` test_game_record.cc game_record.cc board.cc board_feature.cc go_state.cc sgf.cc ../elf/tar_loader.cc microtar.o -o test_game_record
+//
+// Writes random games to a game record file and reads them back. Then checks that every truncation of
+// the file, and headers whose offsets would wrap around, are rejected with an exception when opened.
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "go_state.h"
+#include "game_record.h"
+
+using namespace GO_NS;
+
+static std::string read_file(const std::string &filename) {
+    std::ifstream iFile(filename, std::ios::binary);
+    std::stringstream ss;
+    ss << iFile.rdbuf();
+    return ss.str();
+}
+
+static void write_file(const std::string &filename, const std::string &data) {
+    std::ofstream oFile(filename, std::ios::binary);
+    oFile.write(data.data(), data.size());
+}
+
+// Whether opening the file throws. The error message is not printed.
+static bool open_fails(const std::string &filename) {
+    std::stringstream discard;
+    auto *old = cout.rdbuf(discard.rdbuf());
+    bool fails = false;
+    try {
+        GameRecordFile file(filename);
+    } catch (const std::range_error &) {
+        fails = true;
+    }
+    cout.rdbuf(old);
+    return fails;
+}
+
+static bool test_round_trip(const std::string &filename, const std::vector<std::string> &names,
+        const std::vector<GameRecord> &records) {
+    if (! GameRecordFile::Write(filename, names, records)) {
+        cout << "FAILED: cannot write " << filename << endl;
+        return false;
+    }
+    GameRecordFile file(filename);
+    if (file.size() != records.size() || file.List() != names) {
+        cout << "FAILED: " << file.size() << " games read back, " << records.size() << " written" << endl;
+        return false;
+    }
+    for (size_t i = 0; i < records.size(); ++i) {
+        const GameRecord r = file.Get(i);
+        const GameRecordHeader &a = r.header(), &b = records[i].header();
+        bool same = file.Find(names[i]) == (int)i && a.board_size == b.board_size && a.winner == b.winner &&
+            a.handicap == b.handicap && a.komi == b.komi && a.win_margin == b.win_margin && a.num_moves == b.num_moves;
+        for (int k = 0; same && k < r.NumMoves(); ++k) {
+            same = r.GetMove(k).player == records[i].GetMove(k).player && r.GetMove(k).move == records[i].GetMove(k).move;
+        }
+        if (! same) {
+            cout << "FAILED: game " << i << " (" << names[i] << ") differs once read back" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool test_truncated(const std::string &filename, const std::string &data) {
+    for (size_t len = 0; len < data.size(); ++len) {
+        write_file(filename, data.substr(0, len));
+        if (! open_fails(filename)) {
+            cout << "FAILED: the file cut at " << len << " of " << data.size() << " bytes is accepted" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// index_offset + num_games * 8 wraps around to a small number.
+static bool test_wrapped_offsets(const std::string &filename, const std::string &data) {
+    GameRecordFileHeader h;
+    memcpy(&h, data.data(), sizeof(h));
+    const uint64_t index_offsets[] = { ~(uint64_t)0 - 7, (uint64_t)1 << 63, data.size() + 8 };
+    for (uint64_t index_offset : index_offsets) {
+        GameRecordFileHeader bad = h;
+        bad.index_offset = index_offset;
+        std::string corrupted = data;
+        memcpy(&corrupted[0], &bad, sizeof(bad));
+        write_file(filename, corrupted);
+        if (! open_fails(filename)) {
+            cout << "FAILED: index_offset " << index_offset << " is accepted" << endl;
+            return false;
+        }
+    }
+
+    // A record offset close to 2^64.
+    std::string corrupted = data;
+    const uint64_t offset = ~(uint64_t)0 - 3;
+    memcpy(&corrupted[h.index_offset], &offset, sizeof(offset));
+    write_file(filename, corrupted);
+    if (! open_fails(filename)) {
+        cout << "FAILED: record offset " << offset << " is accepted" << endl;
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    char filename_template[] = "/tmp/test_game_record.XXXXXX";
+    const int fd = mkstemp(filename_template);
+    if (fd < 0) {
+        cout << "Cannot create a temporary file" << endl;
+        return 1;
+    }
+    close(fd);
+    const std::string filename = filename_template;
+
+    // Random moves, some passes and both colors. Odd numbers of moves leave padding before the next game.
+    std::mt19937 rng(0);
+    std::vector<std::vector<uint16_t>> moves(6);
+    std::vector<GameRecord> records;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        GameRecordHeader h;
+        memset(&h, 0, sizeof(h));
+        h.board_size = BOARD_SIZE;
+        h.winner = (i % 3 == 0 ? S_OFF_BOARD : (i % 3 == 1 ? S_BLACK : S_WHITE));
+        h.handicap = i % 2 == 0 ? 0 : 2 + i;
+        h.komi = 7.5 - i;
+        h.win_margin = i * 1.5;
+        const int num_moves = i == 0 ? 0 : rng() % 40;
+        for (int k = 0; k < num_moves; ++k) {
+            const Stone player = k % 2 == 0 ? S_BLACK : S_WHITE;
+            const Coord c = rng() % 20 == 0 ? M_PASS : OFFSETXY(rng() % BOARD_SIZE, rng() % BOARD_SIZE);
+            moves[i].push_back(GameRecord::EncodeMove(SgfMove(player, c)));
+        }
+        h.num_moves = moves[i].size();
+        records.emplace_back(h, moves[i].data());
+        names.push_back("game" + std::to_string(i) + ".sgf");
+    }
+    names[2] = "";
+
+    bool ok = test_round_trip(filename, names, records);
+    const std::string data = read_file(filename);
+    ok = ok && test_truncated(filename, data) && test_wrapped_offsets(filename, data);
+    // No game at all.
+    ok = ok && test_round_trip(filename, std::vector<std::string>(), std::vector<GameRecord>());
+    unlink(filename.c_str());
+    if (! ok) return 1;
+
+    cout << "Passed: " << records.size() << " games, " << data.size() << " bytes" << endl;
+    return 0;
+}
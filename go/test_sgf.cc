@@ -9,6 +9,8 @@
 #include <iostream>
 #include "sgf.h"
 
+using namespace GO_NS;
+
 int main() {
     Sgf sgf;
     sgf.Load("sample1.sgf");
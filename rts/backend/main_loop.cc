@@ -334,6 +334,89 @@ void test() {
     }
 }
 
+// Plays simple vs simple, and every clone_every ticks checks that copying the state gives the same state as the
+// serializer round trip (also after both are run for a while), and times both.
+bool clone_test(const Parser &parser, int frame_skip) {
+    RTSGameOptions options;
+    options.main_loop_quota = 0;
+    options.output_file = "";
+    options.tick_prompt_n_step = -1;
+    options.seed = parser.GetItem<int>("seed");
+    options.max_tick = parser.GetItem<int>("max_tick");
+    const int clone_every = parser.GetItem<int>("clone_every");
+    const int clone_run = 50;
+    const int num_clones = 100;
+
+    RTSStateExtend state(options);
+    RTSGame game(&state);
+    game.AddBot(AIFactory<AI>::CreateAI("simple", ""), frame_skip);
+    game.AddBot(AIFactory<AI>::CreateAI("simple", ""), frame_skip);
+    state.AppendPlayer("simple1");
+    state.AppendPlayer("simple2");
+
+    chrono::duration<double> copy_time(0), serializer_time(0);
+    int copies = 0, checks = 0;
+
+    state.Init();
+    while (game.Step() == elf::GAME_NORMAL) {
+        if (state.GetTick() % clone_every != 0) continue;
+
+        auto t0 = chrono::system_clock::now();
+        for (int i = 0; i < num_clones; ++i) RTSState copied(state);
+        auto t1 = chrono::system_clock::now();
+        for (int i = 0; i < num_clones; ++i) {
+            RTSState loaded;
+            string s;
+            state.Save(&s);
+            loaded.Load(s);
+        }
+        auto t2 = chrono::system_clock::now();
+        copy_time += t1 - t0;
+        serializer_time += t2 - t1;
+        copies += num_clones;
+
+        // The copy and the loaded state have to give the same snapshot as the state itself.
+        RTSState copied(state), loaded;
+        string s, copied_s, loaded_s;
+        state.Save(&s);
+        copied.Save(&copied_s);
+        if (copied_s != s) {
+            cout << "[" << state.GetTick() << "] copied snapshot differs from the state" << endl;
+            return false;
+        }
+        loaded.Load(s);
+        loaded.Save(&loaded_s);
+        if (loaded_s != s) {
+            cout << "[" << state.GetTick() << "] loaded snapshot differs from the state" << endl;
+            return false;
+        }
+
+        for (int i = 0; i <= clone_run; ++i) {
+            if (i > 0) {
+                copied.PostAct();
+                copied.IncTick();
+                loaded.PostAct();
+                loaded.IncTick();
+            }
+            uint64_t copied_code = copied.env().CurrentHashCode();
+            uint64_t loaded_code = loaded.env().CurrentHashCode();
+            if (copied_code != loaded_code || (i == 0 && copied_code != state.env().CurrentHashCode())) {
+                cout << "[" << state.GetTick() << "+" << i << "] copied state differs from the loaded one: "
+                     << copied_code << " vs " << loaded_code << endl;
+                return false;
+            }
+        }
+        checks ++;
+    }
+
+    cout << "Clone test passed, " << checks << " states checked, up to tick " << state.GetTick() << endl;
+    if (copies > 0) {
+        cout << "Copy: " << copies / copy_time.count() << " clones/sec, serializer round trip: "
+             << copies / serializer_time.count() << " clones/sec" << endl;
+    }
+    return true;
+}
+
 int main(int argc, char *argv[]) {
     const map<string, function<RTSGameOptions (const Parser &, string *)> > func_mapping = {
         { "selfplay", ai_vs_ai },
@@ -344,6 +427,7 @@ int main(int argc, char *argv[]) {
         { "replay_cmd", replay_cmd },
         { "humanplay", ai_vs_human },
         { "multiple_selfplay", nullptr},
+        { "clone", nullptr},
         //{ "replay_rollout", nullptr},
         //{ "replay_mcts", nullptr},
 
@@ -359,7 +443,7 @@ int main(int argc, char *argv[]) {
 
     CmdLineUtils::CmdLineParser parser("playstyle --save_replay --load_replay --vis_after[-1] --save_snapshot_prefix --load_snapshot_prefix --seed[0] \
 --load_snapshot_length --max_tick[30000] --binary_io[1] --games[16] --frame_skip[1] --tick_prompt_n_step[2000] --cmd_verbose[0] --peek_ticks --cmd_dumper_prefix \
---output_file[cout] --mcts_threads[16] --mcts_rollout_per_thread[100] --threads[64] --load_binary_string --mcts_verbose --mcts_prerun_cmds --handicap_level[0]");
+--output_file[cout] --clone_every[100] --mcts_threads[16] --mcts_rollout_per_thread[100] --threads[64] --load_binary_string --mcts_verbose --mcts_prerun_cmds --handicap_level[0]");
 
     if (! parser.Parse(argc, argv)) {
         cout << parser.PrintHelper() << endl;
@@ -396,7 +480,9 @@ int main(int argc, char *argv[]) {
     //    replay_mcts(parser);
     // } else
 
-    if (playstyle == "multiple_selfplay") {
+    if (playstyle == "clone") {
+        if (! clone_test(parser, frame_skip)) return 1;
+    } else if (playstyle == "multiple_selfplay") {
         int threads = parser.GetItem<int>("threads");
         int games = parser.GetItem<int>("games");
         int seed0 = parser.GetItem<int>("seed");
@@ -101,7 +101,7 @@ void save2json::SavePlayerMap(const Player& player, json *game) {
             } else {
                 // Add prev seen units.
                 for (const auto &u : f.seen_units()) {
-                    Save(u, nullptr, &rts_map);
+                    Save(u, &rts_map);
                 }
             }
 
@@ -179,6 +179,19 @@ void save2json::Save(const Unit& unit, const CmdReceiver *receiver, json *game)
     (*game)["units"].push_back(u);
 }
 
+void save2json::Save(const SeenUnit& unit, json *game) {
+    json u;
+    u["id"] = unit.GetId();
+    u["player_id"] = unit.GetPlayerId();
+    u["hp"] = unit._hp;
+    u["max_hp"] = unit._max_hp;
+    u["unit_type"] = unit.GetUnitType();
+
+    set_p(unit.GetPointF(), &u["p"]);
+    set_p(unit.GetLastPointF(), &u["last_p"]);
+    (*game)["units"].push_back(u);
+}
+
 void save2json::Save(const Bullet& bullet, json *game) {
     json bb;
     bb["id_from"] = bullet.GetIdFrom();
@@ -17,6 +17,7 @@ using json = nlohmann::json;
 class RTSMap;
 class Player;
 class Unit;
+struct SeenUnit;
 class Bullet;
 class CmdReceiver;
 
@@ -34,6 +35,8 @@ public:
   static void SavePlayerMap(const Player& player, json *game);
   // static void Save(const AI &bot, json *game);
   static void Save(const Unit& unit, const CmdReceiver *receiver, json *game);
+  // A unit in the fog, as the player saw it last.
+  static void Save(const SeenUnit& unit, json *game);
   static void Save(const Bullet& bullet, json *game);
   static void SaveCmd(const CmdReceiver &receiver, PlayerId player_id, json *game);
 };
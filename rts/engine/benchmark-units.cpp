@@ -0,0 +1,152 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//g++ -O3 -std=c++11 benchmark-units.cpp unit_store.cc -I. -o benchmark-units
+// Usage: ./benchmark-units [#ticks]
+//
+// Tick rate of the unit accesses GameEnv makes in a tick, with 1k and 10k units, for UnitStore and for the
+// map<UnitId, unique_ptr<Unit>> it replaced. The default 20x20 map does not fit that many units, so only the
+// unit table is exercised, the same way PostAct() and the AIs use it:
+//   - the bullets look up their targets (one bullet for every 10 units),
+//   - every unit runs a durative command, which looks the unit up and moves it,
+//   - each player's fog of war goes through its own units, and each AI goes through all of them,
+//   - 1% of the units die and as many are created (new ids), and the dead ones are dropped at the next tick.
+// Both tables have to end up with the same units in the same order.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "unit_store.h"
+
+using namespace std;
+using namespace std::chrono;
+
+typedef map<UnitId, unique_ptr<Unit>> UnitMap;
+
+static const int kNumPlayers = 2;
+
+static Unit make_unit(UnitId raw_id, PlayerId player_id) {
+    UnitProperty property;
+    property._hp = property._max_hp = 100;
+    property._vis_r = 5;
+    return Unit(0, Player::CombinePlayerId(raw_id, player_id), MELEE_ATTACKER, PointF(raw_id % 97, raw_id % 89), property);
+}
+
+// The map and the store, behind the same calls.
+static void add(UnitMap *units, const Unit &u) { units->emplace(u.GetId(), unique_ptr<Unit>(new Unit(u))); }
+static void remove(UnitMap *units, UnitId id) { units->erase(id); }
+static void compact(UnitMap *) { }
+static Unit *get(UnitMap *units, UnitId id) {
+    auto it = units->find(id);
+    return it == units->end() ? nullptr : it->second.get();
+}
+template <typename F>
+static void for_each(const UnitMap &units, PlayerId player_id, F f) {
+    for (const auto &p : units) {
+        if (Player::ExtractPlayerId(p.first) == player_id) f(*p.second);
+    }
+}
+template <typename F>
+static void for_each(const UnitMap &units, F f) {
+    for (const auto &p : units) f(*p.second);
+}
+
+static void add(UnitStore *units, const Unit &u) { units->Add(u); }
+static void remove(UnitStore *units, UnitId id) { units->Remove(id); }
+static void compact(UnitStore *units) { units->Compact(); }
+static Unit *get(UnitStore *units, UnitId id) { return units->Get(id); }
+template <typename F>
+static void for_each(const UnitStore &units, PlayerId player_id, F f) {
+    for (auto it = units.begin(player_id); it != units.end(player_id); ++it) f(*it);
+}
+template <typename F>
+static void for_each(const UnitStore &units, F f) {
+    for (const Unit &u : units) f(u);
+}
+
+// Returns ticks/sec, and the ids left at the end in *ids.
+template <typename Units>
+static double run(int num_units, int num_ticks, vector<UnitId> *ids) {
+    Units units;
+    mt19937 rng(num_units);
+    UnitId next_id = 0;
+    for (int i = 0; i < num_units; ++i, ++next_id) add(&units, make_unit(next_id, i % kNumPlayers));
+
+    vector<UnitId> alive, targets;
+    vector<const Unit *> seen;
+    float checksum = 0;
+
+    auto start = system_clock::now();
+    for (int t = 0; t < num_ticks; ++t) {
+        compact(&units);
+        alive.clear();
+        for_each(units, [&](const Unit &u) { alive.push_back(u.GetId()); });
+
+        // Bullets.
+        targets.clear();
+        for (size_t i = 0; i < alive.size() / 10; ++i) targets.push_back(alive[rng() % alive.size()]);
+        for (UnitId id : targets) {
+            const Unit *u = get(&units, id);
+            if (u != nullptr) checksum += u->GetPointF().x;
+        }
+
+        // Durative commands.
+        for (UnitId id : alive) {
+            Unit *u = get(&units, id);
+            PointF p = u->GetPointF();
+            p.x += 0.1;
+            u->SetPointF(p);
+            u->GetProperty().CD(CD_MOVE).Start(t);
+        }
+
+        // Fog of war, then the AIs.
+        for (PlayerId player_id = 0; player_id < kNumPlayers; ++player_id) {
+            for_each(units, player_id, [&](const Unit &u) { checksum += u.GetProperty()._vis_r; });
+        }
+        for (PlayerId player_id = 0; player_id < kNumPlayers; ++player_id) {
+            seen.clear();
+            for_each(units, [&](const Unit &u) { seen.push_back(&u); });
+            checksum += seen.size();
+        }
+
+        // Deaths and births.
+        for (int i = 0; i < num_units / 100; ++i) {
+            remove(&units, alive[rng() % alive.size()]);
+            add(&units, make_unit(next_id, next_id % kNumPlayers));
+            next_id ++;
+        }
+    }
+    double secs = duration<double>(system_clock::now() - start).count();
+
+    ids->clear();
+    for_each(units, [&](const Unit &u) { ids->push_back(u.GetId()); });
+    if (checksum < 0) cout << checksum << endl;
+    return num_ticks / secs;
+}
+
+int main(int argc, char *argv[]) {
+    const int num_ticks = argc > 1 ? atoi(argv[1]) : 1000;
+
+    for (int num_units : { 1000, 10000 }) {
+        vector<UnitId> map_ids, store_ids;
+        const double map_rate = run<UnitMap>(num_units, num_ticks, &map_ids);
+        const double store_rate = run<UnitStore>(num_units, num_ticks, &store_ids);
+        if (map_ids != store_ids) {
+            cout << num_units << " units: the map and the store do not have the same units!" << endl;
+            return 1;
+        }
+        cout << num_units << " units, " << num_ticks << " ticks: map " << map_rate << " ticks/sec, store "
+             << store_rate << " ticks/sec (" << store_rate / map_rate << "x)" << endl;
+    }
+    return 0;
+}
@@ -11,6 +11,7 @@
 
 #include "common.h"
 #include "unit.h"
+#include "unit_store.h"
 
 // The class is used for flying bullets for long-range attacker and other visual effects,
 // E.g., visualization showing a unit is casting a spell (and can be interrupted before it is finished).
@@ -58,7 +59,7 @@ public:
 
     // Unlike Unit, we don't do Act then PerformAct since collision check is not needed.
     // The bullet will deliver microcommand (to inflict damage and other special effects, e.g., slow-down/healing).
-    CmdBPtr Forward(const RTSMap &m, const Units& units);
+    CmdBPtr Forward(const RTSMap &m, const UnitStore &units);
 
     // The bullet is dead and needs to be removed.
     bool IsDead() const { return _state == BULLET_DONE; }
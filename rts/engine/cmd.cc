@@ -188,7 +188,7 @@ bool CmdRemove::run(GameEnv *env, CmdReceiver* receiver) {
 bool CmdLoadMap::run(GameEnv *env, CmdReceiver*) {
     serializer::loader loader(false);
     if (! loader.read_from_file(_s)) return false;
-    loader >> env->GetMap();
+    env->LoadMap(loader);
     return true;
 }
 
@@ -128,6 +128,8 @@ public:
         return ss.str();
     }
 
+    std::unique_ptr<CmdBase> clone() const override { return std::unique_ptr<CmdBase>(new CmdDurative(*this)); }
+
     virtual ~CmdDurative() { }
 
     SERIALIZER_DERIVED(CmdDurative, CmdBase, _done);
@@ -145,6 +147,8 @@ public:
     explicit CmdImmediate(Tick t, UnitId id) : CmdBase(t, id) { }
     bool Run(GameEnv* env, CmdReceiver *receiver){ return run(env, receiver); }
 
+    std::unique_ptr<CmdBase> clone() const override { return std::unique_ptr<CmdBase>(new CmdImmediate(*this)); }
+
     virtual ~CmdImmediate() { }
 
     SERIALIZER_DERIVED0(CmdImmediate, CmdBase);
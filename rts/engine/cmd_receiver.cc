@@ -183,12 +183,32 @@ void CmdReceiver::LoadCmdReceiver(serializer::loader &loader) {
     // Set the failed_moves.
     _stats.SetTick(_tick);
 
-    // load durative cmd queue. Note that the priority queue is opaque so we need some hacks.
-    int size = _durative_cmd_queue.size();
-    const CmdDPtr *c = &(_durative_cmd_queue.top());
+    reset_unit_durative_cmd();
+}
+
+void CmdReceiver::CopyCmdReceiver(const CmdReceiver &receiver) {
+    _tick = receiver._tick;
+    _verbose_player_id = receiver._verbose_player_id;
+    _verbose_choice = receiver._verbose_choice;
+
+    // Push the clones in the storage order of the source, as the loader does, so that both queues end up
+    // with the same layout.
+    _immediate_cmd_queue = p_queue<CmdIPtr>();
+    for (const CmdIPtr &cmd : receiver._immediate_cmd_queue.container()) {
+        _immediate_cmd_queue.push(CmdIPtr(static_cast<CmdImmediate *>(cmd->clone().release())));
+    }
+    _durative_cmd_queue = p_queue<CmdDPtr>();
+    for (const CmdDPtr &cmd : receiver._durative_cmd_queue.container()) {
+        _durative_cmd_queue.push(CmdDPtr(static_cast<CmdDurative *>(cmd->clone().release())));
+    }
+
+    _stats.SetTick(_tick);
+    reset_unit_durative_cmd();
+}
+
+void CmdReceiver::reset_unit_durative_cmd() {
     _unit_durative_cmd.clear();
-    for (int i = 0; i < size; ++i) {
-        const CmdDPtr &curr = c[i];
+    for (const CmdDPtr &curr : _durative_cmd_queue.container()) {
         if (! curr->IsDone()) _unit_durative_cmd.insert(make_pair(curr->id(), curr.get()));
     }
 }
@@ -84,6 +84,9 @@ private:
         else return false;
     }
 
+    // Index the durative commands that are not done by unit.
+    void reset_unit_durative_cmd();
+
 public:
     CmdReceiver()
         : _tick(0), _cmd_next_id(0), _cmd_dumper(nullptr), _save_to_history(true),
@@ -148,6 +151,8 @@ public:
     // No SERIALIZER(...) is needed.
     void SaveCmdReceiver(serializer::saver &saver) const;
     void LoadCmdReceiver(serializer::loader &loader);
+    // Same as a Save followed by a Load, but copies the commands directly.
+    void CopyCmdReceiver(const CmdReceiver &receiver);
 
     ~CmdReceiver() { }
 };
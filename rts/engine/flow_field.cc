@@ -0,0 +1,144 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include "flow_field.h"
+#include "map.h"
+
+const int FlowField::kUnreachable;
+
+void FlowFields::check_size(const RTSMap &m) {
+    if ((int)_obstacles.size() != m.GetPlaneSize()) {
+        _obstacles.assign(m.GetPlaneSize(), 0);
+        _fields.clear();
+    }
+}
+
+bool FlowFields::passable(const RTSMap &m, Loc l) const {
+    return _obstacles[l] == 0 && m(l).type != IMPASSABLE;
+}
+
+int FlowFields::neighbors(const RTSMap &m, Loc l, Loc *nn) const {
+    const int dx[] = { 1, 0, -1, 0 };
+    const int dy[] = { 0, 1, 0, -1 };
+
+    Coord c = m.GetCoord(l);
+    int n = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (m.IsIn(c.x + dx[i], c.y + dy[i])) nn[n++] = m.GetLoc(c.x + dx[i], c.y + dy[i]);
+    }
+    return n;
+}
+
+FlowField *FlowFields::mutable_field(std::shared_ptr<FlowField> &field) {
+    if (field.use_count() > 1) field = std::make_shared<FlowField>(*field);
+    return field.get();
+}
+
+std::shared_ptr<const FlowField> FlowFields::Get(const RTSMap &m, Loc target) {
+    check_size(m);
+    auto it = _fields.find(target);
+    if (it != _fields.end()) return it->second;
+
+    if (_fields.size() >= kMaxFields) _fields.clear();
+
+    // Breadth-first from the target. The target itself is always reachable, even if it is blocked.
+    std::shared_ptr<FlowField> field = std::make_shared<FlowField>();
+    field->target = target;
+    field->dist.assign(m.GetPlaneSize(), FlowField::kUnreachable);
+    std::vector<int> &dist = field->dist;
+
+    std::vector<Loc> q;
+    q.reserve(m.GetPlaneSize());
+    q.push_back(target);
+    dist[target] = 0;
+    Loc nn[4];
+    for (size_t i = 0; i < q.size(); ++i) {
+        const Loc l = q[i];
+        const int n = neighbors(m, l, nn);
+        for (int j = 0; j < n; ++j) {
+            if (dist[nn[j]] != FlowField::kUnreachable || ! passable(m, nn[j])) continue;
+            dist[nn[j]] = dist[l] + 1;
+            q.push_back(nn[j]);
+        }
+    }
+
+    _fields.emplace(target, field);
+    return field;
+}
+
+void FlowFields::AddObstacle(const RTSMap &m, Loc l) {
+    check_size(m);
+    if (_obstacles[l] ++ > 0) return;
+
+    Loc nn[4], nn2[4];
+    const int n = neighbors(m, l, nn);
+    for (auto it = _fields.begin(); it != _fields.end(); ) {
+        const std::vector<int> &dist = it->second->dist;
+        if (l == it->second->target || dist[l] == FlowField::kUnreachable) {
+            ++it;
+            continue;
+        }
+
+        // The distances stay the same if every location that comes after l has another way to go.
+        bool cut = false;
+        for (int i = 0; i < n && ! cut; ++i) {
+            if (dist[nn[i]] != dist[l] + 1) continue;
+            cut = true;
+            const int n2 = neighbors(m, nn[i], nn2);
+            for (int j = 0; j < n2; ++j) {
+                if (nn2[j] != l && dist[nn2[j]] == dist[l]) {
+                    cut = false;
+                    break;
+                }
+            }
+        }
+
+        if (cut) {
+            it = _fields.erase(it);
+        } else {
+            mutable_field(it->second)->dist[l] = FlowField::kUnreachable;
+            ++it;
+        }
+    }
+}
+
+void FlowFields::RemoveObstacle(const RTSMap &m, Loc l) {
+    check_size(m);
+    if (_obstacles[l] == 0 || -- _obstacles[l] > 0 || m(l).type == IMPASSABLE) return;
+
+    Loc nn[4];
+    std::vector<Loc> q;
+    for (auto &p : _fields) {
+        const std::vector<int> &dist = p.second->dist;
+        if (l == p.second->target) continue;
+
+        int d = FlowField::kUnreachable;
+        const int n = neighbors(m, l, nn);
+        for (int i = 0; i < n; ++i) {
+            if (dist[nn[i]] != FlowField::kUnreachable && (d == FlowField::kUnreachable || dist[nn[i]] + 1 < d)) {
+                d = dist[nn[i]] + 1;
+            }
+        }
+        if (d == FlowField::kUnreachable) continue;
+
+        // Paths can only get shorter, starting from l.
+        std::vector<int> &new_dist = mutable_field(p.second)->dist;
+        new_dist[l] = d;
+        q.assign(1, l);
+        for (size_t i = 0; i < q.size(); ++i) {
+            const Loc curr = q[i];
+            const int n = neighbors(m, curr, nn);
+            for (int j = 0; j < n; ++j) {
+                const int dd = new_dist[nn[j]];
+                if ((dd != FlowField::kUnreachable && dd <= new_dist[curr] + 1) || ! passable(m, nn[j])) continue;
+                new_dist[nn[j]] = new_dist[curr] + 1;
+                q.push_back(nn[j]);
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#ifndef _FLOW_FIELD_H_
+#define _FLOW_FIELD_H_
+
+#include <map>
+#include <memory>
+#include <vector>
+#include "common.h"
+
+class RTSMap;
+
+// Path length (4-neighbor moves) from every location of the map to a target location.
+// Impassable terrain and buildings block the way, other units do not.
+struct FlowField {
+    static const int kUnreachable = -1;
+
+    Loc target;
+    std::vector<int> dist;
+};
+
+// The flow fields of a map, one per target location, shared by all the units going there.
+// A field is computed the first time a unit asks for it, and is kept up to date when buildings appear or
+// die: a new building only drops the fields in which it cuts a shortest path, and a removed building
+// shortens the paths around it in place.
+//
+// Copies of a map share the fields until one of them changes them (copy on write).
+class FlowFields {
+public:
+    std::shared_ptr<const FlowField> Get(const RTSMap &m, Loc target);
+
+    // A building is added to or removed from location l.
+    void AddObstacle(const RTSMap &m, Loc l);
+    void RemoveObstacle(const RTSMap &m, Loc l);
+
+    // Drop all fields, e.g., when the terrain changes.
+    void Invalidate() { _fields.clear(); }
+    // Drop the obstacles too.
+    void Clear() { _fields.clear(); _obstacles.clear(); }
+
+    size_t size() const { return _fields.size(); }
+
+private:
+    // Past this, all fields are dropped and computed again when they are needed.
+    static const size_t kMaxFields = 256;
+
+    // Number of buildings at each location.
+    std::vector<uint16_t> _obstacles;
+    std::map<Loc, std::shared_ptr<FlowField>> _fields;
+
+    void check_size(const RTSMap &m);
+    bool passable(const RTSMap &m, Loc l) const;
+    // The 4 neighbors of l that are in the map.
+    int neighbors(const RTSMap &m, Loc l, Loc *nn) const;
+    FlowField *mutable_field(std::shared_ptr<FlowField> &field);
+};
+
+#endif
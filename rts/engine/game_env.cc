@@ -77,6 +77,37 @@ void GameEnv::LoadSnapshot(serializer::loader &loader) {
     loader >> _winner_id;
     loader >> _terminated;
 
+    for (auto &player : _players) {
+        player.ResetMap(_map.get());
+    }
+    add_buildings();
+}
+
+void GameEnv::LoadMap(serializer::loader &loader) {
+    loader >> *_map;
+    _map->ClearBuildings();
+    add_buildings();
+}
+
+// The map does not save where the buildings are.
+void GameEnv::add_buildings() {
+    for (const Unit &u : _units) {
+        if (_gamedef.IsUnitTypeBuilding(u.GetUnitType())) _map->AddBuilding(u.GetPointF());
+    }
+}
+
+void GameEnv::CopySnapshot(const GameEnv &env) {
+    _next_unit_id = env._next_unit_id;
+
+    if (_map == nullptr) _map.reset(new RTSMap(*env._map));
+    else *_map = *env._map;
+
+    _units = env._units;
+    _bullets = env._bullets;
+    _players = env._players;
+    _winner_id = env._winner_id;
+    _terminated = env._terminated;
+
     for (auto &player : _players) {
         player.ResetMap(_map.get());
     }
@@ -85,10 +116,10 @@ void GameEnv::LoadSnapshot(serializer::loader &loader) {
 // Compute the hash code.
 uint64_t GameEnv::CurrentHashCode() const {
     uint64_t code = 0;
-    for (auto it = _units.begin(); it != _units.end(); ++it) {
-        serializer::hash_combine(code, it->first);
-        serializer::hash_combine(code, *it->second);
-        // cout << "Unit: " << it->first << ": #hash = " << this_code << ", " << it->second->GetProperty().CD(CD_ATTACK).PrintInfo() << endl;
+    for (const Unit &u : _units) {
+        serializer::hash_combine(code, u.GetId());
+        serializer::hash_combine(code, u);
+        // cout << "Unit: " << u.GetId() << ": #hash = " << this_code << ", " << u.GetProperty().CD(CD_ATTACK).PrintInfo() << endl;
         // code ^= this_code;
     }
     // Players.
@@ -104,18 +135,19 @@ bool GameEnv::AddUnit(Tick tick, UnitType type, const PointF &p, PlayerId player
     // cout << "Actual adding unit." << endl;
 
     UnitId new_id = Player::CombinePlayerId(_next_unit_id, player_id);
-    Unit *new_unit = new Unit(tick, new_id, type, p, _gamedef.unit(type)._property);
-    _units.insert(make_pair(new_id, unique_ptr<Unit>(new_unit)));
+    _units.Add(Unit(tick, new_id, type, p, _gamedef.unit(type)._property));
     _map->AddUnit(new_id, p);
+    if (_gamedef.IsUnitTypeBuilding(type)) _map->AddBuilding(p);
 
     _next_unit_id ++;
     return true;
 }
 
 bool GameEnv::RemoveUnit(const UnitId &id) {
-    auto it = _units.find(id);
-    if (it == _units.end()) return false;
-    _units.erase(it);
+    const Unit *u = _units.Get(id);
+    if (u == nullptr) return false;
+    if (_gamedef.IsUnitTypeBuilding(u->GetUnitType())) _map->RemoveBuilding(u->GetPointF());
+    _units.Remove(id);
 
     _map->RemoveUnit(id);
     return true;
@@ -123,8 +155,8 @@ bool GameEnv::RemoveUnit(const UnitId &id) {
 
 UnitId GameEnv::FindClosestBase(PlayerId player_id) const {
     // Find closest base. [TODO]: Not efficient here.
-    for (auto it = _units.begin(); it != _units.end(); ++it) {
-        const Unit *u = it->second.get();
+    for (const Unit &unit : _units) {
+        const Unit *u = &unit;
         if ((u->GetUnitType() == BASE || u->GetUnitType() == FLAG_BASE) && u->GetPlayerId() == player_id) {
             return u->GetId();
         }
@@ -134,8 +166,8 @@ UnitId GameEnv::FindClosestBase(PlayerId player_id) const {
 
 PlayerId GameEnv::CheckBase(UnitType base_type) const{
     PlayerId last_player_has_base = INVALID;
-    for (auto it = _units.begin(); it != _units.end(); ++it) {
-        const Unit *u = it->second.get();
+    for (const Unit &unit : _units) {
+        const Unit *u = &unit;
         if (u->GetUnitType() == base_type) {
             if (last_player_has_base == INVALID) {
                 last_player_has_base = u->GetPlayerId();
@@ -234,6 +266,9 @@ bool GameEnv::FindClosestPlaceWithDistance(const PointF &p, int dist,
 }
 
 void GameEnv::Forward(CmdReceiver *receiver) {
+    // Nothing holds a unit pointer from one tick to the next, so the dead units can go now.
+    _units.Compact();
+
     // Compute all bullets.
     set<int> done_bullets;
     for (size_t i = 0; i < _bullets.size(); ++i) {
@@ -279,7 +314,7 @@ int GameEnv::GetPrevSeenCount(PlayerId player_id) const {
             Loc loc = _map->GetLoc(x, y);
             const Fog &f = player.GetFog(loc);
             if (f.CanSeeTerrain()) continue;
-            for (const Unit &u : f.seen_units()) {
+            for (const SeenUnit &u : f.seen_units()) {
                 // cout << u.PrintInfo(*_map) << endl;
                 unit_ids.insert(u.GetId());
             }
@@ -11,6 +11,7 @@
 
 #include "cmd_receiver.h"
 #include "unit.h"
+#include "unit_store.h"
 #include "bullet.h"
 #include "map.h"
 #include "player.h"
@@ -27,8 +28,8 @@ private:
     // Next unit_id, initialized to be 0
     UnitId _next_unit_id;
 
-    // Unit hash tables.
-    Units _units;
+    // Units, in the order of their ids.
+    UnitStore _units;
 
     // Bullet tables.
     Bullets _bullets;
@@ -49,6 +50,8 @@ private:
     // This happens if the time tick exceeds max_tick, or there is anything wrong.
     bool _terminated;
 
+    void add_buildings();
+
 public:
     GameEnv();
 
@@ -84,8 +87,11 @@ public:
     // Generate a maze used by Tower Defense.
     bool GenerateTDMaze();
 
-    const Units& GetUnits() const { return _units; }
-    Units& GetUnits() { return _units; }
+    // Replace the map by one saved with CmdSaveMap. The units stay.
+    void LoadMap(serializer::loader &loader);
+
+    const UnitStore& GetUnits() const { return _units; }
+    UnitStore& GetUnits() { return _units; }
 
     // Initialize different units for this game.
     void InitGameDef() {
@@ -94,22 +100,9 @@ public:
     const GameDef &GetGameDef() const { return _gamedef; }
 
     // Get a unit from its Id.
-    const Unit *GetUnit(UnitId id) const {
-        const Unit *target = nullptr;
-        if (id != INVALID) {
-            auto it = _units.find(id);
-            if (it != _units.end()) target = it->second.get();
-        }
-        return target;
-    }
-    Unit *GetUnit(UnitId id) {
-        Unit *target = nullptr;
-        if (id != INVALID) {
-            auto it = _units.find(id);
-            if (it != _units.end()) target = it->second.get();
-        }
-        return target;
-    }
+    // The pointer is valid until the next AddUnit or Forward, which may move the units (see UnitStore).
+    const Unit *GetUnit(UnitId id) const { return _units.Get(id); }
+    Unit *GetUnit(UnitId id) { return _units.Get(id); }
 
     // Find the closest base.
     UnitId FindClosestBase(PlayerId player_id) const;
@@ -134,6 +127,8 @@ public:
     }
 
     // Add and remove units.
+    // Adding a unit may move the other units of its player: no pointer from GetUnit or GetUnits may be
+    // held across it.
     bool AddUnit(Tick tick, UnitType type, const PointF &p, PlayerId player_id);
     bool RemoveUnit(const UnitId &id);
 
@@ -169,6 +164,9 @@ public:
 
     void SaveSnapshot(serializer::saver &saver) const;
     void LoadSnapshot(serializer::loader &loader);
+    // Same as a SaveSnapshot followed by a LoadSnapshot, without going through the serializer.
+    // The map slots are shared with env until either map is regenerated.
+    void CopySnapshot(const GameEnv &env);
 
     // Compute the hash code.
     uint64_t CurrentHashCode() const;
@@ -193,7 +191,7 @@ public:
         return _player_id == INVALID || _env.GetPlayer(_player_id).FilterWithFOW(u);
     }
     // [TODO] This violates the behavior of Aspect. Will need to change. 
-    const Units &GetAllUnits() const { return _env.GetUnits(); }
+    const UnitStore &GetAllUnits() const { return _env.GetUnits(); }
     const Player &GetPlayer() const { return _env.GetPlayer(_player_id); }
     const GameDef &GetGameDef() const { return _env.GetGameDef(); }
 
@@ -207,8 +205,7 @@ public:
     enum Type { ALL = 0, BUILDING, MOVING }; 
 
     UnitIterator(const GameEnvAspect &aspect, Type type)
-        : _aspect(aspect), _type(type) {
-            _it = _aspect.GetAllUnits().begin();
+        : _aspect(aspect), _type(type), _it(aspect.GetAllUnits().begin()) {
             next();
         }
     UnitIterator(const UnitIterator &i) 
@@ -222,7 +219,7 @@ public:
     }
 
     const Unit &operator *() {
-        return *_it->second;
+        return *_it;
     }
 
     bool end() const { return _it == _aspect.GetAllUnits().end(); }
@@ -230,11 +227,11 @@ public:
 private:
     const GameEnvAspect &_aspect;
     Type _type;
-    Units::const_iterator _it;
+    UnitStore::const_iterator _it;
 
     void next() {
         while (_it != _aspect.GetAllUnits().end()) {
-            const Unit &u = *_it->second;
+            const Unit &u = *_it;
             if (_aspect.FilterWithFOW(u)) {
                 if (_type == ALL) break;
 
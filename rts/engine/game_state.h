@@ -40,10 +40,11 @@ public:
         _env.InitGameDef();
         *this = s;
     }
+    // Gives the same state as s.Save() and Load(), but copies the members directly.
     RTSState &operator=(const RTSState &s) {
-        string str;
-        s.Save(&str);
-        Load(str);
+        if (this == &s) return *this;
+        _env.CopySnapshot(s._env);
+        _cmd_receiver.CopyCmdReceiver(s._cmd_receiver);
         return *this;
     }
 
@@ -9,6 +9,7 @@
 #ifndef _LOCALITY_SEARCH_H_
 #define _LOCALITY_SEARCH_H_
 
+#include <algorithm>
 #include <limits>
 #include <set>
 #include <sstream>
@@ -18,6 +19,10 @@
 
 #include <iostream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "common.h"
 
 struct LineResult {
@@ -106,21 +111,71 @@ struct LineCoeff {
     }
 };
 
+// Circles (key, center, radius) on a plane, for collision checks and lookups by location.
+// The area is cut into buckets of twice the largest radius. The entries are kept in flat arrays sorted by
+// bucket, and are updated in place when they move, so a query only goes through a few contiguous ranges.
 template <typename T>
 class LocalitySearch {
 private:
+    // Entries stored column by column, so that the queries can test several of them at once.
+    struct Entries {
+        std::vector<T> keys;
+        std::vector<float> xs, ys, rs;
+
+        int size() const { return keys.size(); }
+        PointF p(int i) const { return PointF(xs[i], ys[i]); }
+
+        void push_back(const T& key, const PointF& p, float r) {
+            keys.push_back(key);
+            xs.push_back(p.x);
+            ys.push_back(p.y);
+            rs.push_back(r);
+        }
+        void pop_back() {
+            keys.pop_back();
+            xs.pop_back();
+            ys.pop_back();
+            rs.pop_back();
+        }
+        void copy(int from, int to) {
+            keys[to] = keys[from];
+            xs[to] = xs[from];
+            ys[to] = ys[from];
+            rs[to] = rs[from];
+        }
+        void set(int i, const T& key, const PointF& p, float r) {
+            keys[i] = key;
+            xs[i] = p.x;
+            ys[i] = p.y;
+            rs[i] = r;
+        }
+        void clear() {
+            keys.clear();
+            xs.clear();
+            ys.clear();
+            rs.clear();
+        }
+
+        SERIALIZER(Entries, keys, xs, ys, rs);
+    };
+
     PointF _pmin;
     PointF _pmax;
     float _margin;
+    // Number of buckets along x and y.
     int _n;
     int _m;
 
-    using Loc = std::pair<PointF, float>;
-    using KeysToLocs = std::unordered_map<T, Loc>;
-    // If memory usage is an issue, we can store iterator in the grid instead
-    KeysToLocs _keys2locs;
-    KeysToLocs _irreg_keys2locs;
-    std::vector<std::vector<KeysToLocs>> _grid;
+    // The entries that fit in a bucket, sorted by bucket (x bucket * _m + y bucket). Bucket b has the entries
+    // [_bucket_start[b], _bucket_start[b + 1]), so the 3 buckets of a column of a 3x3 neighborhood are
+    // contiguous too.
+    std::vector<int> _bucket_start;
+    Entries _grid;
+    // The others (out of the area, or larger than a bucket).
+    Entries _irreg;
+
+    // Key -> index in _grid, or -1 - index in _irreg. Not saved.
+    std::unordered_map<T, int> _key2idx;
 
     int GetXBucket(float x) const {
         return static_cast<int>((x - _pmin.x) / _margin);
@@ -138,39 +193,206 @@ private:
         return GetYBucket(p.y);
     }
 
+    int GetBucket(const PointF& p) const {
+        return GetXBucket(p) * _m + GetYBucket(p);
+    }
+
     bool IsRegular(const PointF& p, const float radius) const {
         return 2 * radius < _margin + std::numeric_limits<float>::epsilon()
             && p.IsIn(_pmin, _pmax);
     }
 
-    static bool CheckCollision(const Loc& loc1, const Loc& loc2) {
-      const float dist_sqr = PointF::L2Sqr(loc1.first, loc2.first);
-      const float sum_dist = loc1.second + loc2.second;
-      return dist_sqr < sum_dist * sum_dist;
+    // Entries [begin, end) of the buckets (x_i, y0) to (x_i, y1), clipped to the grid.
+    bool bucket_range(int x_i, int y0, int y1, int *begin, int *end) const {
+        if (x_i < 0 || x_i >= _n) return false;
+        y0 = std::max(y0, 0);
+        y1 = std::min(y1, _m - 1);
+        if (y0 > y1) return false;
+        *begin = _bucket_start[x_i * _m + y0];
+        *end = _bucket_start[x_i * _m + y1 + 1];
+        return *begin < *end;
     }
 
-    bool _line_passable(const LineCoeff &c, int x_ind, int y_ind, T* id, LineResult* result) const {
-        if (x_ind < 0 || x_ind >= _m || y_ind < 0 || y_ind >= _n) return true;
-        for (const auto& item : _grid[x_ind][y_ind]) {
-            if (! c.IsPassable(item.second.first, item.second.second, result)) {
-                if (id) *id = item.first;
-                return false;
+    // Put an entry at the end of bucket b. Each later bucket hands its first entry over to the free slot
+    // after its end, so only the non-empty buckets in between move an entry.
+    void grid_insert(int b, const T& key, const PointF& p, float r) {
+        const int num_buckets = _n * _m;
+        int hole = _grid.size();
+        _grid.push_back(key, p, r);
+        for (int c = num_buckets - 1; c > b; --c) {
+            if (_bucket_start[c] < _bucket_start[c + 1]) {
+                _grid.copy(_bucket_start[c], hole);
+                _key2idx[_grid.keys[hole]] = hole;
             }
+            hole = _bucket_start[c];
+            _bucket_start[c + 1] ++;
         }
-        return true;
+        _bucket_start[b + 1] ++;
+        _grid.set(hole, key, p, r);
+        _key2idx[key] = hole;
     }
 
-    bool _line_irregular_passable(const LineCoeff &c, T* id, LineResult *result) const {
-        for (const auto& item : _irreg_keys2locs) {
-            // cout << "Check irregular " << item.second.first << " radius = " << item.second.second << endl;
-            if (! c.IsPassable(item.second.first, item.second.second, result)) {
-                if (id) *id = item.first;
+    // Remove entry i of bucket b, the reverse of grid_insert.
+    void grid_erase(int b, int i) {
+        const int num_buckets = _n * _m;
+        int hole = i;
+        for (int c = b; c < num_buckets; ++c) {
+            const int last = _bucket_start[c + 1] - 1;
+            if (c == b || _bucket_start[c] <= last) {
+                if (hole != last) {
+                    _grid.copy(last, hole);
+                    _key2idx[_grid.keys[hole]] = hole;
+                }
+                hole = last;
+            }
+            if (c > b) _bucket_start[c] --;
+        }
+        _bucket_start[num_buckets] --;
+        _grid.pop_back();
+    }
+
+    // Move entry i from bucket a to bucket b. Only the buckets in between are touched.
+    void grid_move(int a, int b, int i, const PointF& p) {
+        const T key = _grid.keys[i];
+        const float r = _grid.rs[i];
+        int hole = i;
+        if (a < b) {
+            // Free the last slot of a, then each bucket until b hands its last entry over to the slot before it.
+            for (int c = a; c < b; ++c) {
+                const int last = _bucket_start[c + 1] - 1;
+                if (c == a || _bucket_start[c] <= last) {
+                    if (hole != last) {
+                        _grid.copy(last, hole);
+                        _key2idx[_grid.keys[hole]] = hole;
+                    }
+                    hole = last;
+                }
+                _bucket_start[c + 1] --;
+            }
+        } else {
+            // Free the first slot of a, then each bucket down to b hands its first entry over to the slot after it.
+            for (int c = a; c > b; --c) {
+                const int first = _bucket_start[c];
+                if (c == a || first < _bucket_start[c + 1]) {
+                    if (hole != first) {
+                        _grid.copy(first, hole);
+                        _key2idx[_grid.keys[hole]] = hole;
+                    }
+                    hole = first;
+                }
+                _bucket_start[c] ++;
+            }
+        }
+        _grid.set(hole, key, p, r);
+        _key2idx[key] = hole;
+    }
+
+    void irreg_erase(int i) {
+        const int last = _irreg.size() - 1;
+        if (i != last) {
+            _irreg.copy(last, i);
+            _key2idx[_irreg.keys[i]] = -1 - i;
+        }
+        _irreg.pop_back();
+    }
+
+    void rebuild_index() {
+        _key2idx.clear();
+        for (int i = 0; i < _grid.size(); ++i) _key2idx[_grid.keys[i]] = i;
+        for (int i = 0; i < _irreg.size(); ++i) _key2idx[_irreg.keys[i]] = -1 - i;
+    }
+
+#ifdef __SSE2__
+    // Entries [i, i + 4) of v, the ones from end on are pad.
+    static __m128 load4(const std::vector<float> &v, int i, int end, float pad) {
+        if (i + 4 <= end) return _mm_loadu_ps(&v[i]);
+        float buf[4] = { pad, pad, pad, pad };
+        std::copy(v.begin() + i, v.begin() + end, buf);
+        return _mm_loadu_ps(buf);
+    }
+
+    // Squared distances from p to entries [i, i + 4). The last group is padded with entries at infinity, so
+    // that every entry goes through the same arithmetic, wherever it is stored.
+    static __m128 dist_sqr4(const Entries &e, int i, int end, const PointF& p) {
+        const float inf = std::numeric_limits<float>::infinity();
+        const __m128 dx = _mm_sub_ps(load4(e.xs, i, end, inf), _mm_set1_ps(p.x));
+        const __m128 dy = _mm_sub_ps(load4(e.ys, i, end, inf), _mm_set1_ps(p.y));
+        return _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    }
+#endif
+
+    // Whether an entry in [begin, end) other than key_exclude is closer to p than radius plus its own radius.
+    static bool collides(const Entries &e, int begin, int end, const PointF& p, float radius, const T& key_exclude) {
+#ifdef __SSE2__
+        const __m128 pr = _mm_set1_ps(radius);
+        for (int i = begin; i < end; i += 4) {
+            const __m128 sum_dist = _mm_add_ps(load4(e.rs, i, end, 0), pr);
+            const __m128 hit = _mm_cmplt_ps(dist_sqr4(e, i, end, p), _mm_mul_ps(sum_dist, sum_dist));
+            for (int mask = _mm_movemask_ps(hit); mask != 0; mask &= mask - 1) {
+                if (e.keys[i + __builtin_ctz(mask)] != key_exclude) return true;
+            }
+        }
+#else
+        for (int i = begin; i < end; ++i) {
+            const float sum_dist = e.rs[i] + radius;
+            if (PointF::L2Sqr(e.p(i), p) < sum_dist * sum_dist && e.keys[i] != key_exclude) return true;
+        }
+#endif
+        return false;
+    }
+
+    // The closest entry in [begin, end) that has p within its radius, if it is closer than *min_dist_sqr.
+    static int closest(const Entries &e, int begin, int end, const PointF& p, float *min_dist_sqr) {
+        int res = -1;
+#ifdef __SSE2__
+        for (int i = begin; i < end; i += 4) {
+            const __m128 dist_sqr = dist_sqr4(e, i, end, p);
+            const __m128 r = load4(e.rs, i, end, 0);
+            const __m128 in = _mm_and_ps(_mm_cmplt_ps(dist_sqr, _mm_mul_ps(r, r)), _mm_cmplt_ps(dist_sqr, _mm_set1_ps(*min_dist_sqr)));
+            int mask = _mm_movemask_ps(in);
+            if (mask == 0) continue;
+            float d[4];
+            _mm_storeu_ps(d, dist_sqr);
+            for (; mask != 0; mask &= mask - 1) {
+                const int k = __builtin_ctz(mask);
+                if (d[k] < *min_dist_sqr) {
+                    *min_dist_sqr = d[k];
+                    res = i + k;
+                }
+            }
+        }
+#else
+        for (int i = begin; i < end; ++i) {
+            const float dist_sqr = PointF::L2Sqr(e.p(i), p);
+            if (dist_sqr < e.rs[i] * e.rs[i] && dist_sqr < *min_dist_sqr) {
+                *min_dist_sqr = dist_sqr;
+                res = i;
+            }
+        }
+#endif
+        return res;
+    }
+
+    static bool line_passable(const Entries &e, int begin, int end, const LineCoeff &c, T* id, LineResult* result) {
+        for (int i = begin; i < end; ++i) {
+            if (! c.IsPassable(e.p(i), e.rs[i], result)) {
+                if (id) *id = e.keys[i];
                 return false;
             }
         }
         return true;
     }
 
+    bool _line_passable(const LineCoeff &c, int x_ind, int y_ind, T* id, LineResult* result) const {
+        int begin, end;
+        if (! bucket_range(x_ind, y_ind, y_ind, &begin, &end)) return true;
+        return line_passable(_grid, begin, end, c, id, result);
+    }
+
+    bool _line_irregular_passable(const LineCoeff &c, T* id, LineResult *result) const {
+        return line_passable(_irreg, 0, _irreg.size(), c, id, result);
+    }
+
 public:
     LocalitySearch() {};
 
@@ -181,53 +403,38 @@ public:
             : _pmin(pmin), _pmax(pmax), _margin(2 * max_radius) {
         _n = static_cast<int>((_pmax.x - _pmin.x + _margin) / _margin);
         _m = static_cast<int>((_pmax.y - _pmin.y + _margin) / _margin);
-        _grid.resize(_n, std::vector<KeysToLocs>(_m));
+        _bucket_start.assign(_n * _m + 1, 0);
     }
 
-    // Add location and key
+    // Add location and key. Nothing happens if the key is already there.
     void Add(const T& key, const PointF& p, const float radius) {
-        const auto loc = Loc(p, radius);
-        _keys2locs.emplace(key, loc);
+        if (Exists(key)) return;
         if (IsRegular(p, radius)) {
-            int x_i = GetXBucket(p);
-            int y_i = GetYBucket(p);
-            // cout << "Add " << p << " to (" << x_i << ", " << y_i << ")" << endl;
-            _grid[x_i][y_i].emplace(key, loc);
+            // cout << "Add " << p << " to (" << GetXBucket(p) << ", " << GetYBucket(p) << ")" << endl;
+            grid_insert(GetBucket(p), key, p, radius);
         } else {
-            // cout << "Add " << p << " to irregular spot" << " # size = " << _irreg_keys2locs.size() << endl;
-            _irreg_keys2locs.emplace(key, loc);
+            // cout << "Add " << p << " to irregular spot" << " # size = " << _irreg.size() << endl;
+            _key2idx[key] = -1 - _irreg.size();
+            _irreg.push_back(key, p, radius);
         }
     }
 
     bool Exists(const T& key) const {
-        return _keys2locs.find(key) != _keys2locs.end();
+        return _key2idx.find(key) != _key2idx.end();
     }
 
     bool IsEmpty(const PointF& p, const float radius,
         const T& key_exclude = INVALID) const {
-        const auto loc = Loc(p, radius);
         if (!IsRegular(p, radius)) {
-            for (const auto& item : _irreg_keys2locs) {
-                if (item.first == key_exclude) continue;
-                if (CheckCollision(loc, item.second)) {
-                    return false;
-                }
-            }
-            return true;
+            return ! collides(_irreg, 0, _irreg.size(), p, radius, key_exclude);
         }
         const int bx = GetXBucket(p);
         const int by = GetYBucket(p);
         // Explore 8 adjacent blocks as well
+        int begin, end;
         for (int dx = -1; dx <= 1; ++dx) {
-            if (bx + dx < 0 || bx + dx >= _n) continue;
-            for (int dy = -1; dy <= 1; ++dy) {
-                if (by + dy < 0 || by + dy >= _m) continue;
-                for (const auto& item : _grid[bx + dx][by + dy]) {
-                    if (item.first == key_exclude) continue;
-                    if (CheckCollision(loc, item.second)) {
-                        return false;
-                    }
-                }
+            if (bucket_range(bx + dx, by - 1, by + 1, &begin, &end) && collides(_grid, begin, end, p, radius, key_exclude)) {
+                return false;
             }
         }
         return true;
@@ -291,16 +498,30 @@ public:
 
     // Remove the entry.
     void Remove(const T& key) {
-        const auto it = _keys2locs.find(key);
-        if (it != _keys2locs.end()) {
-            const auto& p = it->second.first;
-            if (IsRegular(p, it->second.second)) {
-                _grid[GetXBucket(p)][GetYBucket(p)].erase(key);
-            } else {
-                _irreg_keys2locs.erase(key);
-            }
-            _keys2locs.erase(it);
+        const auto it = _key2idx.find(key);
+        if (it == _key2idx.end()) return;
+        const int i = it->second;
+        _key2idx.erase(it);
+        if (i >= 0) grid_erase(GetBucket(_grid.p(i)), i);
+        else irreg_erase(-1 - i);
+    }
+
+    // Same as Remove then Add with the same radius, but an entry that stays in its bucket is updated in place
+    // and one that goes to a nearby bucket only moves the buckets in between.
+    void Move(const T& key, const PointF& p) {
+        const auto it = _key2idx.find(key);
+        if (it == _key2idx.end()) return;
+        const int i = it->second;
+        const float radius = i >= 0 ? _grid.rs[i] : _irreg.rs[-1 - i];
+        if (i < 0 || ! IsRegular(p, radius)) {
+            Remove(key);
+            Add(key, p, radius);
+            return;
         }
+        const int a = GetBucket(_grid.p(i));
+        const int b = GetBucket(p);
+        if (a == b) _grid.set(i, key, p, radius);
+        else grid_move(a, b, i, p);
     }
 
     // Retrieval.
@@ -308,59 +529,89 @@ public:
     const T* Loc2Key(const PointF& p, float* const min_dist_sqr) const {
         const T* res = nullptr;
         float min_dist = std::numeric_limits<float>::max();
-        for (const auto& item : _keys2locs) {
-            const auto& q = item.second.first;
-            const float r = item.second.second;
-            const float dist_sqr = PointF::L2Sqr(p, q);
-            if (dist_sqr < r * r && dist_sqr < min_dist) {
-                res = &item.first;
-                min_dist = dist_sqr;
+        int i = closest(_irreg, 0, _irreg.size(), p, &min_dist);
+        if (i >= 0) res = &_irreg.keys[i];
+
+        if (p.IsIn(_pmin, _pmax)) {
+            // An entry of the grid is smaller than a bucket, so it can only contain p from a nearby bucket.
+            const int bx = GetXBucket(p);
+            const int by = GetYBucket(p);
+            int begin, end;
+            for (int dx = -1; dx <= 1; ++dx) {
+                if (! bucket_range(bx + dx, by - 1, by + 1, &begin, &end)) continue;
+                i = closest(_grid, begin, end, p, &min_dist);
+                if (i >= 0) res = &_grid.keys[i];
             }
+        } else {
+            i = closest(_grid, 0, _grid.size(), p, &min_dist);
+            if (i >= 0) res = &_grid.keys[i];
         }
         *min_dist_sqr = min_dist;
         return res;
     }
 
-    const PointF* Key2Loc(const T& key) const {
-        const auto it = _keys2locs.find(key);
-        return it == _keys2locs.end() ? nullptr : &it->second->first;
+    bool Key2Loc(const T& key, PointF *p) const {
+        const auto it = _key2idx.find(key);
+        if (it == _key2idx.end()) return false;
+        *p = it->second >= 0 ? _grid.p(it->second) : _irreg.p(-1 - it->second);
+        return true;
     }
 
     std::set<T> KeysInRegion(
         const PointF& left_top,
         const PointF& right_bottom) const {
         std::set<T> res;
-        for (const auto& item : _keys2locs) {
-            const auto& p = item.second.first;
-            if (p.IsIn(left_top, right_bottom)) {
-                res.insert(item.first);
+        for (int i = 0; i < _irreg.size(); ++i) {
+            if (_irreg.p(i).IsIn(left_top, right_bottom)) res.insert(_irreg.keys[i]);
+        }
+        if (left_top.x > right_bottom.x || left_top.y > right_bottom.y) return res;
+
+        const int x0 = std::max(GetXBucket(left_top), 0), x1 = std::min(GetXBucket(right_bottom), _n - 1);
+        const int y0 = GetYBucket(left_top), y1 = GetYBucket(right_bottom);
+        int begin, end;
+        for (int x_i = x0; x_i <= x1; ++x_i) {
+            if (! bucket_range(x_i, y0, y1, &begin, &end)) continue;
+            for (int i = begin; i < end; ++i) {
+                if (_grid.p(i).IsIn(left_top, right_bottom)) res.insert(_grid.keys[i]);
             }
         }
         return res;
     }
 
     void Clear() {
-        _keys2locs.clear();
-        _irreg_keys2locs.clear();
-        for (auto& row : _grid) {
-            for (auto& item : row) {
-                item.clear();
-            }
-        }
+        _grid.clear();
+        _irreg.clear();
+        _key2idx.clear();
+        std::fill(_bucket_start.begin(), _bucket_start.end(), 0);
     }
 
     std::string PrintDebugInfo() const {
         std::stringstream ss;
         ss << "Locality table: " << endl;
-        for (const auto& item : _keys2locs) {
-            ss << "Id " << item.first << " -> " << item.second.first << ", "
-                << item.second.second << std::endl;
+        for (const Entries *e : { &_grid, &_irreg }) {
+            for (int i = 0; i < e->size(); ++i) {
+                ss << "Id " << e->keys[i] << " -> " << e->p(i) << ", " << e->rs[i] << std::endl;
+            }
         }
         return ss.str();
     }
 
-    SERIALIZER(LocalitySearch,
-        _pmin, _pmax, _margin, _keys2locs, _irreg_keys2locs, _grid);
+    serializer::saver &Save(serializer::saver &oo) const {
+        serializer::Save(oo, _pmin, _pmax, _margin, _n, _m, _bucket_start, _grid, _irreg);
+        if (! oo.is_binary()) oo.get() << " ";
+        return oo;
+    }
+    serializer::loader &Load(serializer::loader &ii) {
+        serializer::Load(ii, _pmin, _pmax, _margin, _n, _m, _bucket_start, _grid, _irreg);
+        rebuild_index();
+        return ii;
+    }
+    friend serializer::saver &operator<<(serializer::saver &oo, const LocalitySearch &p) {
+        return p.Save(oo);
+    }
+    friend serializer::loader &operator>>(serializer::loader &ii, LocalitySearch& p) {
+        return p.Load(ii);
+    }
 };
 
 #endif
@@ -31,11 +31,11 @@ bool RTSMap::find_two_nearby_empty_slots(const std::function<uint16_t(int)>& f,
 }
 
 bool RTSMap::GenerateImpassable(const std::function<uint16_t(int)>& f, int nImpassable) {
-    _map.assign(_m * _n * _level, MapSlot());
+    reset_slots();
     for (int i = 0; i < nImpassable; ++i) {
         const int x = f(_m);
         const int y = f(_n);
-        _map[GetLoc(Coord(x, y))].type = IMPASSABLE;
+        SetTerrain(GetLoc(Coord(x, y)), IMPASSABLE);
     }
     return true;
 }
@@ -49,11 +49,11 @@ bool RTSMap::GenerateTDMaze(const std::function<uint16_t(int)>& f) {
     const int blank = 3;
     int m = _m / 2;
     int n = _n / 2;
-    _map.assign(_m * _n * _level, MapSlot());
+    reset_slots();
     for (int x = 0; x < _m; x++) {
         for (int y = 0; y < _n; y++) {
         if ((x < _m - blank * 2) || (y < _n - blank * 2))
-            _map[GetLoc(Coord(x, y))].type = IMPASSABLE;
+            SetTerrain(GetLoc(Coord(x, y)), IMPASSABLE);
         }
     }
     int maze[m * n];
@@ -99,8 +99,8 @@ bool RTSMap::GenerateTDMaze(const std::function<uint16_t(int)>& f) {
         maze[curr] = 1;
         int xc = curr / m;
         int yc = curr % m;
-        _map[GetLoc(Coord(xc * 2, yc * 2))].type = NORMAL;
-        _map[GetLoc(Coord(xc * 2 - dx[coming_from], yc * 2 - dy[coming_from]))].type = NORMAL;
+        SetTerrain(GetLoc(Coord(xc * 2, yc * 2)), NORMAL);
+        SetTerrain(GetLoc(Coord(xc * 2 - dx[coming_from], yc * 2 - dy[coming_from])), NORMAL);
         for (size_t i = 0; i < sizeof(dx) / sizeof(int); ++i) {
             int xn = xc + dx[i];
             int yn = yc + dy[i];
@@ -152,7 +152,7 @@ void RTSMap::load_default_map() {
     _m = 20;
     _n = 20;
     _level = 1;
-    _map.assign(_m * _n * _level, MapSlot());
+    reset_slots();
 }
 
 void RTSMap::precompute_all_pair_distances() {
@@ -174,8 +174,7 @@ bool RTSMap::MoveUnit(const UnitId &id, const PointF& new_p) {
     if (! _locality.Exists(id)) return false;
     if (! _locality.IsEmpty(new_p, kUnitRadius, id)) return false;
 
-    _locality.Remove(id);
-    _locality.Add(id, new_p, kUnitRadius);
+    _locality.Move(id, new_p);
     return true;
 }
 
@@ -245,7 +244,7 @@ string RTSMap::Draw() const {
         for (int i = 0; i < _m; ++i) {
             // Draw the map (only level 0)
             Loc loc = GetLoc(i, j, 0);
-            ss << _map[loc].type << " ";
+            ss << (*_map)[loc].type << " ";
         }
         ss << endl;
     }
@@ -10,8 +10,10 @@
 #define _MAP_H_
 
 #include <functional>
+#include <memory>
 #include <vector>
 #include "common.h"
+#include "flow_field.h"
 #include "locality_search.h"
 
 struct MapSlot {
@@ -43,7 +45,8 @@ struct PlayerMapInfo {
 // Map location is an integer.
 class RTSMap {
 private:
-  vector<MapSlot> _map;
+  // The slots do not change during a game, so copies of the map share them (copy on write).
+  std::shared_ptr<vector<MapSlot>> _map;
 
   // Size of the map.
   int _m, _n, _level;
@@ -54,8 +57,21 @@ private:
   // Locality search.
   LocalitySearch<UnitId> _locality;
 
+  // Path planning. Not saved: GameEnv puts the buildings back once loaded.
+  mutable FlowFields _flow_fields;
+
 private:
   void reset_intermediates();
+  // Fresh slots, not shared with any other map.
+  void reset_slots() {
+      _map = std::make_shared<vector<MapSlot>>(_m * _n * _level, MapSlot());
+      _flow_fields.Invalidate();
+  }
+  // Slots for writing, detached from the other maps first.
+  vector<MapSlot> &mutable_slots() {
+      if (_map.use_count() > 1) _map = std::make_shared<vector<MapSlot>>(*_map);
+      return *_map;
+  }
   void load_default_map();
   void precompute_all_pair_distances();
 
@@ -73,10 +89,17 @@ public:
 
 
   const vector<PlayerMapInfo> &GetPlayerMapInfo() const { return _infos; }
-  void ClearMap() { _infos.clear(); _locality.Clear();}
-
-  const MapSlot &operator()(const Loc& loc) const { return _map[loc]; }
-  MapSlot &operator()(const Loc& loc) { return _map[loc]; }
+  void ClearMap() { _infos.clear(); _locality.Clear(); _flow_fields.Clear(); }
+
+  const MapSlot &operator()(const Loc& loc) const { return (*_map)[loc]; }
+  // Writing a slot detaches the slots from the other maps. Use SetTerrain for the terrain type.
+  MapSlot &MutableSlot(const Loc& loc) { return mutable_slots()[loc]; }
+  // The flow fields are dropped only if the type changes.
+  void SetTerrain(const Loc& loc, Terrain type) {
+      if ((*_map)[loc].type == type) return;
+      mutable_slots()[loc].type = type;
+      _flow_fields.Invalidate();
+  }
 
   int GetXSize() const { return _m; }
   int GetYSize() const { return _n; }
@@ -88,7 +111,7 @@ public:
       if (! IsIn(c)) return false;
 
       Loc loc = GetLoc(c);
-      const MapSlot &s = _map[loc];
+      const MapSlot &s = (*_map)[loc];
       // cannot block the path
       if (s.type == NORMAL) return false;
 
@@ -101,7 +124,7 @@ public:
       if (! IsIn(c)) return false;
 
       Loc loc = GetLoc(c);
-      const MapSlot &s = _map[loc];
+      const MapSlot &s = (*_map)[loc];
       if (s.type == IMPASSABLE) return false;
 
       // [TODO] Add object radius here.
@@ -115,7 +138,7 @@ public:
       if (! IsIn(c)) return false;
 
       Loc loc = GetLoc(c);
-      const MapSlot &s = _map[loc];
+      const MapSlot &s = (*_map)[loc];
       if (s.type == IMPASSABLE) return false;
 
       // [TODO] Add object radius here.
@@ -136,6 +159,14 @@ public:
   bool AddUnit(const UnitId &id, const PointF& new_loc);
   bool RemoveUnit(const UnitId &id);
 
+  // Buildings block the paths given by GetFlowField.
+  // The map does not save them, so once it is loaded, they need to be added again.
+  void ClearBuildings() { _flow_fields.Clear(); }
+  void AddBuilding(const PointF &p) { _flow_fields.AddObstacle(*this, GetLoc(p)); }
+  void RemoveBuilding(const PointF &p) { _flow_fields.RemoveObstacle(*this, GetLoc(p)); }
+  // Shortest paths to target (see FlowFields).
+  std::shared_ptr<const FlowField> GetFlowField(Loc target) const { return _flow_fields.Get(*this, target); }
+
   // Coord transfer.
   string PrintCoord(Loc loc) const;
   Coord GetCoord(Loc loc) const;
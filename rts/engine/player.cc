@@ -8,29 +8,16 @@
 
 #include "player.h"
 #include "unit.h"
+#include "unit_store.h"
 
-#include <set>
-
-template <typename T>
-static bool GetValue(const map< pair<Loc, Loc>, T > &m, const Loc &p1, const Loc &p2, T *value) {
-    auto it = m.find(make_pair(p1, p2));
-    if (it != m.end()) {
-        *value = it->second;
-        return true;
-    }
-    return false;
+///////////// SeenUnit ///////////////////
+SeenUnit::SeenUnit(const Unit &u)
+    : _id(u.GetId()), _type(u.GetUnitType()), _p(u.GetPointF()), _last_p(u.GetLastPointF()),
+      _built_since(u.GetBuiltSince()), _hp(u.GetProperty()._hp), _max_hp(u.GetProperty()._max_hp) {
 }
 
-template <typename T>
-static void UpdateValue(const Loc &p1, const Loc &p2, const T& value, map< pair<Loc, Loc>, T > *m) {
-    pair<Loc, Loc> new_key(p1, p2);
-
-    auto it = m->find(new_key);
-    if (it != m->end()) {
-        it->second = value;
-    } else {
-        m->emplace(make_pair(std::move(new_key), value));
-    }
+PlayerId SeenUnit::GetPlayerId() const {
+    return Player::ExtractPlayerId(_id);
 }
 
 ///////////// Player ///////////////////
@@ -52,41 +39,100 @@ string Player::Draw() const {
     return ss.str();
 }
 
-void Player::ComputeFOW(const Units &units) {
+void Player::add_sight(Loc loc, int range, int delta) {
+    if (range < 0) return;
+    while ((int)_sight_stencils.size() <= range) {
+        const int r = _sight_stencils.size();
+        vector<int> stencil(2 * r + 1);
+        for (int dx = -r; dx <= r; ++dx) stencil[dx + r] = r - std::abs(dx);
+        _sight_stencils.push_back(std::move(stencil));
+    }
+    const vector<int> &stencil = _sight_stencils[range];
+
+    // Same region as RTSMap::GetSight.
+    const Coord c = _map->GetCoord(loc);
+    const int xmin = std::max(0, c.x - range);
+    const int xmax = std::min(_map->GetXSize() - 1, c.x + range);
+    for (int x = xmin; x <= xmax; ++x) {
+        const int h = stencil[x - c.x + range];
+        const int ymin = std::max(0, c.y - h);
+        const int ymax = std::min(_map->GetYSize() - 1, c.y + h);
+        for (int y = ymin; y <= ymax; ++y) {
+            const Loc l = _map->GetLoc(x, y);
+            uint16_t &count = _sight_count[l];
+            if (delta > 0 ? count == 0 : count == 1) _sight_changed.push_back(l);
+            count += delta;
+        }
+    }
+}
+
+void Player::ComputeFOW(const UnitStore &units) {
     // Compute the player's fog of war.
-    // Two approaches, loop on the map (or in the future, viewport [TODO]),
-    // or loop on the units.
-    // [TODO]: We could do better with LocalitySearch.
-    // Clear fogs.
-    for (Fog &f : _fogs) {
-        f.MakeInvisible();
+    // Each location counts the player's units that see it. Only the units that moved to another location
+    // (or appeared, died, or changed their sight range) update the counts, and only the locations whose
+    // count went from or to 0 change their fog.
+    const bool rebuild = _sight_count.size() != _fogs.size();
+    if (rebuild) {
+        _sight_count.assign(_fogs.size(), 0);
+        _sight_sources.clear();
+        _seen_locs.clear();
     }
+    _sight_changed.clear();
 
-    // First pass, get the fog region.
-    set<Loc> clear_regions;
-    for (auto it = units.begin(); it != units.end(); ++it) {
-        const Unit *u = it->second.get();
-        if (ExtractPlayerId(u->GetId()) == _player_id) {
-            const int vis_r = u->GetProperty()._vis_r;
-            Loc l = _map->GetLoc(u->GetPointF());
-            for (const Loc &loc : _map->GetSight(l, vis_r)) {
-                clear_regions.insert(loc);
+    // First pass, update the counts. Both units and _sight_sources are sorted by id.
+    _next_sight_sources.clear();
+    auto src = _sight_sources.begin();
+    for (auto it = units.begin(_player_id); it != units.end(_player_id); ++it) {
+        const Unit *u = &*it;
+
+        for (; src != _sight_sources.end() && src->id < u->GetId(); ++src) {
+            add_sight(src->loc, src->range, -1);
+        }
+        SightSource s{ u->GetId(), _map->GetLoc(u->GetPointF()), u->GetProperty()._vis_r };
+        if (src != _sight_sources.end() && src->id == u->GetId()) {
+            if (src->loc != s.loc || src->range != s.range) {
+                add_sight(src->loc, src->range, -1);
+                add_sight(s.loc, s.range, 1);
             }
+            ++src;
+        } else {
+            add_sight(s.loc, s.range, 1);
         }
+        _next_sight_sources.push_back(s);
+    }
+    for (; src != _sight_sources.end(); ++src) {
+        add_sight(src->loc, src->range, -1);
     }
+    _sight_sources.swap(_next_sight_sources);
 
-    // Clear these fog unit.
-    for (const Loc &l : clear_regions) {
-        _fogs[l].SetClear();
+    // Clear the fog of the locations that come into sight, and put it back on the ones that go out of sight.
+    auto update_fog = [&](Loc l) {
+        Fog &f = _fogs[l];
+        if (_sight_count[l] > 0) {
+            if (rebuild || f._fog != 0) f.SetClear();
+        } else {
+            f.MakeInvisible();
+        }
+    };
+    if (rebuild) {
+        for (Loc l = 0; l < (Loc)_fogs.size(); ++l) update_fog(l);
+    } else {
+        for (const Loc &l : _sight_changed) update_fog(l);
     }
 
     // Second pass, remember the units that was in FoW
-    for (auto it = units.begin(); it != units.end(); ++it) {
-        const Unit *u = it->second.get();
-        if (ExtractPlayerId(u->GetId()) != _player_id) {
-            Loc l = _filter_with_fow(*u);
+    // Locations in sight only show the units there now. The others keep the units seen there last time.
+    for (const Loc &l : _seen_locs) {
+        if (_fogs[l].CanSeeUnit()) _fogs[l]._prev_seen_units.clear();
+    }
+    _seen_locs.clear();
+    for (const Unit &u : units) {
+        if (ExtractPlayerId(u.GetId()) != _player_id) {
+            Loc l = _filter_with_fow(u);
             // Add the unit info to the loc.
-            if (l != -1) _fogs[l].SaveUnit(*u);
+            if (l == -1) continue;
+            if (_fogs[l]._prev_seen_units.empty()) _seen_locs.push_back(l);
+            _fogs[l].SaveUnit(u);
         }
     }
 }
@@ -114,28 +160,6 @@ string Player::PrintInfo() const {
     return ss.str();
 }
 
-void Player::update_heuristic(const Loc &p1, const Loc &p2, float value) const {
-    float min_value = get_line_dist(p1, p2);
-    if (value < min_value) value = min_value;
-    UpdateValue(p1, p2, value, &_heuristics);
-}
-
-float Player::get_line_dist(const Loc &p1, const Loc &p2) const {
-    Coord c1 = _map->GetCoord(p1);
-    Coord c2 = _map->GetCoord(p2);
-    const int dx = c1.x - c2.x;
-    const int dy = c1.y - c2.y;
-    return sqrt(static_cast<float>(dx * dx + dy * dy));
-}
-
-float Player::get_path_dist_heuristic(const Loc &p1, const Loc &p2) const {
-    float dist;
-    if (! GetValue(_heuristics, p1, p2, &dist)) {
-        dist = get_line_dist(p1, p2);
-    }
-    return dist;
-}
-
 bool Player::line_passable(UnitId id, const PointF &s, const PointF &t) const {
     const RTSMap &m = *_map;
 
@@ -219,130 +243,50 @@ bool Player::PathPlanning(Tick tick, UnitId id, const PointF &s, const PointF &t
         return true;
     }
 
-    // 8 neighbors.
-    // const int dx[] = { 1, 0, -1, 0, 1, 1, -1, -1 };
-    // const int dy[] = { 0, 1, 0, -1, 1, -1, 1, -1 };
-    // const float dists[] = { 1.0, 1.0, 1.0, 1.0, kSqrt2, kSqrt2, kSqrt2, kSqrt2 };
-
+    // Follow the flow field to the target.
     const int dx[] = { 1, 0, -1, 0 };
     const int dy[] = { 0, 1, 0, -1 };
-    const float dists[] = { 1.0, 1.0, 1.0, 1.0 };
-
-    // All "from" information.
-    // Loc -> Loc_from, dist_so_far.
-    map<Loc, pair<Loc, float> > c_from;
-    vector<Loc> c_popped;
-
-    // If s and t is not passable by a straight line.
-    priority_queue<Item> q;
-
-    float h0 = get_path_dist_heuristic(ls, lt);
-    q.emplace(Item(0.0, h0, ls, INVALID));
-    c_from.emplace(make_pair(ls, make_pair(INVALID, 0.0)));
 
-    if (verbose) {
-        cout << "Initial h0 = " << h0 << endl;
-    }
-
-    int iter = 1;
-    Loc l = INVALID;
-    bool found = false;
-
-    while (!q.empty()) {
-        Item v = q.top();
-        // cout << "Poped: " << v.PrintInfo(m) << endl;
-
-        // Save the current node to "from" information.
-        // Only the first occurrence matters (since given the same state, smallest g will come first).
-        c_popped.push_back(v.loc);
-        q.pop();
-
-        // Find the target, stop.
-        if (v.loc == lt || iter == max_iteration) {
-            if (verbose) {
-                cout << "[PathFinding] Tick: " << tick << "  Find the target! cost = " << v.cost << endl;
-            }
-            *dist = v.cost;
-            found = true;
-            l = v.loc;
-            break;
-        }
+    std::shared_ptr<const FlowField> field = m.GetFlowField(lt);
+    const vector<int> &d = field->dist;
 
-        Coord c_curr = m.GetCoord(v.loc);
-        // Expand to 8 neighbor.
+    // The neighbor of l that is closest to the target, and closer than l.
+    auto next_loc = [&](Loc l) -> Loc {
+        Coord c = m.GetCoord(l);
+        Loc best = INVALID;
         for (size_t i = 0; i < sizeof(dx) / sizeof(int); ++i) {
-            Coord next(c_curr.x + dx[i], c_curr.y + dy[i]);
-            Loc l_next = m.GetLoc(next);
-
-            // If we already push that before, skip.
-            if (c_from.find(l_next) != c_from.end()) continue;
-
-            // if we met with impassable location and has not reached the target (lt), skip.
-            if (l_next != lt) {
-               if (GetDistanceSquared(s, next) >= 4 && ! m.CanPass(next, id, false)) continue;
-               if (GetDistanceSquared(s, next) < 4 && ! m.CanPass(next, id)) continue;
-           }
-
-            float h = get_path_dist_heuristic(l_next, lt);
-            float next_dist = v.g + dists[i];
-
-            if (verbose) {
-                cout << "push: l_next = " << l_next << ", next_dist = " << next_dist << ", h = " << h << ", parent_loc = " << v.loc << endl;
-            }
-
-            q.emplace(Item(next_dist, h, l_next, v.loc));
-            c_from.emplace(make_pair(l_next, make_pair(v.loc, next_dist)));
+            if (! m.IsIn(c.x + dx[i], c.y + dy[i])) continue;
+            Loc l_next = m.GetLoc(c.x + dx[i], c.y + dy[i]);
+            if (d[l_next] == FlowField::kUnreachable) continue;
+            if (best == INVALID ? (d[l] == FlowField::kUnreachable || d[l_next] < d[l]) : d[l_next] < d[best]) best = l_next;
         }
-        iter ++;
-    }
+        return best;
+    };
 
-    if (verbose) {
-        cout << "Total iter = " << iter << " optimal dist = " << *dist << endl;
-    }
-
-    if (! found) {
-        // Not found.
-        return false;
-    }
-
-    // Then do a backtrace to get the path.
+    // traj[0] is the starting point, traj[-1] is the target, or the last location after max_iteration steps.
+    // A unit standing on a blocked location (e.g., next to a building) starts from the closest neighbor.
     vector<Loc> traj;
-    // traj[0] is the last part of the trajectory, depending on max_iteration,
-    // it might end in the target location, or reach some intermediate location, which is the most promising.
-    // traj[-1] is the starting point.
-    while (l != INVALID) {
-        // cout << "Loc: " << m.GetCoord(l) << endl;
-        auto it = c_from.find(l);
-        if (it == c_from.end()) {
-            cout << "Path-finding error!" << endl;
-            return false;
-        }
-
+    traj.push_back(ls);
+    Loc l = ls;
+    while (l != lt && (int)traj.size() <= max_iteration) {
+        l = next_loc(l);
+        if (l == INVALID) break;
         traj.push_back(l);
-        update_heuristic(l, lt, *dist - it->second.second);
-        l = it->second.first;
     }
-
-    // Delete trajectory from the map.
-    // cout << " Traj: ";
-    for (const Loc &l : traj) {
-        // cout << "(" << m.GetCoord(l) << ") ";
-        c_from.erase(l);
+    if (traj.size() == 1 && ls != lt) {
+        if (verbose) cout << "[PathPlanning] Tick: " << tick << " target cannot be reached" << endl;
+        _cache[make_pair(ls, lt)] = make_pair(tick, INVALID);
+        return false;
     }
-    // cout << endl;
-
-    // For all visited node other than the true solution,
-    // their heuristic will be set to be opt + eps - g
-    for (Loc l : c_popped) {
-        auto it = c_from.find(l);
-        if (it != c_from.end()) {
-            update_heuristic(l, lt, (*dist + 1e-5f) - it->second.second);
-        }
+    *dist = (traj.size() == 1 ? 0 : d[traj[1]] + 1);
+
+    if (verbose) {
+        cout << "[PathPlanning] Tick: " << tick << " path length = " << *dist << ", followed " << traj.size() - 1 << " steps" << endl;
     }
 
     // Compute the first waypoint from the starting.
     // Starting from the end of path and check.
-    for (size_t i = 0; i < traj.size(); i++) {
+    for (size_t i = traj.size(); i-- > 0; ) {
         Coord waypoint = m.GetCoord(traj[i]);
         if (line_passable(id, s, PointF(waypoint.x, waypoint.y))) {
             *first_block = waypoint;
@@ -358,11 +302,6 @@ bool Player::PathPlanning(Tick tick, UnitId id, const PointF &s, const PointF &t
 
 string Player::PrintHeuristicsCache() const {
     stringstream ss;
-    ss << "Heuristics: " << endl;
-    for (auto it = _heuristics.begin(); it != _heuristics.end(); ++it) {
-        ss << "[" << it->first.first << ", " << it->first.second << "]: " << it->second << endl;
-    }
-
     ss << "Cache: " << endl;
     for (auto it = _cache.begin(); it != _cache.end(); ++it) {
         ss << "[" << it->first.first << ", " << it->first.second << "]: T " << it->second.first << ": " << it->second.second << endl;
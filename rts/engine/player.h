@@ -15,11 +15,33 @@
 #include <queue>
 
 class Unit;
+class UnitStore;
+
+// What a player keeps of an enemy unit it has seen: enough to show it where it was last seen.
+struct SeenUnit {
+    UnitId _id;
+    UnitType _type;
+    PointF _p, _last_p;
+    Tick _built_since;
+    int _hp, _max_hp;
+
+    SeenUnit() : _id(INVALID), _type(INVALID_UNITTYPE), _built_since(INVALID), _hp(0), _max_hp(0) { }
+    explicit SeenUnit(const Unit &u);
+
+    UnitId GetId() const { return _id; }
+    PlayerId GetPlayerId() const;
+    UnitType GetUnitType() const { return _type; }
+    const PointF &GetPointF() const { return _p; }
+    const PointF &GetLastPointF() const { return _last_p; }
+    Tick GetBuiltSince() const { return _built_since; }
+
+    SERIALIZER(SeenUnit, _id, _type, _p, _last_p, _built_since, _hp, _max_hp);
+};
 
 struct Fog {
     // Fog level: 0 no fog, 100 completely invisible.
     int _fog = 100;
-    vector<Unit> _prev_seen_units;
+    vector<SeenUnit> _prev_seen_units;
 
     void MakeInvisible() {  _fog = 100; }
     void SetClear() { _fog = 0; _prev_seen_units.clear(); }
@@ -27,7 +49,7 @@ struct Fog {
     bool CanSeeUnit() const { return _fog < 30; }
 
     void SaveUnit(const Unit &u) {
-        _prev_seen_units.push_back(u);
+        _prev_seen_units.emplace_back(u);
     }
 
     void ResetFog() {
@@ -35,7 +57,7 @@ struct Fog {
         _prev_seen_units.clear(); 
     }
 
-    const vector<Unit> &seen_units() const { return _prev_seen_units; }
+    const vector<SeenUnit> &seen_units() const { return _prev_seen_units; }
 
     SERIALIZER(Fog, _fog, _prev_seen_units);
 };
@@ -62,56 +84,33 @@ private:
     // Current fog of war. This containers have the same size as the map.
     vector<Fog> _fogs;
 
-    // Heuristic function for path-planning.
-    // Loc x Loc -> min distance (in discrete space).
-    // If the key is not in _heuristics, then by default it is l2 distance.
-    mutable map< pair<Loc, Loc>, float > _heuristics;
+    // For updating the fog of war incrementally. They are not saved, and are rebuilt by the next ComputeFOW
+    // once loaded (a loaded player has no _sight_count).
+    struct SightSource {
+        UnitId id;
+        Loc loc;
+        int range;
+    };
+    // How many of the player's units see each location.
+    vector<uint16_t> _sight_count;
+    // Where each of the player's units was counted, sorted by id.
+    vector<SightSource> _sight_sources, _next_sight_sources;
+    // Locations whose count went from or to 0 since the last ComputeFOW.
+    vector<Loc> _sight_changed;
+    // Visible locations that hold enemy units.
+    vector<Loc> _seen_locs;
+    // _sight_stencils[r][dx + r]: a unit with sight range r sees dy in [-h, h] at dx, h = _sight_stencils[r][dx + r].
+    vector<vector<int>> _sight_stencils;
 
     // Cache for path planning. If the cache is too old, it will recompute.
     // Loc == INVALID: cannot pass / passable by a straight line (In this case, we return first_block = -1.
     mutable map< pair<Loc, Loc>, pair<Tick, Loc> > _cache;
 
 private:
-    struct Item {
-        float g;
-        float h;
-        float cost;
-        Loc loc;
-        Loc loc_from;
-        Item(float g, float h, const Loc &loc, const Loc &loc_from)
-            : g(g), h(h), loc(loc), loc_from(loc_from) {
-            cost = g + h;
-        }
-
-        friend bool operator<(const Item &m1, const Item &m2) {
-            if (m1.cost > m2.cost) return true;
-            if (m1.cost < m2.cost) return false;
-            if (m1.g > m2.g) return true;
-            if (m1.g < m2.g) return false;
-            if (m1.loc < m2.loc) return true;
-            if (m1.loc > m2.loc) return false;
-            if (m1.loc_from < m2.loc_from) return true;
-            if (m1.loc_from > m2.loc_from) return false;
-            return true;
-        }
-
-        string PrintInfo(const RTSMap &m) const {
-            stringstream ss;
-            ss << "cost: " << cost << " loc: (" << m.GetCoord(loc) << ") g: " << g << " h: " << h << " from: (" << m.GetCoord(loc_from) << ")";
-            return ss.str();
-        }
-    };
-
     Loc _filter_with_fow(const Unit& u) const;
+    void add_sight(Loc loc, int range, int delta);
 
     bool line_passable(UnitId id, const PointF &curr, const PointF &target) const;
-    float get_line_dist(const Loc &p1, const Loc &p2) const;
-
-    // Update the heuristic value.
-    void update_heuristic(const Loc &p1, const Loc &p2, float value) const;
-
-    // Get the heuristic distance from p1 to p2.
-    float get_path_dist_heuristic(const Loc &p1, const Loc &p2) const;
 
 public:
     Player() : _map(nullptr), _player_id(INVALID), _privilege(PV_NORMAL), _resource(0) {
@@ -128,7 +127,7 @@ public:
     int GetResource() const { return _resource; }
 
     string Draw() const;
-    void ComputeFOW(const map<UnitId, unique_ptr<Unit> > &units);
+    void ComputeFOW(const UnitStore &units);
     bool FilterWithFOW(const Unit& u) const;
 
     float GetDistanceSquared(const PointF &p, const Coord &c) const {
@@ -137,7 +136,9 @@ public:
         return dx * dx + dy * dy;
     }
 
-    // It will change _heuristics internally.
+    // Follows the map's flow field to target (see FlowFields), at most max_iteration steps. first_block is the
+    // farthest location on the path that can be reached by a straight line, est_dist is the path length.
+    // It will change _cache internally.
     bool PathPlanning(Tick tick, UnitId id, const PointF &curr, const PointF &target, int max_iteration, bool verbose, Coord *first_block, float *est_dist) const;
 
     void SetPrivilege(PlayerPrivilege new_pv) { _privilege = new_pv; }
@@ -154,12 +155,12 @@ public:
     }
 
     void ClearCache() { 
-        _heuristics.clear(); 
         _cache.clear(); 
         _resource = 0; 
         for (auto &fog : _fogs) {
             fog.ResetFog();
         }
+        _sight_count.clear();
     }
 
     const Fog &GetFog(Loc loc) const { return _fogs[loc]; }
@@ -172,7 +173,7 @@ public:
     static PlayerId ExtractPlayerId(UnitId id) { return (id >> 24); }
     static UnitId CombinePlayerId(UnitId raw_id, PlayerId player_id) { return (raw_id & 0xffffff) | (player_id << 24); }
 
-    SERIALIZER(Player, _player_id, _name, _privilege, _resource, _fogs, _heuristics, _cache);
+    SERIALIZER(Player, _player_id, _name, _privilege, _resource, _fogs, _cache);
     HASH(Player, _player_id, _privilege, _resource);
 };
 
@@ -40,6 +40,9 @@ using std::priority_queue<_Tp, _Sequence, _Compare>::top;
 using std::priority_queue<_Tp, _Sequence, _Compare>::push;
 using std::priority_queue<_Tp, _Sequence, _Compare>::pop;
 
+// The underlying heap, in storage order.
+const _Sequence &container() const { return this->c; }
+
 #if __cplusplus >= 201103L
 
 using std::priority_queue<_Tp, _Sequence, _Compare>::emplace;
@@ -37,16 +37,15 @@ void Preload::collect_stats(const GameEnv &env, int player_id, const CmdReceiver
     _player_id = player_id;
 
     // Collect ...
-    const Units& units = env.GetUnits();
+    const UnitStore& units = env.GetUnits();
     //const RTSMap& m = env.GetMap();
     const Player& player = env.GetPlayer(_player_id);
 
     // cout << "Looping over units" << endl << flush;
 
     // Get the information of all other troops.
-    for (auto it = units.begin(); it != units.end(); ++it) {
-        const Unit *u = it->second.get();
-        if (u == nullptr) cout << "Unit cannot be nullptr" << endl << flush;
+    for (const Unit &unit : units) {
+        const Unit *u = &unit;
         // cout << "unit: " << u->GetProperty().PrintInfo() << endl << flush;
 
         auto &troops = (u->GetPlayerId() == _player_id ? _my_troops : _enemy_troops);
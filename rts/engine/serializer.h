@@ -85,6 +85,12 @@ public:
         return s;
     }
 
+    template <typename T>
+    friend saver &operator<<(saver &s, const std::shared_ptr<T>& v) {
+        s << *v;
+        return s;
+    }
+
     template <typename T>
     friend saver &operator<<(saver &s, const p_queue<T>& v) {
         const T *p = &v.top();
@@ -238,6 +244,13 @@ public:
         return l;
     }
 
+    template <typename T>
+    friend loader &operator>>(loader &l, std::shared_ptr<T>& v) {
+        v = std::make_shared<T>();
+        l >> *v;
+        return l;
+    }
+
     template <typename T>
     friend loader &operator>>(loader &l, p_queue<T>& v) {
         v = p_queue<T>();
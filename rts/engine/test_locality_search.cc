@@ -0,0 +1,190 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+//g++ -std=c++11 -O2 test_locality_search.cc -o test_locality_search && ./test_locality_search [num_ops]
+//
+// Runs random Add / Remove / Move on a LocalitySearch and on a plain list of circles, and checks that both
+// give the same answers. The entries move by small steps most of the time, so that grid_move shifts a
+// few buckets, and sometimes jump, leave the area or are too large for a bucket.
+
+#include <stdlib.h>
+#include <iostream>
+#include <random>
+#include <set>
+#include <unordered_map>
+
+#include "locality_search.h"
+
+using namespace std;
+
+struct Circle {
+    PointF p;
+    float r;
+};
+
+class Checker {
+public:
+    Checker(const PointF &pmin, const PointF &pmax) : _pmin(pmin), _pmax(pmax), _search(pmin, pmax) { }
+
+    void Add(int key, const PointF &p, float r) {
+        _search.Add(key, p, r);
+        if (_circles.find(key) == _circles.end()) _circles[key] = Circle{p, r};
+    }
+    void Remove(int key) {
+        _search.Remove(key);
+        _circles.erase(key);
+    }
+    void Move(int key, const PointF &p) {
+        _search.Move(key, p);
+        auto it = _circles.find(key);
+        if (it != _circles.end()) it->second.p = p;
+    }
+    void Clear() {
+        _search.Clear();
+        _circles.clear();
+    }
+    int size() const { return _circles.size(); }
+    bool Key2Loc(int key, PointF *p) const {
+        auto it = _circles.find(key);
+        if (it == _circles.end()) return false;
+        *p = it->second.p;
+        return true;
+    }
+
+    bool CheckKey(int key) const {
+        PointF p;
+        const bool found = _search.Key2Loc(key, &p);
+        auto it = _circles.find(key);
+        const bool expected = it != _circles.end();
+        if (found != expected || _search.Exists(key) != expected) {
+            cout << "FAILED: key " << key << " exists: " << found << ", expected " << expected << endl;
+            return false;
+        }
+        if (found && (p.x != it->second.p.x || p.y != it->second.p.y)) {
+            cout << "FAILED: key " << key << " is at " << p << ", expected " << it->second.p << endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool CheckAllKeys(int max_key) const {
+        for (int key = 0; key < max_key; ++key) {
+            if (! CheckKey(key)) return false;
+        }
+        return true;
+    }
+
+    // IsEmpty only looks at the entries of the same kind (in a bucket or not) as the query.
+    bool CheckIsEmpty(const PointF &p, float r, int key_exclude) const {
+        bool empty = true;
+        const bool regular = is_regular(p, r);
+        for (const auto &kv : _circles) {
+            if (kv.first == key_exclude || is_regular(kv.second.p, kv.second.r) != regular) continue;
+            const float sum_dist = kv.second.r + r;
+            if (PointF::L2Sqr(kv.second.p, p) < sum_dist * sum_dist) empty = false;
+        }
+        if (_search.IsEmpty(p, r, key_exclude) != empty) {
+            cout << "FAILED: IsEmpty(" << p << ", " << r << ") is " << ! empty << endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool CheckLoc2Key(const PointF &p) const {
+        int expected = INVALID;
+        float min_dist_sqr = numeric_limits<float>::max();
+        for (const auto &kv : _circles) {
+            const float dist_sqr = PointF::L2Sqr(kv.second.p, p);
+            if (dist_sqr < kv.second.r * kv.second.r && dist_sqr < min_dist_sqr) {
+                min_dist_sqr = dist_sqr;
+                expected = kv.first;
+            }
+        }
+        float dist_sqr;
+        const int *key = _search.Loc2Key(p, &dist_sqr);
+        const int actual = key != nullptr ? *key : INVALID;
+        if (actual != expected) {
+            cout << "FAILED: Loc2Key(" << p << ") is " << actual << ", expected " << expected << endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool CheckKeysInRegion(const PointF &left_top, const PointF &right_bottom) const {
+        set<int> expected;
+        for (const auto &kv : _circles) {
+            if (kv.second.p.IsIn(left_top, right_bottom)) expected.insert(kv.first);
+        }
+        if (_search.KeysInRegion(left_top, right_bottom) != expected) {
+            cout << "FAILED: KeysInRegion(" << left_top << ", " << right_bottom << ") has "
+                 << _search.KeysInRegion(left_top, right_bottom).size() << " keys, expected " << expected.size() << endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    PointF _pmin, _pmax;
+    LocalitySearch<int> _search;
+    unordered_map<int, Circle> _circles;
+
+    bool is_regular(const PointF &p, float r) const {
+        return 2 * r < 2 * kUnitRadius + numeric_limits<float>::epsilon() && p.IsIn(_pmin, _pmax);
+    }
+};
+
+int main(int argc, char *argv[]) {
+    const int num_ops = argc > 1 ? atoi(argv[1]) : 1000000;
+    const int max_key = 400;
+    const float size = 20;
+    const PointF pmin(0, 0), pmax(size, size);
+
+    mt19937 rng(0);
+    uniform_real_distribution<float> coord(-1, size + 1);
+    uniform_real_distribution<float> step(-0.6, 0.6);
+    uniform_real_distribution<float> unit(0, 1);
+
+    auto random_radius = [&]() { return unit(rng) < 0.05 ? 1.5f * kUnitRadius : kUnitRadius * (0.2f + 0.8f * unit(rng)); };
+    auto random_point = [&]() { return PointF(coord(rng), coord(rng)); };
+
+    Checker checker(pmin, pmax);
+    for (int op = 0; op < num_ops; ++op) {
+        const int key = rng() % max_key;
+        const float dice = unit(rng);
+        if (dice < 0.3) {
+            checker.Add(key, random_point(), random_radius());
+        } else if (dice < 0.4) {
+            checker.Remove(key);
+        } else if (dice < 0.95) {
+            // Usually a small step, to the same or a nearby bucket.
+            PointF p;
+            if (checker.Key2Loc(key, &p) && unit(rng) < 0.9) {
+                p.x += step(rng);
+                p.y += step(rng);
+            } else {
+                p = random_point();
+            }
+            checker.Move(key, p);
+        } else if (dice < 0.99995) {
+            const PointF p = random_point();
+            if (! checker.CheckIsEmpty(p, random_radius(), unit(rng) < 0.5 ? key : INVALID)) return 1;
+            if (! checker.CheckLoc2Key(p)) return 1;
+        } else {
+            checker.Clear();
+        }
+        if (! checker.CheckKey(key)) return 1;
+
+        if (op % 1000 == 0) {
+            if (! checker.CheckAllKeys(max_key)) return 1;
+            PointF p1 = random_point(), p2 = random_point();
+            if (! checker.CheckKeysInRegion(PointF(min(p1.x, p2.x), min(p1.y, p2.y)), PointF(max(p1.x, p2.x), max(p1.y, p2.y)))) return 1;
+        }
+    }
+    cout << "Passed: " << num_ops << " operations, " << checker.size() << " entries left" << endl;
+    return 0;
+}
@@ -61,6 +61,4 @@ public:
 
 STD_HASH(Unit);
 
-typedef map<UnitId, unique_ptr<Unit> > Units;
-
 #endif
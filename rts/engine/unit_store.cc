@@ -0,0 +1,96 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#include "unit_store.h"
+#include <stdexcept>
+
+Unit *UnitStore::Add(const Unit &u) {
+    const UnitId id = u.GetId();
+    const PlayerId player_id = Player::ExtractPlayerId(id);
+    if (id < 0) {
+        cout << "UnitStore: invalid unit id " << id << endl;
+        throw std::range_error("UnitStore: invalid unit id");
+    }
+    if (player_id >= (int)_players.size()) _players.resize(player_id + 1);
+    Slots &slots = _players[player_id];
+    if (slots.units.capacity() == 0) {
+        slots.ids.reserve(kInitialCapacity);
+        slots.units.reserve(kInitialCapacity);
+    }
+    if (id <= slots.last_id) {
+        cout << "UnitStore: unit id " << id << " is not larger than " << slots.last_id << endl;
+        throw std::range_error("UnitStore: unit ids have to be added in increasing order");
+    }
+
+    const int raw = raw_id(id);
+    if (raw >= (int)_index.size()) _index.resize(raw + 1, -1);
+    _index[raw] = slots.ids.size();
+
+    slots.ids.push_back(id);
+    slots.units.push_back(u);
+    slots.last_id = id;
+    _size ++;
+    return &slots.units.back();
+}
+
+bool UnitStore::Remove(UnitId id) {
+    const int i = find(id);
+    if (i < 0) return false;
+
+    Slots &slots = _players[Player::ExtractPlayerId(id)];
+    slots.ids[i] = INVALID;
+    slots.num_dead ++;
+    _index[raw_id(id)] = -1;
+    _size --;
+    return true;
+}
+
+void UnitStore::Compact() {
+    for (Slots &slots : _players) {
+        // Amortized: the live units are moved at most once for every unit removed.
+        if (slots.num_dead == 0 || slots.num_dead * 4 < (int)slots.ids.size()) continue;
+
+        size_t n = 0;
+        for (size_t i = 0; i < slots.ids.size(); ++i) {
+            if (slots.ids[i] == INVALID) continue;
+            if (i != n) {
+                slots.ids[n] = slots.ids[i];
+                slots.units[n] = std::move(slots.units[i]);
+                _index[raw_id(slots.ids[n])] = n;
+            }
+            n ++;
+        }
+        slots.ids.resize(n);
+        slots.units.erase(slots.units.begin() + n, slots.units.end());
+        slots.num_dead = 0;
+    }
+}
+
+serializer::saver &operator<<(serializer::saver &s, const UnitStore &store) {
+    if (! s.is_binary()) s.get() << " ";
+    s << store._size;
+    if (! s.is_binary()) s.get() << "\n";
+    for (const Unit &u : store) {
+        s << std::pair<const UnitId &, const Unit &>(u.GetId(), u);
+        if (! s.is_binary()) s.get() << "\n";
+    }
+    return s;
+}
+
+serializer::loader &operator>>(serializer::loader &l, UnitStore &store) {
+    int size;
+    l >> size;
+    store.clear();
+    for (int i = 0; i < size; ++i) {
+        UnitId id;
+        Unit u;
+        l >> id >> u;
+        store.Add(u);
+    }
+    return l;
+}
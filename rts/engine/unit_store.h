@@ -0,0 +1,151 @@
+/**
+* Copyright (c) 2017-present, Facebook, Inc.
+* All rights reserved.
+
+* This source code is licensed under the BSD-style license found in the
+* LICENSE file in the root directory of this source tree.
+*/
+
+#ifndef _UNIT_STORE_H_
+#define _UNIT_STORE_H_
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include "unit.h"
+
+// All the units of a game, visited in the order of their ids, i.e., by player and then by creation. Hash
+// codes, snapshots and the order in which the AIs see the units (hence the replays) depend on it.
+//
+// Each player has an array of slots, with the ids in one column and the units in another. New units always
+// get larger ids, so a player's slots only grow at the end and stay sorted. Removing a unit marks its slot
+// as dead (id INVALID) and Compact() drops the dead slots later.
+// Raw ids are never reused within a game, so an index from the raw id to the slot gives the unit in O(1),
+// and checking the id kept in the slot makes sure a removed unit (or an id of another player) is not found.
+//
+// Pointers to the units stay valid until the next Add() or Compact(). Each player starts with room for
+// kInitialCapacity units, so that the first units of a game are not moved over and over.
+//
+// The units stay whole (array of structures). Splitting the hot fields (position, hp, type, player,
+// cooldowns) into their own columns only pays for tight scans over many units, while the loops over
+// the units here do much more work per unit (path planning, sight, commands).
+class UnitStore {
+private:
+    static constexpr int kInitialCapacity = 64;
+
+    struct Slots {
+        // INVALID for dead slots.
+        std::vector<UnitId> ids;
+        std::vector<Unit> units;
+        int num_dead = 0;
+        // Largest id ever added.
+        UnitId last_id = INVALID;
+    };
+
+    // Indexed by player id.
+    std::vector<Slots> _players;
+    // Raw id -> slot in the player's array, -1 if the unit is not there.
+    std::vector<int> _index;
+    int _size = 0;
+
+    static int raw_id(UnitId id) { return id & 0xffffff; }
+
+    int find(UnitId id) const {
+        if (id < 0) return -1;
+        const int raw = raw_id(id);
+        if (raw >= (int)_index.size() || _index[raw] < 0) return -1;
+        const PlayerId player_id = Player::ExtractPlayerId(id);
+        if (player_id >= (int)_players.size() || _players[player_id].ids[_index[raw]] != id) return -1;
+        return _index[raw];
+    }
+
+public:
+    template <typename Store, typename U>
+    class iterator_base {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef U value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef U *pointer;
+        typedef U &reference;
+
+        iterator_base(Store *store, int player_id, int i) : _store(store), _player_id(player_id), _i(i) {
+            next();
+        }
+
+        U &operator *() const { return _store->_players[_player_id].units[_i]; }
+        U *operator ->() const { return &_store->_players[_player_id].units[_i]; }
+
+        iterator_base &operator ++() {
+            ++ _i;
+            next();
+            return *this;
+        }
+
+        bool operator ==(const iterator_base &it) const { return _player_id == it._player_id && _i == it._i; }
+        bool operator !=(const iterator_base &it) const { return ! (*this == it); }
+
+    private:
+        Store *_store;
+        int _player_id, _i;
+
+        // Skip the dead slots, and move to the next player at the end of an array.
+        void next() {
+            while (_player_id < (int)_store->_players.size()) {
+                const auto &ids = _store->_players[_player_id].ids;
+                while (_i < (int)ids.size() && ids[_i] == INVALID) ++ _i;
+                if (_i < (int)ids.size()) return;
+                _player_id ++;
+                _i = 0;
+            }
+        }
+    };
+
+    typedef iterator_base<UnitStore, Unit> iterator;
+    typedef iterator_base<const UnitStore, const Unit> const_iterator;
+
+    int size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    void clear() {
+        _players.clear();
+        _index.clear();
+        _size = 0;
+    }
+
+    const Unit *Get(UnitId id) const {
+        const int i = find(id);
+        return i < 0 ? nullptr : &_players[Player::ExtractPlayerId(id)].units[i];
+    }
+    Unit *Get(UnitId id) {
+        const int i = find(id);
+        return i < 0 ? nullptr : &_players[Player::ExtractPlayerId(id)].units[i];
+    }
+
+    // The id of the unit has to be larger than the ids of all the units of its player added before.
+    Unit *Add(const Unit &u);
+    bool Remove(UnitId id);
+
+    // Drop the dead slots of the players that have many of them. The units move, so no pointer to them
+    // may be held.
+    void Compact();
+
+    iterator begin() { return iterator(this, 0, 0); }
+    iterator end() { return iterator(this, _players.size(), 0); }
+    const_iterator begin() const { return const_iterator(this, 0, 0); }
+    const_iterator end() const { return const_iterator(this, _players.size(), 0); }
+
+    // The units of one player.
+    const_iterator begin(PlayerId player_id) const {
+        return const_iterator(this, std::min(player_id, (int)_players.size()), 0);
+    }
+    const_iterator end(PlayerId player_id) const {
+        return const_iterator(this, std::min(player_id + 1, (int)_players.size()), 0);
+    }
+
+    // Same layout as map<UnitId, unique_ptr<Unit>>, which the snapshots used before.
+    friend serializer::saver &operator<<(serializer::saver &s, const UnitStore &store);
+    friend serializer::loader &operator>>(serializer::loader &l, UnitStore &store);
+};
+
+#endif
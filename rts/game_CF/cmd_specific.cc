@@ -26,9 +26,9 @@ bool CmdFlagSetHandicap::run(GameEnv *env, CmdReceiver*) {
         return false;
     }
     const int _player_id = 0;
-    Units &units = env->GetUnits();
-    for (auto it = units.begin(); it != units.end(); ++it) {
-        Unit *u = it->second.get();
+    UnitStore &units = env->GetUnits();
+    for (Unit &unit : units) {
+        Unit *u = &unit;
         if  (u->GetPlayerId() == _player_id) {
             // increase movement speed, attack and health by 20% * _level
             UnitProperty &p = u->GetProperty();
@@ -101,7 +101,7 @@ bool CmdScoreFlag::run(GameEnv * env, CmdReceiver* receiver) {
     }
     */
     auto f = env->GetRandomFunc();
-    auto map = env->GetMap();
+    const RTSMap &map = env->GetMap();
     while (1) {
         PointF new_p = PointF(9, f(10) + 5);
         if (map.CanPass(new_p, INVALID)) {